@@ -0,0 +1,98 @@
+#ifndef PGB_APU_APU_H
+#define PGB_APU_APU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pgb/apu/ring_buffer.h>
+#include <pgb/apu/synth.h>
+
+struct device;
+
+/* NR10 through the end of wave RAM */
+#define APU_REGISTERS_START 0xff10
+#define APU_REGISTERS_END 0xff3f
+#define APU_NUM_REGISTERS (APU_REGISTERS_END - APU_REGISTERS_START + 1)
+
+/* The frame sequencer is clocked at 512 Hz */
+#define APU_FRAME_SEQUENCER_CYCLES 8192
+
+enum apu_channel_id {
+	APU_CHANNEL_SQUARE1,
+	APU_CHANNEL_SQUARE2,
+	APU_CHANNEL_WAVE,
+	APU_CHANNEL_NOISE,
+	APU_NUM_CHANNELS
+};
+
+#define APU_CHANNEL_MASK(id) (1 << (id))
+#define APU_CHANNEL_MASK_ALL ((1 << APU_NUM_CHANNELS) - 1)
+
+enum apu_mode {
+	/* Register semantics, length counters and NR52 status, but no samples */
+	APU_MODE_REGISTERS_ONLY,
+	/* Samples are synthesized into the attached ring as well */
+	APU_MODE_SYNTHESIS
+};
+
+struct apu_channel {
+	bool enabled;
+	bool dac_enabled;
+	bool length_enabled;
+	uint16_t length;
+	uint8_t volume;
+	uint8_t envelope_timer;
+	/* T-cycles between two waveform steps and until the next one */
+	uint32_t period;
+	uint32_t timer;
+	uint8_t position;
+	/* Last level handed to the synthesizer, 0 - 15 */
+	int8_t output;
+};
+
+/*
+ * The APU is never stepped along with the CPU. It catches up from last_sync
+ * to the scheduler timestamp whenever one of its registers is accessed or the
+ * frontend drains audio, so a game that leaves the sound hardware alone costs
+ * nothing until the next drain.
+ */
+struct apu {
+	bool powered;
+	uint8_t registers[APU_NUM_REGISTERS];
+	struct apu_channel channels[APU_NUM_CHANNELS];
+	struct {
+		bool enabled;
+		uint8_t timer;
+		uint16_t shadow_frequency;
+	} sweep;
+	uint16_t lfsr;
+	uint8_t frame_sequencer_step;
+	uint64_t next_frame_sequencer;
+	uint64_t last_sync;
+	/*
+	 * Everything above is emulated state and is saved as is, everything
+	 * below is derived from it or belongs to the host.
+	 */
+	/* Per channel left / right gain from NR50 and NR51 */
+	int gains[APU_NUM_CHANNELS][APU_RING_BUFFER_CHANNELS];
+	enum apu_mode mode;
+	/* Channels left out of the mix, behaviour is unaffected */
+	uint8_t channel_mask;
+	struct apu_ring_buffer *output;
+	struct apu_synth synth;
+};
+
+int apu_init(struct apu *apu);
+int apu_destroy(struct apu *apu);
+int apu_clone(struct apu *dst, struct apu *src);
+int apu_set_output(struct device *device, struct apu_ring_buffer *ring, unsigned sample_rate);
+int apu_set_mode(struct device *device, enum apu_mode mode);
+int apu_set_channel_mask(struct device *device, uint8_t mask);
+int apu_sync(struct device *device);
+int apu_state_loaded(struct device *device);
+int apu_drain(struct device *device);
+
+int apu_read8(struct device *device, uint16_t address, uint8_t *result);
+int apu_write8(struct device *device, uint16_t address, uint8_t value);
+
+#endif /* PGB_APU_APU_H */
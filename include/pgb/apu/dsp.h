@@ -0,0 +1,34 @@
+#ifndef PGB_APU_DSP_H
+#define PGB_APU_DSP_H
+
+#include <stddef.h>
+
+/* One voice per APU channel */
+#define APU_DSP_VOICES 4
+
+enum apu_dsp_isa {
+	APU_DSP_ISA_AUTO,
+	APU_DSP_ISA_SCALAR,
+	APU_DSP_ISA_SSE2,
+	APU_DSP_ISA_AVX2
+};
+
+/*
+ * Block kernels of the audio pipeline, picked once for the host CPU.
+ *
+ * mix() integrates count frames of interleaved per-voice deltas into levels
+ * and pans them with gains, laid out as APU_DSP_VOICES left gains followed by
+ * APU_DSP_VOICES right gains, into the planar left and right buffers.
+ *
+ * convolve() filters taps consecutive left and right samples with kernel.
+ * taps must be a multiple of 8.
+ */
+struct apu_dsp {
+	enum apu_dsp_isa isa;
+	void (*mix)(const float *deltas, size_t count, float *levels, const float *gains, float *left, float *right);
+	void (*convolve)(const float *kernel, const float *left, const float *right, size_t taps, float *out_left, float *out_right);
+};
+
+int apu_dsp_init(struct apu_dsp *dsp, enum apu_dsp_isa isa);
+
+#endif /* PGB_APU_DSP_H */
@@ -0,0 +1,35 @@
+#ifndef PGB_APU_RESAMPLER_H
+#define PGB_APU_RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pgb/apu/dsp.h>
+
+#define APU_RESAMPLER_TAPS 64
+#define APU_RESAMPLER_PHASES 64
+
+/*
+ * Polyphase windowed-sinc resampler over planar stereo blocks. Input is
+ * appended to the history, every output frame is one convolve() of the
+ * history window under it with the kernel phase closest to its fractional
+ * input position.
+ */
+struct apu_resampler {
+	/* Input frames per output frame and next output position, 32.32 */
+	uint64_t step;
+	uint64_t position;
+	size_t length;
+	size_t capacity;
+	float *history[2];
+	float *kernel;
+};
+
+int apu_resampler_init(struct apu_resampler *resampler, unsigned input_rate, unsigned output_rate, size_t max_block);
+int apu_resampler_destroy(struct apu_resampler *resampler);
+void apu_resampler_reset(struct apu_resampler *resampler);
+int apu_resampler_append(struct apu_resampler *resampler, size_t count, float **left, float **right);
+size_t apu_resampler_run(struct apu_resampler *resampler, const struct apu_dsp *dsp, float *left, float *right, size_t count);
+void apu_resampler_compact(struct apu_resampler *resampler);
+
+#endif /* PGB_APU_RESAMPLER_H */
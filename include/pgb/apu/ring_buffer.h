@@ -0,0 +1,28 @@
+#ifndef PGB_APU_RING_BUFFER_H
+#define PGB_APU_RING_BUFFER_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Single producer, single consumer queue of interleaved stereo frames. The
+ * storage is owned by the caller; the emulation thread produces frames and
+ * the audio callback consumes them without taking any locks.
+ */
+struct apu_ring_buffer {
+	int16_t *frames;
+	size_t capacity;
+	atomic_size_t write_index;
+	atomic_size_t read_index;
+};
+
+#define APU_RING_BUFFER_CHANNELS 2
+
+int apu_ring_buffer_init(struct apu_ring_buffer *ring, int16_t *frames, size_t capacity);
+size_t apu_ring_buffer_readable(struct apu_ring_buffer *ring);
+size_t apu_ring_buffer_writable(struct apu_ring_buffer *ring);
+size_t apu_ring_buffer_read(struct apu_ring_buffer *ring, int16_t *frames, size_t count);
+size_t apu_ring_buffer_write(struct apu_ring_buffer *ring, const int16_t *frames, size_t count);
+
+#endif /* PGB_APU_RING_BUFFER_H */
@@ -0,0 +1,54 @@
+#ifndef PGB_APU_SYNTH_H
+#define PGB_APU_SYNTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pgb/apu/dsp.h>
+#include <pgb/apu/resampler.h>
+#include <pgb/apu/ring_buffer.h>
+
+#define APU_SYNTH_CLOCK_RATE 4194304
+/* Rate the channels are synthesized at before mixing and resampling */
+#define APU_SYNTH_INTERNAL_RATE (APU_SYNTH_CLOCK_RATE / 32)
+#define APU_SYNTH_VOICES APU_DSP_VOICES
+#define APU_SYNTH_KERNEL_TAPS 16
+#define APU_SYNTH_KERNEL_PHASES 32
+
+/*
+ * Band-limited step synthesizer. Amplitude changes of every voice are
+ * recorded as deltas at their exact T-cycle timestamp by adding a windowed
+ * sinc impulse into an accumulation buffer at the internal rate. Reading
+ * integrates the impulses back into band-limited steps while panning the
+ * voices (the mixer), then resamples the block to the output rate. Square
+ * edges never alias regardless of where they fall between two samples.
+ */
+struct apu_synth {
+	unsigned sample_rate;
+	/* Internal samples per T-cycle, 32.32 fixed point */
+	uint64_t factor;
+	/* Timestamp matching origin_offset, 32.32 fixed point sample position */
+	uint64_t origin;
+	uint64_t origin_offset;
+	size_t capacity;
+	/* capacity frames of APU_SYNTH_VOICES interleaved deltas */
+	float *deltas;
+	float levels[APU_SYNTH_VOICES];
+	float gains[APU_RING_BUFFER_CHANNELS * APU_SYNTH_VOICES];
+	float dc_input[APU_RING_BUFFER_CHANNELS];
+	float highpass[APU_RING_BUFFER_CHANNELS];
+	float highpass_factor;
+	struct apu_dsp dsp;
+	struct apu_resampler resampler;
+	float kernel[APU_SYNTH_KERNEL_PHASES][APU_SYNTH_KERNEL_TAPS];
+};
+
+int apu_synth_init(struct apu_synth *synth, unsigned sample_rate, uint64_t max_span, uint64_t timestamp);
+int apu_synth_destroy(struct apu_synth *synth);
+void apu_synth_reset(struct apu_synth *synth, uint64_t timestamp);
+void apu_synth_set_level(struct apu_synth *synth, int voice, int level);
+void apu_synth_set_gain(struct apu_synth *synth, int voice, int left, int right);
+void apu_synth_add_delta(struct apu_synth *synth, uint64_t timestamp, int voice, int delta);
+size_t apu_synth_read(struct apu_synth *synth, uint64_t timestamp, struct apu_ring_buffer *ring);
+
+#endif /* PGB_APU_SYNTH_H */
@@ -0,0 +1,16 @@
+/* This file is auto-generated by the project Makefile */
+
+#ifndef PGB_BANNER_H
+#define PGB_BANNER_H
+
+#define LIB_NAME "libpgb.so"
+#define LIB_BUILD_FLAGS "-std=gnu11 -Wall -Werror -fvisibility=hidden -DDEBUG=0 -O1 -DPGB_PROFILE=0 -DPGB_LAZY_FLAGS=1 -DHAS_BIOS_ROM=0"
+#define LIB_BUILD_DEPS "-lm"
+#define LIB_BUILD_DATE "Mon Oct 19 00:44:44 UTC 2026"
+#define LIB_AUTHOR "Paul Campbell <pacampbell87@gmail.com>"
+#define GIT_BRANCH_NAME "master"
+#define GIT_HEAD_HASH "d7971195950e348719443a948122dec0796c4242"
+#define GIT_REPO_LOCATION "https://github.com/pacampbell/lib-pgb"
+#define CC_VERSION "gcc (Debian 12.2.0-14+deb12u1) 12.2.0"
+
+#endif /* PGB_BANNER_H */
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef PGB_BATCH_BATCH_H
+#define PGB_BATCH_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <pgb/state/hash.h>
+
+struct device;
+
+/*
+ * One line of the manifest. Paths and the pattern point into the line the
+ * job was parsed from, which the manifest owns.
+ */
+struct batch_job {
+	size_t index;
+	unsigned line;
+	char *text;
+	const char *rom_path;
+	const char *bios_path;
+	const char *state_path;
+	const char *movie_path;
+	const char *serial_pattern;
+	const char *decoder_type;
+	/* NULL keeps the default, instruction stepped core */
+	const char *cpu_core;
+	uint64_t frames;
+};
+
+struct batch_manifest {
+	struct batch_job *jobs;
+	size_t count;
+	size_t capacity;
+};
+
+enum batch_status {
+	/* Ran for the requested number of frames */
+	BATCH_STATUS_DONE,
+	/* The CPU halted before that */
+	BATCH_STATUS_HALTED,
+	/* The serial pattern showed up */
+	BATCH_STATUS_MATCHED,
+	/* The serial pattern did not show up in time */
+	BATCH_STATUS_TIMEOUT,
+	/* A movie diverged from its recorded hashes */
+	BATCH_STATUS_DESYNC,
+	BATCH_STATUS_ERROR
+};
+
+struct batch_result {
+	enum batch_status status;
+	int error;
+	uint64_t frames;
+	uint64_t cycles;
+	uint32_t desync_frame;
+	struct state_hash hash;
+	double seconds;
+};
+
+int batch_manifest_load(struct batch_manifest *manifest, FILE *stream, uint64_t default_frames, const char *decoder_type);
+void batch_manifest_free(struct batch_manifest *manifest);
+
+int batch_job_run(struct device *device, struct batch_job *job, struct batch_result *result);
+int batch_result_format(struct batch_job *job, struct batch_result *result, char *buffer, size_t size);
+
+#endif /* PGB_BATCH_BATCH_H */
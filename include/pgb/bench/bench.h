@@ -0,0 +1,51 @@
+#ifndef PGB_BENCH_BENCH_H
+#define PGB_BENCH_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Bump whenever columns change meaning, so old results are not compared */
+#define BENCH_FORMAT_VERSION 1
+
+struct bench_options {
+	/* Each case runs this many times and reports its fastest run */
+	unsigned repetitions;
+	/* Instructions or memory accesses per run */
+	uint64_t operations;
+	/* Emulated frames each ROM of a corpus runs for */
+	uint64_t frames;
+	const char *decoder;
+};
+
+struct bench_result {
+	const char *suite;
+	const char *name;
+	const char *decoder;
+	uint64_t operations;
+	double ns_per_op;
+	int status;
+};
+
+/* What one ROM of a corpus did, the fastest of its runs */
+struct bench_corpus_result {
+	char rom[256];
+	int error;
+	bool halted;
+	uint64_t frames;
+	uint64_t instructions;
+	double seconds;
+	/* Largest resident set of any run, in KiB */
+	long peak_rss;
+};
+
+double bench_now(void);
+void bench_report_header(FILE *stream);
+void bench_report_result(FILE *stream, struct bench_result *result);
+
+int bench_conformance_run(FILE *stream, struct bench_options *options);
+int bench_micro_run(FILE *stream, struct bench_options *options);
+int bench_corpus_run(FILE *stream, struct bench_options *options, const char *directory,
+		     const char *baseline_path, double tolerance);
+
+#endif /* PGB_BENCH_BENCH_H */
@@ -4,13 +4,14 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+/* Read-only and private to each includer, so programs can include this from several files */
 #if HAS_BIOS_ROM == 1
 #include <bios/nintendo_bios.h>
-const size_t internal_bios_rom_length = nintendo_bios_rom_length;
-uint8_t *internal_bios_rom = (uint8_t*) &nintendo_bios_rom;
+static const size_t internal_bios_rom_length = nintendo_bios_rom_length;
+static const uint8_t *const internal_bios_rom = (const uint8_t *) &nintendo_bios_rom;
 #else
-const size_t internal_bios_rom_length = 0;
-uint8_t *internal_bios_rom = NULL;
+static const size_t internal_bios_rom_length = 0;
+static const uint8_t *const internal_bios_rom = NULL;
 #endif
 
 #endif /* PGB_BIOS_H */
@@ -6,22 +6,54 @@
 #include <stdbool.h>
 #include <pgb/cpu/clock.h>
 #include <pgb/cpu/decoder.h>
+#include <pgb/cpu/flags.h>
 #include <pgb/cpu/registers.h>
 
 struct device;
 struct decoded_instruction;
 struct mmu;
+struct profile;
 enum instruction_operand;
 
+/*
+ * How often the CPU hands time to the rest of the device. The M-cycle core
+ * does so before every memory access, so that timers and DMA are seen as they
+ * are partway through an instruction, at some cost in speed.
+ */
+enum cpu_core {
+	CPU_CORE_INSTRUCTION,
+	CPU_CORE_MCYCLE
+};
+
+/*
+ * The page instructions are being fetched from, good for as long as the MMU
+ * stays at generation. See cpu_fetch_read8().
+ */
+struct cpu_code_page {
+	const uint8_t *data;
+	uint32_t generation;
+	uint8_t index;
+};
+
 struct cpu_status {
 	bool halted;
+	/* Set by STOP along with halted, a joypad line going low clears both */
+	bool stopped;
+	/* Interrupt master enable, set by EI and RETI */
+	bool ime;
 };
 
 struct cpu {
 	struct registers registers;
+	/* Only used by LAZY_FLAGS=1 builds, see cpu_flags_sync() */
+	struct lazy_flags lazy_flags;
 	struct clock clock;
 	struct cpu_status status;
 	struct decoder decoder;
+	enum cpu_core core;
+	struct cpu_code_page code;
+	/* Only used by PROFILE=1 builds, see profile_enable() */
+	struct profile *profile;
 };
 
 int cpu_step(struct device *device, size_t step, size_t *instructions_stepped);
@@ -29,6 +61,9 @@ int cpu_init(struct cpu *cpu, const char *decoder_str);
 int cpu_destroy(struct cpu *cpu);
 bool cpu_is_halted(struct cpu *cpu);
 void cpu_dump_register_state(struct cpu *cpu);
+int cpu_flags_sync(struct cpu *cpu);
+int cpu_tick(struct device *device, uint8_t cycles);
+int string_to_cpu_core(const char *str, enum cpu_core *core);
 
 int fetch(struct device *device, uint8_t *opcode, bool *found_prefix);
 int decode(struct device *device, uint8_t opcode, bool is_prefix, struct decoded_instruction *decoded_instruction);
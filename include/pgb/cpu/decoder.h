@@ -4,8 +4,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include <pgb/cpu/instruction_info.h>
+
 struct device;
-struct instruction_info;
 
 enum decoder_type {
 	DECODER_TYPE_LOGICAL,
@@ -24,18 +25,29 @@ struct decoded_instruction {
 		uint16_t u16;
 	} b;
 	uint8_t raw_data[4];
-	struct instruction_info *info;
+	/* T-cycles it took, taken or not, set by interpreter_execute_instruction() */
+	uint8_t cycles;
+	/* Of those, the ones the M-cycle core already handed to the device */
+	uint8_t elapsed;
+	const struct instruction_info *info;
 };
 
 struct decoder {
 	enum decoder_type type;
 	int (*decode)(struct device *device, uint8_t opcode, bool is_prefix, struct decoded_instruction *decoded_instruction);
+	/*
+	 * What the logical decoder worked out for the last instruction it
+	 * decoded, instructions it returns point here until the next decode.
+	 */
+	struct instruction_info logical;
 };
 
 int cpu_decoder_configure_decoder(enum decoder_type type, struct decoder *decoder);
 int string_to_decoder_type(const char *str, enum decoder_type *type);
 
-int cpu_decoder_get_instruction(uint8_t opcode, struct instruction_info **instruction_info);
-int cpu_decoder_get_prefix_cb_instruction(uint8_t opcode, struct instruction_info **instruction_info);
+int cpu_decoder_get_instruction(uint8_t opcode, const struct instruction_info **instruction_info);
+int cpu_decoder_get_prefix_cb_instruction(uint8_t opcode, const struct instruction_info **instruction_info);
+int cpu_decoder_get_instruction_text(uint8_t opcode, const struct instruction_text **text);
+int cpu_decoder_get_prefix_cb_instruction_text(uint8_t opcode, const struct instruction_text **text);
 
 #endif /* PGBA_CPU_DECODER_H */
@@ -0,0 +1,39 @@
+#ifndef PGB_CPU_FLAGS_H
+#define PGB_CPU_FLAGS_H
+
+#include <stdint.h>
+
+#define CPU_FLAG_ZERO        0x80
+#define CPU_FLAG_SUBTRACTION 0x40
+#define CPU_FLAG_HALF_CARRY  0x20
+#define CPU_FLAG_CARRY       0x10
+
+/* How F follows from the operands of the instruction that last set it */
+enum lazy_flags_op {
+	LAZY_FLAGS_OP_NONE,
+	LAZY_FLAGS_OP_ADD,      /* ADD and ADC: lhs + rhs + carry */
+	LAZY_FLAGS_OP_SUB,      /* SUB, SBC and CP: lhs - rhs - carry */
+	LAZY_FLAGS_OP_AND,      /* lhs is the result */
+	LAZY_FLAGS_OP_OR,       /* OR and XOR, lhs is the result */
+	LAZY_FLAGS_OP_INC,      /* lhs before the increment, C is kept */
+	LAZY_FLAGS_OP_DEC,      /* lhs before the decrement, C is kept */
+	LAZY_FLAGS_OP_ADD16,    /* ADD HL, rr: lhs + rhs, Z is kept */
+	LAZY_FLAGS_OP_ADD_SP,   /* ADD SP, i8 and LDHL: carries out of the low byte */
+	LAZY_FLAGS_OP_SHIFT,    /* CB rotates and shifts, lhs is the result, carry the bit shifted out */
+	LAZY_FLAGS_OP_ROTATE_A, /* RLCA, RLA, RRCA and RRA: as SHIFT, but Z is reset */
+	LAZY_FLAGS_OP_BIT,      /* lhs is the tested bit, C is kept */
+};
+
+/*
+ * The last flag setting instruction of a LAZY_FLAGS=1 build, which has not
+ * been folded into F yet. Anything outside the interpreter that reads or
+ * writes F calls cpu_flags_sync() first.
+ */
+struct lazy_flags {
+	uint16_t lhs;
+	uint16_t rhs;
+	uint8_t carry;
+	uint8_t op;
+};
+
+#endif /* PGB_CPU_FLAGS_H */
@@ -3,7 +3,6 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include <pgb/device/device.h>
 
 enum flag_modifier {
 	FLAG_MODIFIER_RESET_AFTER_INSTRUCTION = 0,
@@ -147,36 +146,44 @@ enum instruction_operand_modifier {
 	INSTRUCTION_OPERAND_MODIFIER_CB
 };
 
+/*
+ * What the decoders and the interpreter look at on every instruction, packed
+ * so that four opcodes share a cache line. The text of an opcode is only
+ * needed by the debugger and reports and lives in struct instruction_text.
+ */
 struct instruction_info {
-	const char *mnemonic;
-	const char *assembly;
+	enum instruction_class instruction_class : 8;
 	uint8_t opcode;
-	size_t num_bytes;
+	uint8_t num_bytes;
 	bool is_prefix;
 	struct {
-		size_t c0;
-		size_t c1;
+		uint8_t c0;
+		uint8_t c1;
 	} timing;
 	struct {
-		uint8_t flag_mask;
-		uint8_t flag_zero;
-		uint8_t flag_sub;
-		uint8_t flag_half_carry;
-		uint8_t flag_carry;
+		uint16_t flag_mask : 4;
+		uint16_t flag_zero : 2;
+		uint16_t flag_sub : 2;
+		uint16_t flag_half_carry : 2;
+		uint16_t flag_carry : 2;
 	} flag_modifiers;
 	struct {
 		struct {
-			enum instruction_operand_type type;
-			enum instruction_operand operand;
-			enum instruction_operand_modifier modifier;
+			enum instruction_operand_type type : 8;
+			enum instruction_operand operand : 8;
+			enum instruction_operand_modifier modifier : 8;
 		} a;
 		struct {
-			enum instruction_operand_type type;
-			enum instruction_operand operand;
-			enum instruction_operand_modifier modifier;
+			enum instruction_operand_type type : 8;
+			enum instruction_operand operand : 8;
+			enum instruction_operand_modifier modifier : 8;
 		} b;
 	} operands;
-	enum instruction_class instruction_class;
+};
+
+struct instruction_text {
+	const char *mnemonic;
+	const char *assembly;
 };
 
 #endif /* PGB_CPU_INSTRUCTION_INFO_H */
@@ -5,4 +5,11 @@
 
 #define DECODER_OPCODE_GET_FLD(OPCODE, FIELD, value) BF_GET_FLD(LR35902_OPCODE_##OPCODE##_FIELD_##FIELD, value)
 
+struct device;
+struct decoded_instruction;
+struct instruction_info;
+
+int cpu_decoder_read_operands(struct device *device, const struct instruction_info *instruction_info,
+			      struct decoded_instruction *decoded_instruction);
+
 #endif /* PGB_CPU_PRIVATE_DECODER_H */
@@ -0,0 +1,29 @@
+#ifndef PGB_CPU_PRIVATE_FETCH_H
+#define PGB_CPU_PRIVATE_FETCH_H
+
+#include <stdint.h>
+
+#include <pgb/device/device.h>
+
+int cpu_fetch_refill(struct device *device, uint16_t address, uint8_t *value);
+
+/*
+ * Reads a byte of the instruction stream straight out of the page the CPU is
+ * running from. The page is only looked up again when a fetch crosses into
+ * another one, or the MMU swaps pages or locks the bus and bumps its
+ * generation.
+ */
+static inline
+int cpu_fetch_read8(struct device *device, uint16_t address, uint8_t *value)
+{
+	struct cpu_code_page *code = &device->cpu.code;
+
+	if ((address >> MMU_PAGE_SHIFT) == code->index && code->generation == device->mmu.generation) {
+		*value = code->data[address & MMU_PAGE_MASK];
+		return 0;
+	}
+
+	return cpu_fetch_refill(device, address, value);
+}
+
+#endif /* PGB_CPU_PRIVATE_FETCH_H */
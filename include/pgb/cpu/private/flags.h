@@ -0,0 +1,123 @@
+#ifndef PGB_CPU_PRIVATE_FLAGS_H
+#define PGB_CPU_PRIVATE_FLAGS_H
+
+#include <stdint.h>
+
+#include <pgb/cpu/cpu.h>
+#include <pgb/cpu/flags.h>
+
+/* Flags op leaves as they were */
+static inline
+uint8_t flags_kept(enum lazy_flags_op op)
+{
+	switch (op) {
+	case LAZY_FLAGS_OP_NONE:
+		return 0xff;
+	case LAZY_FLAGS_OP_INC:
+	case LAZY_FLAGS_OP_DEC:
+	case LAZY_FLAGS_OP_BIT:
+		return CPU_FLAG_CARRY | 0x0f;
+	case LAZY_FLAGS_OP_ADD16:
+		return CPU_FLAG_ZERO | 0x0f;
+	default:
+		return 0x0f;
+	}
+}
+
+/* Works out F after op, given F before it */
+static inline
+uint8_t flags_compute(uint8_t f, enum lazy_flags_op op, uint16_t lhs, uint16_t rhs, uint8_t carry)
+{
+	uint8_t flags = 0;
+
+	switch (op) {
+	case LAZY_FLAGS_OP_NONE:
+		break;
+	case LAZY_FLAGS_OP_ADD:
+		flags |= (uint8_t)(lhs + rhs + carry) == 0 ? CPU_FLAG_ZERO : 0;
+		flags |= (lhs & 0xf) + (rhs & 0xf) + carry > 0xf ? CPU_FLAG_HALF_CARRY : 0;
+		flags |= lhs + rhs + carry > 0xff ? CPU_FLAG_CARRY : 0;
+		break;
+	case LAZY_FLAGS_OP_SUB:
+		flags |= CPU_FLAG_SUBTRACTION;
+		flags |= (uint8_t)(lhs - rhs - carry) == 0 ? CPU_FLAG_ZERO : 0;
+		flags |= (lhs & 0xf) < (rhs & 0xf) + carry ? CPU_FLAG_HALF_CARRY : 0;
+		flags |= lhs < rhs + carry ? CPU_FLAG_CARRY : 0;
+		break;
+	case LAZY_FLAGS_OP_AND:
+		flags |= CPU_FLAG_HALF_CARRY;
+		flags |= (uint8_t)lhs == 0 ? CPU_FLAG_ZERO : 0;
+		break;
+	case LAZY_FLAGS_OP_OR:
+		flags |= (uint8_t)lhs == 0 ? CPU_FLAG_ZERO : 0;
+		break;
+	case LAZY_FLAGS_OP_INC:
+		flags |= (uint8_t)(lhs + 1) == 0 ? CPU_FLAG_ZERO : 0;
+		flags |= (lhs & 0xf) == 0xf ? CPU_FLAG_HALF_CARRY : 0;
+		break;
+	case LAZY_FLAGS_OP_DEC:
+		flags |= CPU_FLAG_SUBTRACTION;
+		flags |= (uint8_t)(lhs - 1) == 0 ? CPU_FLAG_ZERO : 0;
+		flags |= (lhs & 0xf) == 0 ? CPU_FLAG_HALF_CARRY : 0;
+		break;
+	case LAZY_FLAGS_OP_ADD16:
+		flags |= (lhs & 0xfff) + (rhs & 0xfff) > 0xfff ? CPU_FLAG_HALF_CARRY : 0;
+		flags |= lhs + rhs > 0xffff ? CPU_FLAG_CARRY : 0;
+		break;
+	case LAZY_FLAGS_OP_ADD_SP:
+		flags |= (lhs & 0xf) + (rhs & 0xf) > 0xf ? CPU_FLAG_HALF_CARRY : 0;
+		flags |= (lhs & 0xff) + (rhs & 0xff) > 0xff ? CPU_FLAG_CARRY : 0;
+		break;
+	case LAZY_FLAGS_OP_SHIFT:
+		flags |= (uint8_t)lhs == 0 ? CPU_FLAG_ZERO : 0;
+		flags |= carry ? CPU_FLAG_CARRY : 0;
+		break;
+	case LAZY_FLAGS_OP_ROTATE_A:
+		flags |= carry ? CPU_FLAG_CARRY : 0;
+		break;
+	case LAZY_FLAGS_OP_BIT:
+		flags |= CPU_FLAG_HALF_CARRY;
+		flags |= (uint8_t)lhs == 0 ? CPU_FLAG_ZERO : 0;
+		break;
+	}
+
+	return (f & flags_kept(op)) | flags;
+}
+
+/* Folds the pending flags of a LAZY_FLAGS=1 build into F */
+static inline
+void flags_sync(struct cpu *cpu)
+{
+#if PGB_LAZY_FLAGS
+	struct lazy_flags *pending = &cpu->lazy_flags;
+
+	if (pending->op == LAZY_FLAGS_OP_NONE)
+		return;
+
+	cpu->registers.f = flags_compute(cpu->registers.f, pending->op, pending->lhs, pending->rhs, pending->carry);
+	pending->op = LAZY_FLAGS_OP_NONE;
+#endif
+}
+
+/*
+ * Sets the flags of an instruction. LAZY_FLAGS=1 builds only note down its
+ * operands, and work F out when a branch, PUSH AF or anyone else reads it.
+ */
+static inline
+void flags_set(struct cpu *cpu, enum lazy_flags_op op, uint16_t lhs, uint16_t rhs, uint8_t carry)
+{
+#if PGB_LAZY_FLAGS
+	/* What op keeps may still be pending */
+	if (flags_kept(op) != 0x0f)
+		flags_sync(cpu);
+
+	cpu->lazy_flags.lhs = lhs;
+	cpu->lazy_flags.rhs = rhs;
+	cpu->lazy_flags.carry = carry;
+	cpu->lazy_flags.op = op;
+#else
+	cpu->registers.f = flags_compute(cpu->registers.f, op, lhs, rhs, carry);
+#endif
+}
+
+#endif /* PGB_CPU_PRIVATE_FLAGS_H */
@@ -0,0 +1,39 @@
+#ifndef PGB_CPU_PRIVATE_PROFILE_H
+#define PGB_CPU_PRIVATE_PROFILE_H
+
+#include <stdbool.h>
+
+#include <pgb/cpu/cpu.h>
+#include <pgb/cpu/decoder.h>
+#include <pgb/cpu/instruction_info.h>
+#include <pgb/cpu/profile.h>
+
+/*
+ * Counts instruction, which has just been executed, and the cycles it took
+ * against its opcode and address. Compiles to nothing unless built with
+ * PROFILE=1.
+ */
+static inline
+void profile_record(struct cpu *cpu, struct decoded_instruction *instruction, uint16_t address, uint8_t opcode,
+		    bool is_prefix)
+{
+#if PGB_PROFILE
+	uint64_t cycles;
+	struct profile *profile = cpu->profile;
+	struct profile_counter *counter;
+
+	if (profile == NULL)
+		return;
+
+	cycles = instruction->cycles;
+
+	counter = is_prefix ? &profile->prefix_cb_opcodes[opcode] : &profile->opcodes[opcode];
+	counter->executions++;
+	counter->cycles += cycles;
+
+	profile->addresses[address].executions++;
+	profile->addresses[address].cycles += cycles;
+#endif
+}
+
+#endif /* PGB_CPU_PRIVATE_PROFILE_H */
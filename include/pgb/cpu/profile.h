@@ -0,0 +1,35 @@
+#ifndef PGB_CPU_PROFILE_H
+#define PGB_CPU_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct device;
+
+#define PROFILE_NUM_OPCODES 256
+#define PROFILE_NUM_ADDRESSES 0x10000
+
+struct profile_counter {
+	uint64_t executions;
+	uint64_t cycles;
+};
+
+/*
+ * Execution counters of one device, filled in by cpu_step() in builds made
+ * with PROFILE=1. Addresses are the PC an instruction was fetched from; there
+ * is no bank switching yet, so all code is reported as bank 0.
+ */
+struct profile {
+	struct profile_counter opcodes[PROFILE_NUM_OPCODES];
+	struct profile_counter prefix_cb_opcodes[PROFILE_NUM_OPCODES];
+	struct profile_counter addresses[PROFILE_NUM_ADDRESSES];
+};
+
+int profile_enable(struct device *device);
+int profile_disable(struct device *device);
+int profile_reset(struct device *device);
+int profile_report(struct device *device, FILE *stream, size_t top);
+int profile_dump(struct device *device, FILE *stream);
+
+#endif /* PGB_CPU_PROFILE_H */
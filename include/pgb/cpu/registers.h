@@ -46,5 +46,6 @@ struct registers {
 } __attribute__((packed));
 
 int registers_init(struct registers *registers);
+int registers_init_post_boot(struct registers *registers);
 
 #endif /* PGB_CPU_REGISTERS_H */
@@ -0,0 +1,59 @@
+#ifndef PGB_CPU_WIDE_H
+#define PGB_CPU_WIDE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pgb/utils.h>
+
+struct device;
+
+/* One byte per lane, so a register of every lane fits one 128-bit vector */
+#define WIDE_MAX_LANES 16
+
+typedef uint8_t wide_vec __attribute__((vector_size(WIDE_MAX_LANES)));
+
+enum wide_register {
+	WIDE_REGISTER_A,
+	WIDE_REGISTER_F,
+	WIDE_REGISTER_B,
+	WIDE_REGISTER_C,
+	WIDE_REGISTER_D,
+	WIDE_REGISTER_E,
+	WIDE_REGISTER_H,
+	WIDE_REGISTER_L,
+	WIDE_REGISTER_MAX
+};
+
+struct wide_stats {
+	/* Instructions fetched and decoded once for every running lane */
+	uint64_t lockstep;
+	/* Of those, the ones executed on the vector register file */
+	uint64_t vector;
+	/* Instructions stepped one lane at a time because PCs diverged */
+	uint64_t scalar;
+};
+
+/*
+ * Experimental lockstep engine for many devices running the same ROM. While
+ * every running lane sits on the same PC over the same code, the instruction
+ * is fetched and decoded once, and register-only instructions execute on a
+ * structure-of-arrays copy of the 8-bit registers, all lanes at a time. Any
+ * other instruction, or lanes that diverged, fall back to the scalar
+ * interpreter, so every lane ends up exactly where device_run_until() would
+ * have taken it.
+ */
+struct wide {
+	wide_vec registers[WIDE_REGISTER_MAX];
+	/* Set while registers holds the newest 8-bit registers of every lane */
+	bool gathered;
+	unsigned count;
+	struct device *lanes[WIDE_MAX_LANES];
+	struct wide_stats stats;
+} CACHE_ALIGNED;
+
+int wide_init(struct wide *wide, struct device **devices, unsigned count);
+int wide_run_until(struct wide *wide, uint64_t timestamp);
+int wide_run_frame(struct wide *wide);
+
+#endif /* PGB_CPU_WIDE_H */
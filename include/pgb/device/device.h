@@ -1,20 +1,39 @@
 #ifndef PGB_DEVICE_DEVICE_H
 #define PGB_DEVICE_DEVICE_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pgb/apu/apu.h>
 #include <pgb/cpu/cpu.h>
 #include <pgb/gpu/gpu.h>
+#include <pgb/joypad/joypad.h>
 #include <pgb/mmu/mmu.h>
+#include <pgb/scheduler/scheduler.h>
+#include <pgb/serial/serial.h>
+#include <pgb/state/hash.h>
+
+/* 154 lines of 456 T-cycles make up one frame */
+#define DEVICE_FRAME_CYCLES 70224
 
 enum device_setting {
 	DEVICE_SETTING_BOOT_ROM_PATH,
 	DEVICE_SETTING_CARTRIDGE_PATH,
-	DEVICE_SETTING_DECODER_TYPE
+	DEVICE_SETTING_DECODER_TYPE,
+	/* "instruction" or "mcycle", takes effect right away */
+	DEVICE_SETTING_CPU_CORE
 };
 
 struct device {
 	struct cpu cpu;
 	struct mmu mmu;
 	struct gpu gpu;
+	struct apu apu;
+	struct serial serial;
+	struct joypad joypad;
+	struct scheduler scheduler;
+	/* Memory hashes kept by device_state_hash() */
+	struct state_hash_cache hash;
 	struct {
 		const char *boot_rom_path;
 		const char *loaded_cart_path;
@@ -24,10 +43,15 @@ struct device {
 
 int device_init(struct device *device, const char *decoder_type);
 int device_destroy(struct device *device);
-int device_load_bios_from_address(struct device *device, uint8_t *data, size_t len);
+int device_clone(struct device *dst, struct device *src);
+int device_load_bios_from_address(struct device *device, const uint8_t *data, size_t len);
 int device_load_bios_from_file(struct device *device, const char *bios_path);
 int device_load_image_from_file(struct device *device, const char *rom_path);
+int device_load_image_without_bios(struct device *device, const char *rom_path);
 int device_reset_system(struct device *device, const char *decoder_type, const char *boot_rom_path);
 int device_configure_setting(struct device *device, enum device_setting setting, const char *value);
+int device_run_until(struct device *device, uint64_t timestamp);
+int device_run_frame(struct device *device);
+int device_run_until_serial_match(struct device *device, const char *pattern, uint64_t max_cycles, bool *matched);
 
 #endif /* PGB_DEVICE_DEVICE_H */
@@ -49,22 +49,22 @@
 #define LR35902_IO_REGS_NR10_SWEEP_MODIFIER_ADDITION                    0
 #define LR35902_IO_REGS_NR10_SWEEP_MODIFIER_SUBTRACTION                 1
 #define LR35902_IO_REGS_NR10_SWEEP_TIME                                 6:4
-#define LR35902_IO_REGS_NR11                                            0xff12 /* RW */
+#define LR35902_IO_REGS_NR11                                            0xff11 /* RW */
 #define LR35902_IO_REGS_NR11_SOUND_LENGTH_DATA                          5:0
 #define LR35902_IO_REGS_NR11_WAVE_DUTY_PATTERN                          7:6
 #define LR35902_IO_REGS_NR11_12_5_PERCENT                               0
 #define LR35902_IO_REGS_NR11_25_PERCENT                                 1
 #define LR35902_IO_REGS_NR11_50_PERCENT                                 2
 #define LR35902_IO_REGS_NR11_75_PERCENT                                 3
-#define LR35902_IO_REGS_NR12                                            0xff13 /* RW */
+#define LR35902_IO_REGS_NR12                                            0xff12 /* RW */
 #define LR35902_IO_REGS_NR12_NUM_ENVELOPE_SWEEP                         2:0
 #define LR35902_IO_REGS_NR12_ENVELOPE_DIRECTION                         3:3
 #define LR35902_IO_REGS_NR12_ENVELOPE_DIRECTION_ATTENUATE               0
 #define LR35902_IO_REGS_NR12_ENVELOPE_DIRECTION_AMPLIFY                 1
 #define LR35902_IO_REGS_NR12_INITIAL_VOLUME_ENVELOPE                    7:4
-#define LR35902_IO_REGS_NR13                                            0xff14 /* W */
+#define LR35902_IO_REGS_NR13                                            0xff13 /* W */
 #define LR35902_IO_REGS_NR13_FREQUENCY_LSW                              7:0
-#define LR35902_IO_REGS_NR14                                            0xff15 /* RW */
+#define LR35902_IO_REGS_NR14                                            0xff14 /* RW */
 #define LR35902_IO_REGS_NR14_FREQUENCY_MSW                              2:0
 #define LR35902_IO_REGS_NR14_COUNTER                                    6:6
 #define LR35902_IO_REGS_NR14_COUNTER_CONSECUTIVE                        0
@@ -127,6 +127,10 @@
 #define LR35902_IO_REGS_NR43_DIVIDER_TIMES_1_OVER_5                     5
 #define LR35902_IO_REGS_NR43_DIVIDER_TIMES_1_OVER_6                     6
 #define LR35902_IO_REGS_NR43_DIVIDER_TIMES_1_OVER_7                     7
+#define LR35902_IO_REGS_NR43_COUNTER_STEP                               3:3
+#define LR35902_IO_REGS_NR43_COUNTER_STEP_15_BITS                       0
+#define LR35902_IO_REGS_NR43_COUNTER_STEP_7_BITS                        1
+#define LR35902_IO_REGS_NR43_SHIFT_CLOCK_FREQUENCY                      7:4
 #define LR35902_IO_REGS_NR44                                            0xff23 /* RW */
 #define LR35902_IO_REGS_NR44_COUNTER                                    6:6
 #define LR35902_IO_REGS_NR44_COUNTER_CONSECUTIVE                        0
@@ -166,6 +170,8 @@
 #define LR35902_IO_REGS_NR52_SOUND1                                     0:0
 #define LR35902_IO_REGS_NR52_SOUND1_DISABLE                             0
 #define LR35902_IO_REGS_NR52_SOUND1_ENABLE                              1
+#define LR35902_IO_REGS_WAVE_RAM_START                                  0xff30 /* RW */
+#define LR35902_IO_REGS_WAVE_RAM_END                                    0xff3f /* RW */
 #define LR35902_IO_REGS_LCDC                                            0xff40 /* RW */
 #define LR35902_IO_REGS_LCDC_CONTROL                                    7:7
 #define LR35902_IO_REGS_LCDC_CONTROL_STOP                               0
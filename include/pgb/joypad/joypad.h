@@ -0,0 +1,30 @@
+#ifndef PGB_JOYPAD_JOYPAD_H
+#define PGB_JOYPAD_JOYPAD_H
+
+#include <stdint.h>
+
+struct device;
+
+/* One bit per button, set while it is held */
+enum joypad_button {
+	JOYPAD_BUTTON_RIGHT  = 1 << 0,
+	JOYPAD_BUTTON_LEFT   = 1 << 1,
+	JOYPAD_BUTTON_UP     = 1 << 2,
+	JOYPAD_BUTTON_DOWN   = 1 << 3,
+	JOYPAD_BUTTON_A      = 1 << 4,
+	JOYPAD_BUTTON_B      = 1 << 5,
+	JOYPAD_BUTTON_SELECT = 1 << 6,
+	JOYPAD_BUTTON_START  = 1 << 7
+};
+
+struct joypad {
+	uint8_t buttons;
+};
+
+int joypad_init(struct joypad *joypad);
+int joypad_set_buttons(struct device *device, uint8_t buttons);
+
+int joypad_read_p1(struct device *device, uint8_t *result);
+int joypad_write_p1(struct device *device, uint8_t value);
+
+#endif /* PGB_JOYPAD_JOYPAD_H */
@@ -1,16 +1,64 @@
 #ifndef PGB_MMU_H
 #define PGB_MMU_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#define MMU_PAGE_SHIFT 12
+#define MMU_PAGE_SIZE (1 << MMU_PAGE_SHIFT)
+#define MMU_PAGE_MASK (MMU_PAGE_SIZE - 1)
+#define MMU_NUM_PAGES 16
+
+/* Writes are tracked in 256 byte blocks, one bit each */
+#define MMU_DIRTY_BLOCK_SHIFT 8
+#define MMU_DIRTY_BLOCK_SIZE (1 << MMU_DIRTY_BLOCK_SHIFT)
+#define MMU_NUM_DIRTY_BLOCKS (MMU_NUM_PAGES << (MMU_PAGE_SHIFT - MMU_DIRTY_BLOCK_SHIFT))
+#define MMU_DIRTY_WORDS (MMU_NUM_DIRTY_BLOCKS / 64)
+
+/*
+ * Each consumer of dirty tracking has its own bitmap, so clearing one does
+ * not hide writes from the others.
+ */
+enum mmu_dirty_channel {
+	/* Free for snapshot code in the frontend */
+	MMU_DIRTY_CHANNEL_SNAPSHOT,
+	/* Owned by device_state_hash() */
+	MMU_DIRTY_CHANNEL_HASH,
+	MMU_DIRTY_CHANNEL_MAX
+};
+
+/*
+ * The address space is backed by refcounted pages so that cloned devices
+ * share memory until one of them writes to a page.
+ */
+struct mmu_page {
+	atomic_uint refcount;
+	uint8_t data[MMU_PAGE_SIZE];
+};
+
 struct mmu {
-	uint8_t *ram;
+	struct mmu_page *pages[MMU_NUM_PAGES];
+	/* Pages that may be shared and have to be copied before a write */
+	uint16_t shared;
+	/* Blocks written since the last mmu_dirty_clear() of each channel */
+	uint64_t dirty[MMU_DIRTY_CHANNEL_MAX][MMU_DIRTY_WORDS];
 	size_t size;
+	/*
+	 * Bumped whenever a page is swapped for another or OAM DMA locks or
+	 * releases the bus, so that host pointers into pages are looked up again
+	 */
+	uint32_t generation;
+	struct {
+		/* While set, the CPU can only reach 0xff00-0xffff */
+		bool active;
+	} oam_dma;
 };
 
 int mmu_init(struct mmu *mmu);
 int mmu_destroy(struct mmu *mmu);
+int mmu_clone(struct mmu *dst, struct mmu *src);
 
 int mmu_read8(struct mmu *mmu, uint16_t address, uint8_t *result);
 int mmu_read16(struct mmu *mmu, uint16_t address, uint16_t *result);
@@ -18,6 +66,14 @@ int mmu_read16(struct mmu *mmu, uint16_t address, uint16_t *result);
 int mmu_write8(struct mmu *mmu, uint16_t address, uint8_t value);
 int mmu_write16(struct mmu *mmu, uint16_t address, uint16_t value);
 
+int mmu_oam_dma_start(struct mmu *mmu, uint8_t source_page);
+int mmu_oam_dma_complete(struct mmu *mmu);
+
+int mmu_copy_in(struct mmu *mmu, uint32_t address, const void *data, size_t length);
+int mmu_copy_out(struct mmu *mmu, uint32_t address, void *buffer, size_t length);
+int mmu_unshare_all(struct mmu *mmu);
+int mmu_dirty_get(struct mmu *mmu, enum mmu_dirty_channel channel, uint64_t dirty[MMU_DIRTY_WORDS]);
+int mmu_dirty_clear(struct mmu *mmu, enum mmu_dirty_channel channel);
 int mmu_read_region(struct mmu *mmu, uint16_t base_address, uint8_t *buffer, size_t *size);
 
 #endif /* PGB_MMU_H */
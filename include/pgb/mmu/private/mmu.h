@@ -1,9 +1,68 @@
 #ifndef PGB_MMU_PRIVATE_MMU_H
 #define PGB_MMU_PRIVATE_MMU_H
 
+#include <pgb/mmu/mmu.h>
 #include <pgb/mmu/private/mmu_appendix.h>
 #include <pgb/mmu/private/mmu_constants.h>
 
 #define MMU_REGION_SIZE(REGION) (LR35902_MMU_REGION_##REGION##_END -  LR35902_MMU_REGION_##REGION##_START + 1)
 
+_Static_assert(MMU_NUM_PAGES * MMU_PAGE_SIZE == LR35902_MMU_MEMORY_SIZE, "pages must cover the address space");
+
+int mmu_page_unshare(struct mmu *mmu, unsigned index);
+
+/*
+ * mmu_peek() and mmu_poke() are raw host-side accesses. They bypass I/O
+ * register side effects and the DMA bus lock, but still honour sharing.
+ */
+static inline
+uint8_t mmu_peek(struct mmu *mmu, uint16_t address)
+{
+	return mmu->pages[address >> MMU_PAGE_SHIFT]->data[address & MMU_PAGE_MASK];
+}
+
+static inline
+void mmu_dirty_mark(struct mmu *mmu, uint16_t address)
+{
+	int i;
+	unsigned block = address >> MMU_DIRTY_BLOCK_SHIFT;
+
+	for (i = 0; i < MMU_DIRTY_CHANNEL_MAX; i++)
+		mmu->dirty[i][block / 64] |= UINT64_C(1) << (block % 64);
+}
+
+/* Marks every block overlapping [address, address + length) */
+static inline
+void mmu_dirty_mark_range(struct mmu *mmu, uint32_t address, size_t length)
+{
+	int i;
+	uint32_t block;
+
+	if (length == 0)
+		return;
+
+	for (block = address >> MMU_DIRTY_BLOCK_SHIFT; block <= (address + length - 1) >> MMU_DIRTY_BLOCK_SHIFT; block++) {
+		for (i = 0; i < MMU_DIRTY_CHANNEL_MAX; i++)
+			mmu->dirty[i][block / 64] |= UINT64_C(1) << (block % 64);
+	}
+}
+
+static inline
+int mmu_poke(struct mmu *mmu, uint16_t address, uint8_t value)
+{
+	int ret;
+	unsigned index = address >> MMU_PAGE_SHIFT;
+
+	if (mmu->shared & (1 << index)) {
+		ret = mmu_page_unshare(mmu, index);
+		if (ret)
+			return ret;
+	}
+
+	mmu->pages[index]->data[address & MMU_PAGE_MASK] = value;
+	mmu_dirty_mark(mmu, address);
+
+	return 0;
+}
+
 #endif /* PGB_MMU_PRIVATE_MMU_H */
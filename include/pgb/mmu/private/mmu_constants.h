@@ -3,5 +3,7 @@
 
 #define LR35902_MMU_MEMORY_SIZE                                           65536
 #define LR35902_MMU_NUM_REGIONS                                              10
+#define LR35902_MMU_OAM_DMA_LENGTH                                          160
+#define LR35902_MMU_OAM_DMA_CYCLES                                          640
 
 #endif /* PGB_MMU_PRIVATE_MMU_CONSTANTS_H */
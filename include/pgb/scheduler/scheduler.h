@@ -0,0 +1,33 @@
+#ifndef PGB_SCHEDULER_SCHEDULER_H
+#define PGB_SCHEDULER_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct device;
+
+#define SCHEDULER_NEVER UINT64_MAX
+
+/*
+ * Each event type owns a single slot, so an event is either pending with one
+ * deadline or not pending at all. Deadlines are expressed in T-cycles.
+ */
+enum scheduler_event {
+	SCHEDULER_EVENT_SERIAL_TRANSFER,
+	SCHEDULER_EVENT_OAM_DMA,
+	SCHEDULER_EVENT_MAX
+};
+
+struct scheduler {
+	uint64_t timestamp;
+	uint64_t next_deadline;
+	uint64_t deadlines[SCHEDULER_EVENT_MAX];
+};
+
+int scheduler_init(struct scheduler *scheduler);
+int scheduler_schedule(struct scheduler *scheduler, enum scheduler_event event, uint64_t delay);
+int scheduler_cancel(struct scheduler *scheduler, enum scheduler_event event);
+bool scheduler_is_pending(struct scheduler *scheduler, enum scheduler_event event);
+int scheduler_advance(struct device *device, uint64_t cycles);
+
+#endif /* PGB_SCHEDULER_SCHEDULER_H */
@@ -0,0 +1,37 @@
+#ifndef PGB_SERIAL_SERIAL_H
+#define PGB_SERIAL_SERIAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct device;
+
+enum serial_transport {
+	/* Nothing is plugged into the link port */
+	SERIAL_TRANSPORT_DISCONNECTED,
+	/* Every byte shifted out through SB is appended to the output buffer */
+	SERIAL_TRANSPORT_CAPTURE
+};
+
+struct serial {
+	enum serial_transport transport;
+	bool transfer_active;
+	struct {
+		uint8_t *data;
+		size_t length;
+		size_t capacity;
+	} output;
+};
+
+int serial_init(struct serial *serial);
+int serial_destroy(struct serial *serial);
+int serial_clone(struct serial *dst, struct serial *src);
+int serial_set_transport(struct serial *serial, enum serial_transport transport);
+int serial_get_output(struct serial *serial, const uint8_t **data, size_t *length);
+int serial_clear_output(struct serial *serial);
+
+int serial_write_sc(struct device *device, uint8_t value);
+int serial_transfer_complete(struct device *device);
+
+#endif /* PGB_SERIAL_SERIAL_H */
@@ -0,0 +1,30 @@
+#ifndef PGB_STATE_HASH_H
+#define PGB_STATE_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pgb/mmu/mmu.h>
+
+struct device;
+
+struct state_hash {
+	uint64_t low;
+	uint64_t high;
+};
+
+/*
+ * Memory is hashed per dirty block. The hash of the whole address space is
+ * the sum of the block hashes, so a block that changed is swapped out of it
+ * without touching the others.
+ */
+struct state_hash_cache {
+	struct state_hash blocks[MMU_NUM_DIRTY_BLOCKS];
+	struct state_hash memory;
+};
+
+int state_hash_init(struct state_hash_cache *cache);
+int state_hash_buffer(const void *data, size_t length, struct state_hash *hash);
+int device_state_hash(struct device *device, struct state_hash *hash);
+
+#endif /* PGB_STATE_HASH_H */
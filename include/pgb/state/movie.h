@@ -0,0 +1,59 @@
+#ifndef PGB_STATE_MOVIE_H
+#define PGB_STATE_MOVIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pgb/state/hash.h>
+
+struct device;
+
+#define MOVIE_MAGIC "PGBM"
+#define MOVIE_VERSION 1
+
+/* The movie starts from an embedded save state rather than from power-on */
+#define MOVIE_FLAG_FROM_STATE (1 << 0)
+
+/*
+ * A movie file is this header, the initial save state if any, one joypad
+ * byte per frame and then one state hash every hash_interval frames.
+ */
+struct movie_header {
+	uint8_t magic[4];
+	uint16_t version;
+	uint16_t flags;
+	uint32_t hash_interval;
+	uint32_t frames;
+	uint32_t hashes;
+	uint32_t state_size;
+	/* Of 0x0000-0x7fff once the initial state is in place */
+	struct state_hash rom_hash;
+} __attribute__((packed));
+
+struct movie {
+	uint16_t flags;
+	uint32_t hash_interval;
+	struct state_hash rom_hash;
+	uint8_t *state;
+	size_t state_size;
+	struct {
+		uint8_t *data;
+		size_t length;
+		size_t capacity;
+	} inputs;
+	struct {
+		struct state_hash *data;
+		size_t length;
+		size_t capacity;
+	} hashes;
+};
+
+int movie_init(struct movie *movie, uint32_t hash_interval);
+int movie_destroy(struct movie *movie);
+int movie_record_begin(struct movie *movie, struct device *device, uint16_t flags);
+int movie_record_frame(struct movie *movie, struct device *device, uint8_t buttons);
+int movie_play(struct movie *movie, struct device *device, uint32_t *frame);
+int movie_save(struct movie *movie, int fd);
+int movie_load(struct movie *movie, int fd);
+
+#endif /* PGB_STATE_MOVIE_H */
@@ -0,0 +1,11 @@
+#ifndef PGB_STATE_PRIVATE_STATE_H
+#define PGB_STATE_PRIVATE_STATE_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+/* Retry on EINTR and short transfers, shared by the state file formats */
+int state_writev(int fd, struct iovec *iov, int count);
+int state_read(int fd, void *buffer, size_t size);
+
+#endif /* PGB_STATE_PRIVATE_STATE_H */
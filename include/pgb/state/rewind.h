@@ -0,0 +1,44 @@
+#ifndef PGB_STATE_REWIND_H
+#define PGB_STATE_REWIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct device;
+
+struct rewind_snapshot {
+	uint64_t timestamp;
+	/* Compressed XOR of this snapshot against the next newer one */
+	uint8_t *delta;
+	size_t length;
+};
+
+/*
+ * History is kept as the newest snapshot in full plus a list of backward
+ * deltas, oldest first. Dropping the oldest snapshot never touches the others
+ * and going back n snapshots applies n deltas to a copy of the newest one.
+ */
+struct rewind {
+	/* Frames between two snapshots */
+	unsigned interval;
+	/* Upper bound on the memory held by the history, buffers included */
+	size_t budget;
+	size_t used;
+	size_t state_size;
+	uint64_t next_capture;
+	uint64_t timestamp;
+	/* Newest snapshot in full, or NULL before the first capture */
+	uint8_t *current;
+	uint8_t *scratch;
+	uint8_t *encoded;
+	struct rewind_snapshot *snapshots;
+	size_t count;
+	size_t capacity;
+};
+
+int rewind_init(struct rewind *rewind, struct device *device, unsigned interval, size_t budget);
+int rewind_destroy(struct rewind *rewind);
+int rewind_capture(struct rewind *rewind, struct device *device);
+int rewind_step_back(struct rewind *rewind, struct device *device, uint64_t frames);
+
+#endif /* PGB_STATE_REWIND_H */
@@ -0,0 +1,51 @@
+#ifndef PGB_STATE_STATE_H
+#define PGB_STATE_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct device;
+
+#define STATE_MAGIC "PGBS"
+#define STATE_VERSION 4
+
+/*
+ * A save state is a header followed by sections, each a small header and the
+ * raw bytes of the structs it covers. Section sizes double as a layout check:
+ * a state only loads into a build whose structs have the same size.
+ */
+enum state_section {
+	STATE_SECTION_CPU = 1,
+	STATE_SECTION_CLOCK,
+	STATE_SECTION_GPU,
+	STATE_SECTION_MMU,
+	/* Reserved for cartridge mapper state, no mapper is emulated yet */
+	STATE_SECTION_MAPPER,
+	STATE_SECTION_SCHEDULER,
+	STATE_SECTION_SERIAL,
+	STATE_SECTION_APU,
+	STATE_SECTION_JOYPAD,
+	STATE_SECTION_MAX
+};
+
+struct state_header {
+	uint8_t magic[4];
+	uint16_t version;
+	uint16_t sections;
+	/* Whole state, this header included */
+	uint32_t size;
+} __attribute__((packed));
+
+struct state_section_header {
+	uint16_t id;
+	uint16_t reserved;
+	uint32_t size;
+} __attribute__((packed));
+
+size_t state_size(struct device *device);
+int state_save(struct device *device, int fd);
+int state_save_buffer(struct device *device, void *buffer, size_t *size);
+int state_load(struct device *device, int fd);
+int state_load_buffer(struct device *device, const void *buffer, size_t size);
+
+#endif /* PGB_STATE_STATE_H */
@@ -2,6 +2,7 @@
 #define PGB_TUI_TUI_H
 
 #include <ncurses.h>
+#include <signal.h>
 #include <sys/queue.h>
 
 struct device;
@@ -27,6 +28,8 @@ struct libpgb_tui_state {
 	struct device *device;
 	struct pgb_tui_breakpoint *breakpoints;
 	char previous_cmd[1024];
+	/* Set from the SIGINT handler to stop a running command */
+	volatile sig_atomic_t interrupted;
 };
 
 struct tui_cmd {
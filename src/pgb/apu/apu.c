@@ -0,0 +1,733 @@
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <pgb/apu/apu.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/io/private/io.h>
+#include <pgb/utils.h>
+
+#define APU_REG(name) (LR35902_IO_REGS_##name - APU_REGISTERS_START)
+/* Each channel owns five consecutive registers, NRx0 through NRx4 */
+#define CHANNEL_REG(id, n) ((id) * 5 + (n))
+#define CHANNEL_REGISTERS_END CHANNEL_REG(APU_NUM_CHANNELS, 0)
+#define WAVE_RAM_OFFSET (LR35902_IO_REGS_WAVE_RAM_START - APU_REGISTERS_START)
+
+#define LENGTH_MAX 64
+#define WAVE_LENGTH_MAX 256
+#define FREQUENCY_MAX 2047
+#define LFSR_SEED 0x7fff
+
+/* Unused and write-only bits read back as ones */
+static const uint8_t apu_read_masks[APU_NUM_REGISTERS] = {
+	0x80, 0x3f, 0x00, 0xff, 0xbf,	/* NR10 - NR14 */
+	0xff, 0x3f, 0x00, 0xff, 0xbf,	/* NR20 - NR24 */
+	0x7f, 0xff, 0x9f, 0xff, 0xbf,	/* NR30 - NR34 */
+	0xff, 0xff, 0x00, 0x00, 0xbf,	/* NR40 - NR44 */
+	0x00, 0x00, 0x70,		/* NR50 - NR52 */
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+/* Indexed by NRx1 duty, bit n is the output of waveform step n */
+static const uint8_t apu_duty_patterns[] = { 0x01, 0x81, 0x87, 0x7e };
+static const uint8_t apu_noise_divisors[] = { 8, 16, 32, 48, 64, 80, 96, 112 };
+
+static inline
+bool apu_synthesizing(struct apu *apu)
+{
+	return apu->mode == APU_MODE_SYNTHESIS && apu->output != NULL;
+}
+
+static
+uint16_t apu_channel_frequency(struct apu *apu, enum apu_channel_id id)
+{
+	return apu->registers[CHANNEL_REG(id, 3)] |
+		(IRF_GET_VALUE(NR14, FREQUENCY_MSW, apu->registers[CHANNEL_REG(id, 4)]) << 8);
+}
+
+static
+uint32_t apu_channel_period(struct apu *apu, enum apu_channel_id id)
+{
+	uint8_t nr43, shift;
+
+	switch (id) {
+	case APU_CHANNEL_SQUARE1:
+	case APU_CHANNEL_SQUARE2:
+		return (FREQUENCY_MAX + 1 - apu_channel_frequency(apu, id)) * 4;
+	case APU_CHANNEL_WAVE:
+		return (FREQUENCY_MAX + 1 - apu_channel_frequency(apu, id)) * 2;
+	case APU_CHANNEL_NOISE:
+		nr43 = apu->registers[APU_REG(NR43)];
+		shift = IRF_GET_VALUE(NR43, SHIFT_CLOCK_FREQUENCY, nr43);
+		/* Shifts of 14 and 15 leave the LFSR unclocked */
+		if (shift >= 14)
+			return UINT32_MAX;
+		return apu_noise_divisors[IRF_GET_VALUE(NR43, DIVIDER, nr43)] << shift;
+	default:
+		return UINT32_MAX;
+	}
+}
+
+/* Digital output of a channel, 0 - 15 */
+static
+int apu_channel_level(struct apu *apu, enum apu_channel_id id)
+{
+	uint8_t duty, sample, level;
+	struct apu_channel *channel = &apu->channels[id];
+
+	if (!channel->enabled || !channel->dac_enabled)
+		return 0;
+
+	switch (id) {
+	case APU_CHANNEL_SQUARE1:
+	case APU_CHANNEL_SQUARE2:
+		duty = IRF_GET_VALUE(NR11, WAVE_DUTY_PATTERN, apu->registers[CHANNEL_REG(id, 1)]);
+		return (apu_duty_patterns[duty] >> channel->position) & 1 ? channel->volume : 0;
+	case APU_CHANNEL_WAVE:
+		level = IRF_GET_VALUE(NR32, OUTPUT_LEVEL, apu->registers[APU_REG(NR32)]);
+		if (level == LR35902_IO_REGS_NR32_OUTPUT_LEVEL_MUTE)
+			return 0;
+		/* Two samples per byte, high nibble first */
+		sample = apu->registers[WAVE_RAM_OFFSET + channel->position / 2];
+		sample = channel->position & 1 ? sample & 0xf : sample >> 4;
+		return sample >> (level - 1);
+	case APU_CHANNEL_NOISE:
+		return apu->lfsr & 1 ? 0 : channel->volume;
+	default:
+		return 0;
+	}
+}
+
+/* True when stepping the waveform cannot change the channel's output */
+static
+bool apu_channel_is_silent(struct apu *apu, enum apu_channel_id id)
+{
+	struct apu_channel *channel = &apu->channels[id];
+
+	if (!channel->enabled || !channel->dac_enabled)
+		return true;
+
+	if (!(apu->channel_mask & APU_CHANNEL_MASK(id)))
+		return true;
+
+	if (id == APU_CHANNEL_WAVE)
+		return IRF_GET_VALUE(NR32, OUTPUT_LEVEL, apu->registers[APU_REG(NR32)]) == LR35902_IO_REGS_NR32_OUTPUT_LEVEL_MUTE;
+
+	return channel->volume == 0;
+}
+
+static
+void apu_channel_update(struct apu *apu, enum apu_channel_id id, uint64_t timestamp)
+{
+	int level, delta;
+	struct apu_channel *channel = &apu->channels[id];
+
+	level = apu_channel_level(apu, id);
+	delta = level - channel->output;
+	if (delta == 0)
+		return;
+
+	channel->output = level;
+
+	if (apu_synthesizing(apu))
+		apu_synth_add_delta(&apu->synth, timestamp, id, delta);
+}
+
+static
+void apu_channel_step(struct apu *apu, enum apu_channel_id id)
+{
+	uint16_t feedback;
+	struct apu_channel *channel = &apu->channels[id];
+
+	switch (id) {
+	case APU_CHANNEL_SQUARE1:
+	case APU_CHANNEL_SQUARE2:
+		channel->position = (channel->position + 1) & 7;
+		break;
+	case APU_CHANNEL_WAVE:
+		channel->position = (channel->position + 1) & 31;
+		break;
+	case APU_CHANNEL_NOISE:
+		feedback = (apu->lfsr ^ (apu->lfsr >> 1)) & 1;
+		apu->lfsr = (apu->lfsr >> 1) | (feedback << 14);
+		if (IRF_GET_VALUE(NR43, COUNTER_STEP, apu->registers[APU_REG(NR43)]) == LR35902_IO_REGS_NR43_COUNTER_STEP_7_BITS)
+			apu->lfsr = (apu->lfsr & ~(1 << 6)) | (feedback << 6);
+		break;
+	default:
+		break;
+	}
+}
+
+static
+void apu_channel_run(struct apu *apu, enum apu_channel_id id, uint64_t start, uint64_t end)
+{
+	uint64_t timestamp, remaining, steps;
+	struct apu_channel *channel = &apu->channels[id];
+
+	if (!channel->enabled)
+		return;
+
+	/*
+	 * Nothing audible can happen, so only the waveform phase is carried
+	 * forward. The LFSR is left alone: its state is not visible to the game.
+	 */
+	if (!apu_synthesizing(apu) || apu_channel_is_silent(apu, id)) {
+		remaining = end - start;
+		if (remaining < channel->timer) {
+			channel->timer -= remaining;
+			return;
+		}
+
+		remaining -= channel->timer;
+		steps = 1 + remaining / channel->period;
+		channel->timer = channel->period - remaining % channel->period;
+
+		if (id != APU_CHANNEL_NOISE)
+			channel->position = (channel->position + steps) & (id == APU_CHANNEL_WAVE ? 31 : 7);
+		return;
+	}
+
+	timestamp = start;
+	while (channel->timer <= end - timestamp) {
+		timestamp += channel->timer;
+		channel->timer = channel->period;
+		apu_channel_step(apu, id);
+		apu_channel_update(apu, id, timestamp);
+	}
+	channel->timer -= end - timestamp;
+}
+
+/* Computes the next sweep frequency, disabling square 1 on overflow */
+static
+uint16_t apu_sweep_calculate(struct apu *apu, uint64_t timestamp)
+{
+	uint8_t nr10;
+	uint16_t delta, frequency;
+
+	nr10 = apu->registers[APU_REG(NR10)];
+	delta = apu->sweep.shadow_frequency >> IRF_GET_VALUE(NR10, SWEEP_SHIFT, nr10);
+
+	if (IRF_GET_VALUE(NR10, SWEEP_MODIFIER, nr10) == LR35902_IO_REGS_NR10_SWEEP_MODIFIER_SUBTRACTION)
+		frequency = apu->sweep.shadow_frequency - delta;
+	else
+		frequency = apu->sweep.shadow_frequency + delta;
+
+	if (frequency > FREQUENCY_MAX) {
+		apu->channels[APU_CHANNEL_SQUARE1].enabled = false;
+		apu_channel_update(apu, APU_CHANNEL_SQUARE1, timestamp);
+	}
+
+	return frequency;
+}
+
+static
+void apu_clock_sweep(struct apu *apu, uint64_t timestamp)
+{
+	uint8_t nr10, time, shift;
+	uint16_t frequency;
+
+	if (apu->sweep.timer > 1) {
+		apu->sweep.timer--;
+		return;
+	}
+
+	nr10 = apu->registers[APU_REG(NR10)];
+	time = IRF_GET_VALUE(NR10, SWEEP_TIME, nr10);
+	shift = IRF_GET_VALUE(NR10, SWEEP_SHIFT, nr10);
+
+	apu->sweep.timer = time ? time : 8;
+	if (!apu->sweep.enabled || !time)
+		return;
+
+	frequency = apu_sweep_calculate(apu, timestamp);
+	if (frequency > FREQUENCY_MAX || !shift)
+		return;
+
+	apu->sweep.shadow_frequency = frequency;
+	apu->registers[APU_REG(NR13)] = frequency & 0xff;
+	apu->registers[APU_REG(NR14)] = IRF_SET_VALUE(NR14, FREQUENCY_MSW, frequency >> 8, apu->registers[APU_REG(NR14)]);
+	apu->channels[APU_CHANNEL_SQUARE1].period = apu_channel_period(apu, APU_CHANNEL_SQUARE1);
+
+	/* The new frequency is checked for overflow once more, but not applied */
+	apu_sweep_calculate(apu, timestamp);
+}
+
+static
+void apu_clock_length(struct apu *apu, uint64_t timestamp)
+{
+	int id;
+	struct apu_channel *channel;
+
+	for (id = 0; id < APU_NUM_CHANNELS; id++) {
+		channel = &apu->channels[id];
+
+		if (!channel->length_enabled || channel->length == 0)
+			continue;
+
+		if (--channel->length == 0) {
+			channel->enabled = false;
+			apu_channel_update(apu, id, timestamp);
+		}
+	}
+}
+
+static
+void apu_clock_envelope(struct apu *apu, uint64_t timestamp)
+{
+	static const enum apu_channel_id ids[] = { APU_CHANNEL_SQUARE1, APU_CHANNEL_SQUARE2, APU_CHANNEL_NOISE };
+	size_t i;
+	uint8_t nrx2, period;
+	struct apu_channel *channel;
+
+	for (i = 0; i < ARRAY_SIZE(ids); i++) {
+		channel = &apu->channels[ids[i]];
+		/* NR22 and NR42 share the NR12 layout */
+		nrx2 = apu->registers[CHANNEL_REG(ids[i], 2)];
+		period = IRF_GET_VALUE(NR12, NUM_ENVELOPE_SWEEP, nrx2);
+
+		if (!period)
+			continue;
+
+		if (channel->envelope_timer > 1) {
+			channel->envelope_timer--;
+			continue;
+		}
+
+		channel->envelope_timer = period;
+
+		if (IRF_GET_VALUE(NR12, ENVELOPE_DIRECTION, nrx2) == LR35902_IO_REGS_NR12_ENVELOPE_DIRECTION_AMPLIFY) {
+			if (channel->volume < 15)
+				channel->volume++;
+		} else if (channel->volume > 0) {
+			channel->volume--;
+		}
+
+		apu_channel_update(apu, ids[i], timestamp);
+	}
+}
+
+static
+void apu_clock_frame_sequencer(struct apu *apu, uint64_t timestamp)
+{
+	uint8_t step = apu->frame_sequencer_step;
+
+	if ((step & 1) == 0)
+		apu_clock_length(apu, timestamp);
+
+	if (step == 2 || step == 6)
+		apu_clock_sweep(apu, timestamp);
+
+	if (step == 7)
+		apu_clock_envelope(apu, timestamp);
+
+	apu->frame_sequencer_step = (step + 1) & 7;
+}
+
+/*
+ * Catch up to timestamp one frame sequencer period at a time. Finished
+ * samples are handed to the ring on every frame sequencer tick, which also
+ * bounds how much the synthesizer has to buffer.
+ */
+static
+void apu_run(struct apu *apu, uint64_t timestamp)
+{
+	int id;
+	uint64_t end;
+
+	while (apu->last_sync < timestamp) {
+		end = MIN(timestamp, apu->next_frame_sequencer);
+
+		if (apu->powered) {
+			for (id = 0; id < APU_NUM_CHANNELS; id++)
+				apu_channel_run(apu, id, apu->last_sync, end);
+		}
+		apu->last_sync = end;
+
+		if (end != apu->next_frame_sequencer)
+			break;
+
+		if (apu->powered)
+			apu_clock_frame_sequencer(apu, end);
+		apu->next_frame_sequencer += APU_FRAME_SEQUENCER_CYCLES;
+
+		if (apu_synthesizing(apu))
+			apu_synth_read(&apu->synth, end, apu->output);
+	}
+}
+
+static
+void apu_update_gains(struct apu *apu, uint64_t timestamp)
+{
+	int id, left, right;
+	uint8_t nr50, nr51;
+
+	/* Everything before the change is mixed with the old gains */
+	if (apu_synthesizing(apu))
+		apu_synth_read(&apu->synth, timestamp, apu->output);
+
+	nr50 = apu->registers[APU_REG(NR50)];
+	nr51 = apu->registers[APU_REG(NR51)];
+
+	for (id = 0; id < APU_NUM_CHANNELS; id++) {
+		/* SO2 is the left terminal, SO1 the right one */
+		left = (nr51 >> (id + 4)) & 1 ? IRF_GET_VALUE(NR50, SO2_OUTPUT_LEVEL, nr50) + 1 : 0;
+		right = (nr51 >> id) & 1 ? IRF_GET_VALUE(NR50, SO1_OUTPUT_LEVEL, nr50) + 1 : 0;
+
+		if (!(apu->channel_mask & APU_CHANNEL_MASK(id)))
+			left = right = 0;
+
+		apu->gains[id][0] = left;
+		apu->gains[id][1] = right;
+
+		if (apu->output)
+			apu_synth_set_gain(&apu->synth, id, left, right);
+	}
+}
+
+static
+void apu_channel_trigger(struct apu *apu, enum apu_channel_id id, uint64_t timestamp)
+{
+	uint8_t nrx2, nr10, time, shift;
+	struct apu_channel *channel = &apu->channels[id];
+
+	channel->enabled = channel->dac_enabled;
+
+	if (channel->length == 0)
+		channel->length = id == APU_CHANNEL_WAVE ? WAVE_LENGTH_MAX : LENGTH_MAX;
+
+	channel->period = apu_channel_period(apu, id);
+	channel->timer = channel->period;
+
+	if (id == APU_CHANNEL_WAVE) {
+		channel->position = 0;
+	} else {
+		nrx2 = apu->registers[CHANNEL_REG(id, 2)];
+		channel->volume = IRF_GET_VALUE(NR12, INITIAL_VOLUME_ENVELOPE, nrx2);
+		channel->envelope_timer = IRF_GET_VALUE(NR12, NUM_ENVELOPE_SWEEP, nrx2);
+	}
+
+	if (id == APU_CHANNEL_NOISE)
+		apu->lfsr = LFSR_SEED;
+
+	if (id == APU_CHANNEL_SQUARE1) {
+		nr10 = apu->registers[APU_REG(NR10)];
+		time = IRF_GET_VALUE(NR10, SWEEP_TIME, nr10);
+		shift = IRF_GET_VALUE(NR10, SWEEP_SHIFT, nr10);
+
+		apu->sweep.shadow_frequency = apu_channel_frequency(apu, id);
+		apu->sweep.timer = time ? time : 8;
+		apu->sweep.enabled = time || shift;
+		if (shift)
+			apu_sweep_calculate(apu, timestamp);
+	}
+
+	apu_channel_update(apu, id, timestamp);
+}
+
+static
+void apu_channel_write(struct apu *apu, enum apu_channel_id id, int reg, uint8_t value, uint64_t timestamp)
+{
+	struct apu_channel *channel = &apu->channels[id];
+
+	switch (reg) {
+	case 0:
+		/* NR30 is the wave DAC, NR10 is only read when the sweep clocks */
+		if (id == APU_CHANNEL_WAVE)
+			channel->dac_enabled = IRF_GET_VALUE(NR30, SOUND_CONTROL, value) == LR35902_IO_REGS_NR30_SOUND_CONTROL_OK;
+		break;
+	case 1:
+		if (id == APU_CHANNEL_WAVE)
+			channel->length = WAVE_LENGTH_MAX - value;
+		else
+			channel->length = LENGTH_MAX - IRF_GET_VALUE(NR11, SOUND_LENGTH_DATA, value);
+		break;
+	case 2:
+		/* The DAC is on as long as any of the upper five bits are set */
+		if (id != APU_CHANNEL_WAVE)
+			channel->dac_enabled = (value & 0xf8) != 0;
+		break;
+	case 3:
+		channel->period = apu_channel_period(apu, id);
+		break;
+	case 4:
+		channel->length_enabled = IRF_GET_VALUE(NR14, COUNTER, value) == LR35902_IO_REGS_NR14_COUNTER_PERIOD;
+		channel->period = apu_channel_period(apu, id);
+		if (IRF_GET_VALUE(NR14, START, value))
+			apu_channel_trigger(apu, id, timestamp);
+		break;
+	}
+
+	if (!channel->dac_enabled)
+		channel->enabled = false;
+
+	apu_channel_update(apu, id, timestamp);
+}
+
+static
+void apu_write_nr52(struct apu *apu, uint8_t value, uint64_t timestamp)
+{
+	int id;
+	bool powered;
+
+	powered = IRF_GET_VALUE(NR52, MASTER_CONTROL, value) == LR35902_IO_REGS_NR52_MASTER_CONTROL_ENABLE;
+	if (powered == apu->powered)
+		return;
+
+	if (!powered) {
+		/* Powering off clears every register but wave RAM */
+		memset(apu->registers, 0, WAVE_RAM_OFFSET);
+
+		for (id = 0; id < APU_NUM_CHANNELS; id++) {
+			apu->channels[id].enabled = false;
+			apu_channel_update(apu, id, timestamp);
+			memset(&apu->channels[id], 0, sizeof(apu->channels[id]));
+		}
+
+		apu_update_gains(apu, timestamp);
+	} else {
+		/*
+		 * The sequencer restarts from step 0. Flush first so the span
+		 * the synthesizer buffers never exceeds one sequencer period.
+		 */
+		if (apu_synthesizing(apu))
+			apu_synth_read(&apu->synth, timestamp, apu->output);
+
+		apu->frame_sequencer_step = 0;
+		apu->next_frame_sequencer = timestamp + APU_FRAME_SEQUENCER_CYCLES;
+	}
+
+	apu->powered = powered;
+}
+
+/* Levels are not tracked while nothing is synthesized, pick them up again */
+static
+void apu_resume_synthesis(struct apu *apu)
+{
+	int id;
+
+	apu_synth_reset(&apu->synth, apu->last_sync);
+
+	for (id = 0; id < APU_NUM_CHANNELS; id++) {
+		apu->channels[id].output = apu_channel_level(apu, id);
+		apu_synth_set_level(&apu->synth, id, apu->channels[id].output);
+		apu_synth_set_gain(&apu->synth, id, apu->gains[id][0], apu->gains[id][1]);
+	}
+}
+
+LIBEXPORT
+int apu_init(struct apu *apu)
+{
+	memset(apu, 0, sizeof(*apu));
+
+	apu->mode = APU_MODE_SYNTHESIS;
+	apu->channel_mask = APU_CHANNEL_MASK_ALL;
+
+	apu->sweep.timer = 8;
+	apu->lfsr = LFSR_SEED;
+	apu->next_frame_sequencer = APU_FRAME_SEQUENCER_CYCLES;
+	apu->output = NULL;
+
+	return 0;
+}
+
+LIBEXPORT
+int apu_destroy(struct apu *apu)
+{
+	if (apu->output)
+		apu_synth_destroy(&apu->synth);
+	apu->output = NULL;
+
+	return 0;
+}
+
+/*
+ * Copies the emulated state of src. The synthesizer and its ring stay with
+ * src, the clone only synthesizes once it is given a ring of its own.
+ */
+LIBEXPORT
+int apu_clone(struct apu *dst, struct apu *src)
+{
+	memcpy(dst, src, offsetof(struct apu, output));
+	dst->output = NULL;
+	memset(&dst->synth, 0, sizeof(dst->synth));
+
+	return 0;
+}
+
+/*
+ * Route synthesized audio into ring at sample_rate frames per second, or stop
+ * synthesizing altogether when ring is NULL.
+ */
+LIBEXPORT
+int apu_set_output(struct device *device, struct apu_ring_buffer *ring, unsigned sample_rate)
+{
+	int ret;
+	struct apu *apu = &device->apu;
+
+	ret = apu_sync(device);
+	OK_OR_RETURN(ret == 0, ret);
+
+	apu_destroy(apu);
+	if (ring == NULL)
+		return 0;
+
+	ret = apu_synth_init(&apu->synth, sample_rate, APU_FRAME_SEQUENCER_CYCLES, apu->last_sync);
+	OK_OR_RETURN(ret == 0, ret);
+
+	apu->output = ring;
+	if (apu_synthesizing(apu))
+		apu_resume_synthesis(apu);
+
+	return 0;
+}
+
+/*
+ * Switching to APU_MODE_REGISTERS_ONLY keeps the attached ring but stops
+ * producing samples; what the game observes is identical in both modes.
+ */
+LIBEXPORT
+int apu_set_mode(struct device *device, enum apu_mode mode)
+{
+	int ret;
+	struct apu *apu = &device->apu;
+
+	OK_OR_RETURN(mode == APU_MODE_REGISTERS_ONLY || mode == APU_MODE_SYNTHESIS, -EINVAL);
+
+	ret = apu_sync(device);
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (mode == apu->mode)
+		return 0;
+
+	if (apu_synthesizing(apu))
+		apu_synth_read(&apu->synth, apu->last_sync, apu->output);
+
+	apu->mode = mode;
+	if (apu_synthesizing(apu))
+		apu_resume_synthesis(apu);
+
+	return 0;
+}
+
+/* Only channels set in mask are mixed into the output */
+LIBEXPORT
+int apu_set_channel_mask(struct device *device, uint8_t mask)
+{
+	int ret;
+	struct apu *apu = &device->apu;
+
+	OK_OR_RETURN((mask & ~APU_CHANNEL_MASK_ALL) == 0, -EINVAL);
+
+	ret = apu_sync(device);
+	OK_OR_RETURN(ret == 0, ret);
+
+	apu->channel_mask = mask;
+	apu_update_gains(apu, apu->last_sync);
+
+	return 0;
+}
+
+/* Rebuild derived data after the emulated state was replaced wholesale */
+int apu_state_loaded(struct device *device)
+{
+	struct apu *apu = &device->apu;
+
+	/* Samples still pending belong to the old timeline */
+	if (apu_synthesizing(apu))
+		apu_synth_reset(&apu->synth, apu->last_sync);
+
+	apu_update_gains(apu, apu->last_sync);
+	if (apu_synthesizing(apu))
+		apu_resume_synthesis(apu);
+
+	return 0;
+}
+
+LIBEXPORT
+int apu_sync(struct device *device)
+{
+	apu_run(&device->apu, device->scheduler.timestamp);
+
+	return 0;
+}
+
+/* Push every finished sample up to the current timestamp into the ring */
+LIBEXPORT
+int apu_drain(struct device *device)
+{
+	int ret;
+	struct apu *apu = &device->apu;
+
+	ret = apu_sync(device);
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (apu_synthesizing(apu))
+		apu_synth_read(&apu->synth, apu->last_sync, apu->output);
+
+	return 0;
+}
+
+int apu_read8(struct device *device, uint16_t address, uint8_t *result)
+{
+	int ret, id;
+	uint8_t value;
+	struct apu *apu = &device->apu;
+
+	OK_OR_RETURN(address >= APU_REGISTERS_START && address <= APU_REGISTERS_END, -EINVAL);
+
+	ret = apu_sync(device);
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (address != LR35902_IO_REGS_NR52) {
+		*result = apu->registers[address - APU_REGISTERS_START] | apu_read_masks[address - APU_REGISTERS_START];
+		return 0;
+	}
+
+	value = IRF_SET_VALUE(NR52, MASTER_CONTROL, apu->powered, apu_read_masks[APU_REG(NR52)]);
+	for (id = 0; id < APU_NUM_CHANNELS; id++)
+		value |= apu->channels[id].enabled << id;
+
+	*result = value;
+
+	return 0;
+}
+
+int apu_write8(struct device *device, uint16_t address, uint8_t value)
+{
+	int ret, offset;
+	uint64_t timestamp;
+	struct apu *apu = &device->apu;
+
+	OK_OR_RETURN(address >= APU_REGISTERS_START && address <= APU_REGISTERS_END, -EINVAL);
+
+	ret = apu_sync(device);
+	OK_OR_RETURN(ret == 0, ret);
+
+	offset = address - APU_REGISTERS_START;
+	timestamp = apu->last_sync;
+
+	/* Wave RAM stays accessible while the APU is powered off */
+	if (offset >= WAVE_RAM_OFFSET) {
+		apu->registers[offset] = value;
+		apu_channel_update(apu, APU_CHANNEL_WAVE, timestamp);
+		return 0;
+	}
+
+	if (address == LR35902_IO_REGS_NR52) {
+		apu_write_nr52(apu, value, timestamp);
+		return 0;
+	}
+
+	if (!apu->powered)
+		return 0;
+
+	apu->registers[offset] = value;
+
+	if (offset < CHANNEL_REGISTERS_END)
+		apu_channel_write(apu, offset / 5, offset % 5, value, timestamp);
+	else if (address == LR35902_IO_REGS_NR50 || address == LR35902_IO_REGS_NR51)
+		apu_update_gains(apu, timestamp);
+
+	return 0;
+}
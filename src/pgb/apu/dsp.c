@@ -0,0 +1,214 @@
+#include <errno.h>
+#include <stdbool.h>
+
+#include <pgb/apu/dsp.h>
+#include <pgb/debug.h>
+#include <pgb/utils.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DSP_HAVE_X86 1
+#else
+#define DSP_HAVE_X86 0
+#endif
+
+static
+void dsp_mix_scalar(const float *deltas, size_t count, float *levels, const float *gains, float *left, float *right)
+{
+	int voice;
+	size_t i;
+	float l, r;
+
+	for (i = 0; i < count; i++) {
+		l = r = 0.0f;
+
+		for (voice = 0; voice < APU_DSP_VOICES; voice++) {
+			levels[voice] += deltas[i * APU_DSP_VOICES + voice];
+			l += levels[voice] * gains[voice];
+			r += levels[voice] * gains[APU_DSP_VOICES + voice];
+		}
+
+		left[i] = l;
+		right[i] = r;
+	}
+}
+
+static
+void dsp_convolve_scalar(const float *kernel, const float *left, const float *right, size_t taps, float *out_left, float *out_right)
+{
+	size_t i;
+	float l = 0.0f, r = 0.0f;
+
+	for (i = 0; i < taps; i++) {
+		l += kernel[i] * left[i];
+		r += kernel[i] * right[i];
+	}
+
+	*out_left = l;
+	*out_right = r;
+}
+
+#if DSP_HAVE_X86
+static inline __attribute__((target("sse2")))
+float dsp_hsum_sse2(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+
+	return _mm_cvtss_f32(v);
+}
+
+/* The four voices of one frame fill a register, left and right are summed together */
+static __attribute__((target("sse2")))
+void dsp_mix_sse2(const float *deltas, size_t count, float *levels, const float *gains, float *left, float *right)
+{
+	size_t i;
+	__m128 level, gain_left, gain_right, l, r, sum;
+
+	level = _mm_loadu_ps(levels);
+	gain_left = _mm_loadu_ps(gains);
+	gain_right = _mm_loadu_ps(gains + APU_DSP_VOICES);
+
+	for (i = 0; i < count; i++) {
+		level = _mm_add_ps(level, _mm_loadu_ps(&deltas[i * APU_DSP_VOICES]));
+		l = _mm_mul_ps(level, gain_left);
+		r = _mm_mul_ps(level, gain_right);
+
+		/* [l0 + l2, r0 + r2, l1 + l3, r1 + r3], then fold the halves */
+		sum = _mm_add_ps(_mm_unpacklo_ps(l, r), _mm_unpackhi_ps(l, r));
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+
+		_mm_store_ss(&left[i], sum);
+		_mm_store_ss(&right[i], _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+	}
+
+	_mm_storeu_ps(levels, level);
+}
+
+static __attribute__((target("sse2")))
+void dsp_convolve_sse2(const float *kernel, const float *left, const float *right, size_t taps, float *out_left, float *out_right)
+{
+	size_t i;
+	__m128 k, l, r;
+
+	l = r = _mm_setzero_ps();
+
+	for (i = 0; i < taps; i += 4) {
+		k = _mm_loadu_ps(&kernel[i]);
+		l = _mm_add_ps(l, _mm_mul_ps(k, _mm_loadu_ps(&left[i])));
+		r = _mm_add_ps(r, _mm_mul_ps(k, _mm_loadu_ps(&right[i])));
+	}
+
+	*out_left = dsp_hsum_sse2(l);
+	*out_right = dsp_hsum_sse2(r);
+}
+
+/*
+ * Two frames per register. The running sum across the pair is formed by
+ * adding the first frame's deltas into the upper lane before the levels.
+ */
+static __attribute__((target("avx2")))
+void dsp_mix_avx2(const float *deltas, size_t count, float *levels, const float *gains, float *left, float *right)
+{
+	size_t i;
+	__m128 pair;
+	__m256 level, gain_left, gain_right, d, current, sum;
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	level = _mm256_broadcast_ps((const __m128 *)levels);
+	gain_left = _mm256_broadcast_ps((const __m128 *)gains);
+	gain_right = _mm256_broadcast_ps((const __m128 *)(gains + APU_DSP_VOICES));
+
+	for (i = 0; i + 2 <= count; i += 2) {
+		d = _mm256_loadu_ps(&deltas[i * APU_DSP_VOICES]);
+		d = _mm256_add_ps(d, _mm256_permute2f128_ps(d, d, 0x08));
+		current = _mm256_add_ps(level, d);
+		level = _mm256_permute2f128_ps(current, current, 0x11);
+
+		/* Each lane ends up as [L, R, L, R] of its frame */
+		sum = _mm256_hadd_ps(_mm256_mul_ps(current, gain_left), _mm256_mul_ps(current, gain_right));
+		sum = _mm256_hadd_ps(sum, sum);
+		pair = _mm256_castps256_ps128(_mm256_permutevar8x32_ps(sum, order));
+
+		_mm_storel_pi((__m64 *)&left[i], pair);
+		_mm_storeh_pi((__m64 *)&right[i], pair);
+	}
+
+	_mm_storeu_ps(levels, _mm256_castps256_ps128(level));
+
+	dsp_mix_scalar(&deltas[i * APU_DSP_VOICES], count - i, levels, gains, &left[i], &right[i]);
+}
+
+static __attribute__((target("avx2")))
+void dsp_convolve_avx2(const float *kernel, const float *left, const float *right, size_t taps, float *out_left, float *out_right)
+{
+	size_t i;
+	__m256 k, l, r;
+
+	l = r = _mm256_setzero_ps();
+
+	for (i = 0; i < taps; i += 8) {
+		k = _mm256_loadu_ps(&kernel[i]);
+		l = _mm256_add_ps(l, _mm256_mul_ps(k, _mm256_loadu_ps(&left[i])));
+		r = _mm256_add_ps(r, _mm256_mul_ps(k, _mm256_loadu_ps(&right[i])));
+	}
+
+	*out_left = dsp_hsum_sse2(_mm_add_ps(_mm256_castps256_ps128(l), _mm256_extractf128_ps(l, 1)));
+	*out_right = dsp_hsum_sse2(_mm_add_ps(_mm256_castps256_ps128(r), _mm256_extractf128_ps(r, 1)));
+}
+#endif
+
+static
+bool dsp_isa_supported(enum apu_dsp_isa isa)
+{
+	switch (isa) {
+	case APU_DSP_ISA_SCALAR:
+		return true;
+#if DSP_HAVE_X86
+	case APU_DSP_ISA_SSE2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+	case APU_DSP_ISA_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+LIBEXPORT
+int apu_dsp_init(struct apu_dsp *dsp, enum apu_dsp_isa isa)
+{
+	if (isa == APU_DSP_ISA_AUTO) {
+		if (dsp_isa_supported(APU_DSP_ISA_AVX2))
+			isa = APU_DSP_ISA_AVX2;
+		else if (dsp_isa_supported(APU_DSP_ISA_SSE2))
+			isa = APU_DSP_ISA_SSE2;
+		else
+			isa = APU_DSP_ISA_SCALAR;
+	}
+
+	OK_OR_RETURN(dsp_isa_supported(isa), -ENOTSUP);
+
+	dsp->isa = isa;
+
+	switch (isa) {
+#if DSP_HAVE_X86
+	case APU_DSP_ISA_SSE2:
+		dsp->mix = dsp_mix_sse2;
+		dsp->convolve = dsp_convolve_sse2;
+		break;
+	case APU_DSP_ISA_AVX2:
+		dsp->mix = dsp_mix_avx2;
+		dsp->convolve = dsp_convolve_avx2;
+		break;
+#endif
+	default:
+		dsp->mix = dsp_mix_scalar;
+		dsp->convolve = dsp_convolve_scalar;
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,145 @@
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pgb/apu/resampler.h>
+#include <pgb/debug.h>
+#include <pgb/utils.h>
+
+#define PHASE_BITS 6
+/* Passband edge relative to the output rate */
+#define KERNEL_CUTOFF 0.45
+
+_Static_assert((1 << PHASE_BITS) == APU_RESAMPLER_PHASES, "phase bits must match the kernel phases");
+_Static_assert(APU_RESAMPLER_TAPS % 8 == 0, "convolve() works on multiples of 8 taps");
+
+static
+double resampler_sinc(double x)
+{
+	if (x == 0.0)
+		return 1.0;
+
+	return sin(M_PI * x) / (M_PI * x);
+}
+
+/* cutoff is normalized to the input rate */
+static
+void resampler_build_kernel(struct apu_resampler *resampler, double cutoff)
+{
+	int phase, tap;
+	double x, window, sum, values[APU_RESAMPLER_TAPS];
+
+	for (phase = 0; phase < APU_RESAMPLER_PHASES; phase++) {
+		sum = 0.0;
+
+		for (tap = 0; tap < APU_RESAMPLER_TAPS; tap++) {
+			x = (tap - (APU_RESAMPLER_TAPS / 2 - 1)) - (double)phase / APU_RESAMPLER_PHASES;
+			window = 0.42 + 0.5 * cos(2.0 * M_PI * x / APU_RESAMPLER_TAPS)
+				+ 0.08 * cos(4.0 * M_PI * x / APU_RESAMPLER_TAPS);
+			values[tap] = resampler_sinc(2.0 * cutoff * x) * window;
+			sum += values[tap];
+		}
+
+		for (tap = 0; tap < APU_RESAMPLER_TAPS; tap++)
+			resampler->kernel[phase * APU_RESAMPLER_TAPS + tap] = values[tap] / sum;
+	}
+}
+
+int apu_resampler_init(struct apu_resampler *resampler, unsigned input_rate, unsigned output_rate, size_t max_block)
+{
+	int i;
+
+	OK_OR_RETURN(output_rate > 0 && output_rate <= input_rate, -EINVAL);
+
+	memset(resampler, 0, sizeof(*resampler));
+
+	resampler->step = ((uint64_t)input_rate << 32) / output_rate;
+	resampler->capacity = max_block + APU_RESAMPLER_TAPS;
+
+	for (i = 0; i < 2; i++) {
+		resampler->history[i] = calloc(resampler->capacity, sizeof(float));
+		OK_OR_GOTO(resampler->history[i] != NULL, error);
+	}
+
+	resampler->kernel = aligned_alloc(32, APU_RESAMPLER_PHASES * APU_RESAMPLER_TAPS * sizeof(float));
+	OK_OR_GOTO(resampler->kernel != NULL, error);
+
+	resampler_build_kernel(resampler, MIN(KERNEL_CUTOFF * output_rate, 0.5 * input_rate) / input_rate);
+
+	return 0;
+
+error:
+	apu_resampler_destroy(resampler);
+	return -ENOMEM;
+}
+
+int apu_resampler_destroy(struct apu_resampler *resampler)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		free(resampler->history[i]);
+		resampler->history[i] = NULL;
+	}
+
+	free(resampler->kernel);
+	resampler->kernel = NULL;
+
+	return 0;
+}
+
+void apu_resampler_reset(struct apu_resampler *resampler)
+{
+	resampler->position = 0;
+	resampler->length = 0;
+}
+
+/* Hands out room for count input frames at the end of the history */
+int apu_resampler_append(struct apu_resampler *resampler, size_t count, float **left, float **right)
+{
+	OK_OR_RETURN(resampler->length + count <= resampler->capacity, -ENOSPC);
+
+	*left = &resampler->history[0][resampler->length];
+	*right = &resampler->history[1][resampler->length];
+	resampler->length += count;
+
+	return 0;
+}
+
+/* Produces up to count frames, as long as the history covers their window */
+size_t apu_resampler_run(struct apu_resampler *resampler, const struct apu_dsp *dsp, float *left, float *right, size_t count)
+{
+	size_t i, index;
+	const float *kernel;
+
+	for (i = 0; i < count; i++) {
+		index = resampler->position >> 32;
+		if (index + APU_RESAMPLER_TAPS > resampler->length)
+			break;
+
+		kernel = &resampler->kernel[((resampler->position >> (32 - PHASE_BITS)) & (APU_RESAMPLER_PHASES - 1)) * APU_RESAMPLER_TAPS];
+		dsp->convolve(kernel, &resampler->history[0][index], &resampler->history[1][index],
+			APU_RESAMPLER_TAPS, &left[i], &right[i]);
+
+		resampler->position += resampler->step;
+	}
+
+	return i;
+}
+
+/* Drops input no future output frame can reach */
+void apu_resampler_compact(struct apu_resampler *resampler)
+{
+	int i;
+	size_t consumed;
+
+	consumed = MIN(resampler->position >> 32, resampler->length);
+
+	for (i = 0; i < 2; i++)
+		memmove(resampler->history[i], &resampler->history[i][consumed],
+			(resampler->length - consumed) * sizeof(float));
+
+	resampler->length -= consumed;
+	resampler->position -= (uint64_t)consumed << 32;
+}
@@ -0,0 +1,101 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <pgb/apu/ring_buffer.h>
+#include <pgb/debug.h>
+#include <pgb/utils.h>
+
+#define FRAME_SIZE (APU_RING_BUFFER_CHANNELS * sizeof(int16_t))
+
+LIBEXPORT
+int apu_ring_buffer_init(struct apu_ring_buffer *ring, int16_t *frames, size_t capacity)
+{
+	OK_OR_RETURN(frames != NULL, -EINVAL);
+	/* Indices wrap with a mask */
+	OK_OR_RETURN(capacity > 0 && (capacity & (capacity - 1)) == 0, -EINVAL);
+
+	ring->frames = frames;
+	ring->capacity = capacity;
+	atomic_init(&ring->write_index, 0);
+	atomic_init(&ring->read_index, 0);
+
+	return 0;
+}
+
+LIBEXPORT
+size_t apu_ring_buffer_readable(struct apu_ring_buffer *ring)
+{
+	size_t write_index, read_index;
+
+	write_index = atomic_load_explicit(&ring->write_index, memory_order_acquire);
+	read_index = atomic_load_explicit(&ring->read_index, memory_order_relaxed);
+
+	return write_index - read_index;
+}
+
+LIBEXPORT
+size_t apu_ring_buffer_writable(struct apu_ring_buffer *ring)
+{
+	size_t write_index, read_index;
+
+	write_index = atomic_load_explicit(&ring->write_index, memory_order_relaxed);
+	read_index = atomic_load_explicit(&ring->read_index, memory_order_acquire);
+
+	return ring->capacity - (write_index - read_index);
+}
+
+/*
+ * Copy count frames between the ring and a linear buffer starting at index,
+ * splitting the copy where the ring wraps.
+ */
+static
+void apu_ring_buffer_copy(struct apu_ring_buffer *ring, size_t index, int16_t *dst, const int16_t *src, size_t count, bool to_ring)
+{
+	size_t offset, first;
+
+	offset = index & (ring->capacity - 1);
+	first = MIN(count, ring->capacity - offset);
+
+	if (to_ring) {
+		memcpy(&ring->frames[offset * APU_RING_BUFFER_CHANNELS], src, first * FRAME_SIZE);
+		memcpy(ring->frames, &src[first * APU_RING_BUFFER_CHANNELS], (count - first) * FRAME_SIZE);
+	} else {
+		memcpy(dst, &ring->frames[offset * APU_RING_BUFFER_CHANNELS], first * FRAME_SIZE);
+		memcpy(&dst[first * APU_RING_BUFFER_CHANNELS], ring->frames, (count - first) * FRAME_SIZE);
+	}
+}
+
+/* Consumer side */
+LIBEXPORT
+size_t apu_ring_buffer_read(struct apu_ring_buffer *ring, int16_t *frames, size_t count)
+{
+	size_t write_index, read_index;
+
+	write_index = atomic_load_explicit(&ring->write_index, memory_order_acquire);
+	read_index = atomic_load_explicit(&ring->read_index, memory_order_relaxed);
+
+	count = MIN(count, write_index - read_index);
+	apu_ring_buffer_copy(ring, read_index, frames, NULL, count, false);
+
+	atomic_store_explicit(&ring->read_index, read_index + count, memory_order_release);
+
+	return count;
+}
+
+/* Producer side, frames that do not fit are dropped */
+LIBEXPORT
+size_t apu_ring_buffer_write(struct apu_ring_buffer *ring, const int16_t *frames, size_t count)
+{
+	size_t write_index, read_index;
+
+	write_index = atomic_load_explicit(&ring->write_index, memory_order_relaxed);
+	read_index = atomic_load_explicit(&ring->read_index, memory_order_acquire);
+
+	count = MIN(count, ring->capacity - (write_index - read_index));
+	apu_ring_buffer_copy(ring, write_index, NULL, frames, count, true);
+
+	atomic_store_explicit(&ring->write_index, write_index + count, memory_order_release);
+
+	return count;
+}
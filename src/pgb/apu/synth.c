@@ -0,0 +1,227 @@
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pgb/apu/synth.h>
+#include <pgb/debug.h>
+#include <pgb/utils.h>
+
+#define PHASE_BITS 5
+#define READ_CHUNK_FRAMES 64
+
+/* Passband edge as a fraction of the internal Nyquist frequency */
+#define KERNEL_CUTOFF 0.9
+/* Corner of the DC blocking filter, roughly what the DMG output capacitor does */
+#define HIGHPASS_CORNER_HZ 20.0
+/* Mixer levels peak around +-480, leave some headroom after the high-pass */
+#define OUTPUT_SCALE 48.0f
+
+_Static_assert((1 << PHASE_BITS) == APU_SYNTH_KERNEL_PHASES, "phase bits must match the kernel phases");
+
+static
+double synth_sinc(double x)
+{
+	if (x == 0.0)
+		return 1.0;
+
+	return sin(M_PI * x) / (M_PI * x);
+}
+
+/*
+ * Tap k of phase p holds the impulse for a step that lands p / PHASES of a
+ * sample after the first tap's center. Every phase is normalized to unit gain
+ * so a step integrates to exactly its delta.
+ */
+static
+void synth_build_kernel(struct apu_synth *synth)
+{
+	int phase, tap;
+	double x, window, sum, values[APU_SYNTH_KERNEL_TAPS];
+
+	for (phase = 0; phase < APU_SYNTH_KERNEL_PHASES; phase++) {
+		sum = 0.0;
+
+		for (tap = 0; tap < APU_SYNTH_KERNEL_TAPS; tap++) {
+			x = (tap - (APU_SYNTH_KERNEL_TAPS / 2 - 1)) - (double)phase / APU_SYNTH_KERNEL_PHASES;
+			window = 0.42 + 0.5 * cos(2.0 * M_PI * x / APU_SYNTH_KERNEL_TAPS)
+				+ 0.08 * cos(4.0 * M_PI * x / APU_SYNTH_KERNEL_TAPS);
+			values[tap] = KERNEL_CUTOFF * synth_sinc(KERNEL_CUTOFF * x) * window;
+			sum += values[tap];
+		}
+
+		for (tap = 0; tap < APU_SYNTH_KERNEL_TAPS; tap++)
+			synth->kernel[phase][tap] = values[tap] / sum;
+	}
+}
+
+int apu_synth_init(struct apu_synth *synth, unsigned sample_rate, uint64_t max_span, uint64_t timestamp)
+{
+	int ret;
+	size_t max_block;
+
+	OK_OR_RETURN(sample_rate > 0 && sample_rate <= APU_SYNTH_INTERNAL_RATE, -EINVAL);
+
+	memset(synth, 0, sizeof(*synth));
+
+	synth->sample_rate = sample_rate;
+	synth->factor = ((uint64_t)APU_SYNTH_INTERNAL_RATE << 32) / APU_SYNTH_CLOCK_RATE;
+	synth->origin = timestamp;
+	synth->origin_offset = 0;
+	synth->highpass_factor = 1.0f - (float)(2.0 * M_PI * HIGHPASS_CORNER_HZ / sample_rate);
+
+	/* Samples covered by the longest span between reads, plus the kernel tail */
+	max_block = ((max_span * synth->factor) >> 32) + 1;
+	synth->capacity = max_block + APU_SYNTH_KERNEL_TAPS + 1;
+
+	synth->deltas = calloc(synth->capacity * APU_SYNTH_VOICES, sizeof(float));
+	OK_OR_RETURN(synth->deltas != NULL, -ENOMEM);
+
+	ret = apu_dsp_init(&synth->dsp, APU_DSP_ISA_AUTO);
+	OK_OR_GOTO(ret == 0, error);
+
+	ret = apu_resampler_init(&synth->resampler, APU_SYNTH_INTERNAL_RATE, sample_rate, max_block);
+	OK_OR_GOTO(ret == 0, error);
+
+	synth_build_kernel(synth);
+
+	return 0;
+
+error:
+	free(synth->deltas);
+	synth->deltas = NULL;
+	return ret;
+}
+
+int apu_synth_destroy(struct apu_synth *synth)
+{
+	free(synth->deltas);
+	synth->deltas = NULL;
+	synth->capacity = 0;
+
+	apu_resampler_destroy(&synth->resampler);
+
+	return 0;
+}
+
+/* Drop pending deltas and restart the timeline at timestamp */
+void apu_synth_reset(struct apu_synth *synth, uint64_t timestamp)
+{
+	memset(synth->deltas, 0, synth->capacity * APU_SYNTH_VOICES * sizeof(float));
+	apu_resampler_reset(&synth->resampler);
+
+	synth->origin = timestamp;
+	synth->origin_offset = 0;
+}
+
+/* Level a voice sits at, only meaningful right after a reset */
+void apu_synth_set_level(struct apu_synth *synth, int voice, int level)
+{
+	synth->levels[voice] = level;
+}
+
+/* Gains apply to every sample not read yet, so read up to the change first */
+void apu_synth_set_gain(struct apu_synth *synth, int voice, int left, int right)
+{
+	synth->gains[voice] = left;
+	synth->gains[APU_SYNTH_VOICES + voice] = right;
+}
+
+static inline
+uint64_t synth_position(struct apu_synth *synth, uint64_t timestamp)
+{
+	return synth->origin_offset + (timestamp - synth->origin) * synth->factor;
+}
+
+void apu_synth_add_delta(struct apu_synth *synth, uint64_t timestamp, int voice, int delta)
+{
+	int tap;
+	size_t index;
+	uint64_t position;
+	const float *kernel;
+	float *out;
+
+	position = synth_position(synth, timestamp);
+	index = position >> 32;
+	kernel = synth->kernel[(position >> (32 - PHASE_BITS)) & (APU_SYNTH_KERNEL_PHASES - 1)];
+
+	OK_OR_RETURN_VOID(index + APU_SYNTH_KERNEL_TAPS <= synth->capacity);
+
+	out = &synth->deltas[index * APU_SYNTH_VOICES + voice];
+
+	for (tap = 0; tap < APU_SYNTH_KERNEL_TAPS; tap++)
+		out[tap * APU_SYNTH_VOICES] += delta * kernel[tap];
+}
+
+static inline
+int16_t synth_clamp(float value)
+{
+	if (value > INT16_MAX)
+		return INT16_MAX;
+	if (value < INT16_MIN)
+		return INT16_MIN;
+
+	return (int16_t)value;
+}
+
+/* DC blocker, y[n] = x[n] - x[n - 1] + R * y[n - 1], and conversion */
+static
+void synth_output(struct apu_synth *synth, const float *left, const float *right, size_t count, int16_t *frames)
+{
+	size_t i;
+	int channel;
+	float in, out;
+
+	for (i = 0; i < count; i++) {
+		for (channel = 0; channel < APU_RING_BUFFER_CHANNELS; channel++) {
+			in = channel ? right[i] : left[i];
+			out = in - synth->dc_input[channel] + synth->highpass_factor * synth->highpass[channel];
+			synth->dc_input[channel] = in;
+			synth->highpass[channel] = out;
+			frames[i * APU_RING_BUFFER_CHANNELS + channel] = synth_clamp(out * OUTPUT_SCALE);
+		}
+	}
+}
+
+/*
+ * Every internal sample before the one timestamp falls into is final, since
+ * later deltas can only land at or after it. Those samples are mixed as one
+ * block, resampled and queued; the kernel tail is moved to the front.
+ */
+size_t apu_synth_read(struct apu_synth *synth, uint64_t timestamp, struct apu_ring_buffer *ring)
+{
+	int ret;
+	size_t count, produced, written;
+	uint64_t position;
+	float *left, *right;
+	float out_left[READ_CHUNK_FRAMES], out_right[READ_CHUNK_FRAMES];
+	int16_t frames[READ_CHUNK_FRAMES * APU_RING_BUFFER_CHANNELS];
+
+	position = synth_position(synth, timestamp);
+	count = position >> 32;
+	OK_OR_RETURN(count + APU_SYNTH_KERNEL_TAPS <= synth->capacity, 0);
+
+	ret = apu_resampler_append(&synth->resampler, count, &left, &right);
+	OK_OR_RETURN(ret == 0, 0);
+
+	synth->dsp.mix(synth->deltas, count, synth->levels, synth->gains, left, right);
+
+	memmove(synth->deltas, &synth->deltas[count * APU_SYNTH_VOICES],
+		APU_SYNTH_KERNEL_TAPS * APU_SYNTH_VOICES * sizeof(float));
+	/* Nothing past the moved tail was ever written */
+	memset(&synth->deltas[APU_SYNTH_KERNEL_TAPS * APU_SYNTH_VOICES], 0,
+		count * APU_SYNTH_VOICES * sizeof(float));
+
+	synth->origin = timestamp;
+	synth->origin_offset = position - ((uint64_t)count << 32);
+
+	written = 0;
+	while ((produced = apu_resampler_run(&synth->resampler, &synth->dsp, out_left, out_right, READ_CHUNK_FRAMES)) > 0) {
+		synth_output(synth, out_left, out_right, produced, frames);
+		written += ring ? apu_ring_buffer_write(ring, frames, produced) : 0;
+	}
+
+	apu_resampler_compact(&synth->resampler);
+
+	return written;
+}
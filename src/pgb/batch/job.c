@@ -0,0 +1,229 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pgb/batch/batch.h>
+#include <pgb/bios.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/state/movie.h>
+#include <pgb/state/state.h>
+#include <pgb/utils.h>
+
+static
+const char *const batch_status_names[] = {
+	[BATCH_STATUS_DONE] = "done",
+	[BATCH_STATUS_HALTED] = "halted",
+	[BATCH_STATUS_MATCHED] = "matched",
+	[BATCH_STATUS_TIMEOUT] = "timeout",
+	[BATCH_STATUS_DESYNC] = "desync",
+	[BATCH_STATUS_ERROR] = "error"
+};
+
+static
+double batch_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static
+int batch_job_setup(struct device *device, struct batch_job *job)
+{
+	int ret, fd;
+
+	if (job->bios_path != NULL)
+		ret = device_load_bios_from_file(device, job->bios_path);
+	else if (internal_bios_rom != NULL)
+		ret = device_load_bios_from_address(device, internal_bios_rom, internal_bios_rom_length);
+	else
+		ret = 0;
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (job->bios_path != NULL || internal_bios_rom != NULL)
+		ret = device_load_image_from_file(device, job->rom_path);
+	else
+		ret = device_load_image_without_bios(device, job->rom_path);
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (job->state_path != NULL) {
+		fd = open(job->state_path, O_RDONLY);
+		if (fd < 0)
+			return -errno;
+
+		ret = state_load(device, fd);
+		close(fd);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+
+	if (job->serial_pattern != NULL) {
+		ret = serial_set_transport(&device->serial, SERIAL_TRANSPORT_CAPTURE);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+
+	return 0;
+}
+
+static
+int batch_job_movie(struct device *device, struct batch_job *job, struct batch_result *result)
+{
+	int ret, fd;
+	struct movie movie;
+
+	ret = movie_init(&movie, 1);
+	OK_OR_RETURN(ret == 0, ret);
+
+	fd = open(job->movie_path, O_RDONLY);
+	if (fd < 0) {
+		ret = -errno;
+		goto done;
+	}
+
+	ret = movie_load(&movie, fd);
+	close(fd);
+	OK_OR_GOTO(ret == 0, done);
+
+	ret = movie_play(&movie, device, &result->desync_frame);
+	if (ret == -EILSEQ) {
+		result->status = BATCH_STATUS_DESYNC;
+		ret = 0;
+	}
+
+done:
+	movie_destroy(&movie);
+	return ret;
+}
+
+static
+int batch_job_execute(struct device *device, struct batch_job *job, struct batch_result *result)
+{
+	int ret;
+	uint64_t frame;
+	bool matched;
+
+	if (job->movie_path != NULL)
+		return batch_job_movie(device, job, result);
+
+	if (job->serial_pattern != NULL) {
+		ret = device_run_until_serial_match(device, job->serial_pattern, job->frames * DEVICE_FRAME_CYCLES, &matched);
+		OK_OR_RETURN(ret == 0, ret);
+
+		result->status = matched ? BATCH_STATUS_MATCHED : BATCH_STATUS_TIMEOUT;
+		return 0;
+	}
+
+	for (frame = 0; frame < job->frames; frame++) {
+		if (cpu_is_halted(&device->cpu)) {
+			result->status = BATCH_STATUS_HALTED;
+			break;
+		}
+
+		ret = device_run_frame(device);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+
+	return 0;
+}
+
+/* Runs job on device, which is initialized here and destroyed before returning */
+int batch_job_run(struct device *device, struct batch_job *job, struct batch_result *result)
+{
+	int ret;
+	uint64_t start;
+	double begin;
+
+	memset(result, 0, sizeof(*result));
+	result->status = BATCH_STATUS_DONE;
+	begin = batch_now();
+
+	ret = device_init(device, job->decoder_type);
+	OK_OR_GOTO(ret == 0, done);
+
+	if (job->cpu_core != NULL) {
+		ret = device_configure_setting(device, DEVICE_SETTING_CPU_CORE, job->cpu_core);
+		OK_OR_GOTO(ret == 0, destroy);
+	}
+
+	ret = batch_job_setup(device, job);
+	OK_OR_GOTO(ret == 0, destroy);
+
+	start = device->scheduler.timestamp;
+
+	ret = batch_job_execute(device, job, result);
+	OK_OR_GOTO(ret == 0, destroy);
+
+	result->cycles = device->scheduler.timestamp - start;
+	result->frames = result->cycles / DEVICE_FRAME_CYCLES;
+
+	ret = device_state_hash(device, &result->hash);
+	OK_OR_WARN(ret == 0);
+
+destroy:
+	device_destroy(device);
+done:
+	if (ret) {
+		result->status = BATCH_STATUS_ERROR;
+		result->error = ret;
+	}
+	result->seconds = batch_now() - begin;
+
+	return ret;
+}
+
+/* Appends value as a JSON string, returns the length it would need like snprintf() */
+static
+size_t batch_json_string(char *buffer, size_t size, size_t length, const char *value)
+{
+	const char *c;
+
+	length += snprintf(buffer + MIN(length, size), size - MIN(length, size), "\"");
+	for (c = value; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\')
+			length += snprintf(buffer + MIN(length, size), size - MIN(length, size), "\\%c", *c);
+		else if ((unsigned char)*c < ' ')
+			length += snprintf(buffer + MIN(length, size), size - MIN(length, size), "\\u%04x", *c);
+		else
+			length += snprintf(buffer + MIN(length, size), size - MIN(length, size), "%c", *c);
+	}
+	length += snprintf(buffer + MIN(length, size), size - MIN(length, size), "\"");
+
+	return length;
+}
+
+/*
+ * Formats result as a single JSON line. If it does not fit, buffer gets a
+ * short error line with the job and line number instead and -ENOSPC is
+ * returned.
+ */
+int batch_result_format(struct batch_job *job, struct batch_result *result, char *buffer, size_t size)
+{
+	size_t length;
+
+	length = snprintf(buffer, size, "{\"job\":%zu,\"line\":%u,\"rom\":", job->index, job->line);
+	length = batch_json_string(buffer, size, length, job->rom_path);
+	length += snprintf(buffer + MIN(length, size), size - MIN(length, size),
+			   ",\"status\":\"%s\",\"frames\":%llu,\"cycles\":%llu,\"hash\":\"%016llx%016llx\",\"seconds\":%.6f",
+			   batch_status_names[result->status],
+			   (unsigned long long)result->frames, (unsigned long long)result->cycles,
+			   (unsigned long long)result->hash.high, (unsigned long long)result->hash.low,
+			   result->seconds);
+
+	if (result->status == BATCH_STATUS_DESYNC)
+		length += snprintf(buffer + MIN(length, size), size - MIN(length, size), ",\"desync_frame\":%u", result->desync_frame);
+	if (result->status == BATCH_STATUS_ERROR)
+		length += snprintf(buffer + MIN(length, size), size - MIN(length, size), ",\"error\":%d", result->error);
+
+	length += snprintf(buffer + MIN(length, size), size - MIN(length, size), "}\n");
+	if (length < size)
+		return 0;
+
+	snprintf(buffer, size, "{\"job\":%zu,\"line\":%u,\"status\":\"%s\",\"error\":%d}\n",
+		 job->index, job->line, batch_status_names[BATCH_STATUS_ERROR], -ENOSPC);
+
+	return -ENOSPC;
+}
@@ -0,0 +1,242 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pgb/batch/batch.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/utils.h>
+
+#define BATCH_DEFAULT_FRAMES 600
+#define BATCH_LINE_SIZE 4096
+
+static
+const char *help_text =
+	"libpgb-batch - Runs many classic gameboy roms headless, one device per worker.\n"
+	"\n"
+	"Usage: ./libpgb-batch [-h] [-j WORKERS] [-f FRAMES] [-d DECODER] [-o PATH] [-P] [MANIFEST]\n"
+	"\n"
+	"Options:\n"
+	"  -h\n"
+	"    Displays this help menu and then exits.\n"
+	"  -j WORKERS\n"
+	"    The number of worker threads. Defaults to the number of usable cores.\n"
+	"  -f FRAMES\n"
+	"    Frames to run jobs that do not give their own. Defaults to 600.\n"
+	"  -d DECODER\n"
+	"    The decoder jobs use unless they give their own, 'table' by default.\n"
+	"  -o PATH\n"
+	"    Where to write results, one JSON object per line. Defaults to stdout.\n"
+	"  -P\n"
+	"    Do not pin workers to cores.\n"
+	"\n"
+	"The manifest is read from MANIFEST, or from stdin if it is missing or '-'.\n"
+	"Each line is one job of space separated key=value pairs:\n"
+	"  rom=PATH [bios=PATH] [state=PATH] [movie=PATH] [frames=N]\n"
+	"  [serial=PATTERN] [decoder=table|logical] [core=instruction|mcycle]\n"
+	"A job replays its movie if it has one, runs until PATTERN shows up on the\n"
+	"serial port within its frames if it has one, or just runs its frames.\n"
+	"core=mcycle runs it on the slower core that keeps timers and DMA in step\n"
+	"with each memory access.\n"
+	"";
+
+struct batch_pool {
+	struct batch_manifest *manifest;
+	FILE *output;
+	pthread_mutex_t output_lock;
+	cpu_set_t cpus;
+	bool pin;
+	/* Jobs are handed out in order, whichever worker is free takes the next */
+	atomic_size_t next;
+	atomic_size_t failures;
+};
+
+/* Each worker owns its device, aligned so that no two share a cache line */
+struct batch_worker {
+	pthread_t thread;
+	unsigned id;
+	struct batch_pool *pool;
+	struct device device;
+} CACHE_ALIGNED;
+
+/* Pins worker to the id-th core the process is allowed to run on */
+static
+int batch_worker_pin(struct batch_worker *worker)
+{
+	int cpu, nth;
+	cpu_set_t set;
+	struct batch_pool *pool = worker->pool;
+
+	nth = worker->id % CPU_COUNT(&pool->cpus);
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &pool->cpus) && nth-- == 0)
+			break;
+	}
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+
+	return -pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static
+void *batch_worker_run(void *data)
+{
+	int ret;
+	size_t index;
+	char line[BATCH_LINE_SIZE];
+	struct batch_result result;
+	struct batch_worker *worker = data;
+	struct batch_pool *pool = worker->pool;
+	struct batch_job *job;
+
+	if (pool->pin) {
+		ret = batch_worker_pin(worker);
+		OK_OR_WARN(ret == 0);
+	}
+
+	while ((index = atomic_fetch_add(&pool->next, 1)) < pool->manifest->count) {
+		job = &pool->manifest->jobs[index];
+
+		batch_job_run(&worker->device, job, &result);
+		if (result.status == BATCH_STATUS_ERROR || result.status == BATCH_STATUS_DESYNC)
+			atomic_fetch_add(&pool->failures, 1);
+
+		/* A result that does not fit is written as a short error line instead */
+		ret = batch_result_format(job, &result, line, sizeof(line));
+		if (ret != 0)
+			atomic_fetch_add(&pool->failures, 1);
+
+		/* Whole lines only, so results from different workers never interleave */
+		pthread_mutex_lock(&pool->output_lock);
+		fputs(line, pool->output);
+		pthread_mutex_unlock(&pool->output_lock);
+	}
+
+	return NULL;
+}
+
+static
+int batch_run(struct batch_pool *pool, unsigned workers)
+{
+	int ret = 0;
+	unsigned i, started;
+	struct batch_worker *pool_workers;
+
+	pool_workers = aligned_alloc(CACHE_LINE_SIZE, workers * sizeof(*pool_workers));
+	OK_OR_RETURN(pool_workers != NULL, -ENOMEM);
+
+	for (started = 0; started < workers; started++) {
+		pool_workers[started].id = started;
+		pool_workers[started].pool = pool;
+
+		ret = -pthread_create(&pool_workers[started].thread, NULL, batch_worker_run, &pool_workers[started]);
+		OK_OR_BREAK(ret == 0);
+	}
+
+	for (i = 0; i < started; i++)
+		pthread_join(pool_workers[i].thread, NULL);
+
+	free(pool_workers);
+
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret, opt;
+	long workers = 0, frames = BATCH_DEFAULT_FRAMES;
+	const char *manifest_path = "-";
+	const char *output_path = NULL;
+	const char *decoder_type = "table";
+	FILE *manifest_stream;
+	struct batch_manifest manifest;
+	struct batch_pool pool = {
+		.output = stdout,
+		.output_lock = PTHREAD_MUTEX_INITIALIZER,
+		.pin = true,
+	};
+
+	while ((opt = getopt(argc, argv, "d:f:j:o:Ph")) != -1) {
+		switch (opt) {
+		case 'd':
+			decoder_type = optarg;
+			break;
+		case 'f':
+			frames = strtol(optarg, NULL, 0);
+			break;
+		case 'j':
+			workers = strtol(optarg, NULL, 0);
+			break;
+		case 'o':
+			output_path = optarg;
+			break;
+		case 'P':
+			pool.pin = false;
+			break;
+		case 'h':
+			printf("%s", help_text);
+			exit(EXIT_SUCCESS);
+		default:
+			fprintf(stderr, "%s", help_text);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (optind < argc)
+		manifest_path = argv[optind];
+
+	if (frames <= 0) {
+		fprintf(stderr, "The number of frames must be positive. Exiting.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	ret = sched_getaffinity(0, sizeof(pool.cpus), &pool.cpus);
+	OK_OR_RETURN(ret == 0, EXIT_FAILURE);
+
+	if (workers <= 0)
+		workers = CPU_COUNT(&pool.cpus);
+
+	if (strcmp(manifest_path, "-") == 0) {
+		manifest_stream = stdin;
+	} else {
+		manifest_stream = fopen(manifest_path, "r");
+		if (manifest_stream == NULL) {
+			fprintf(stderr, "The manifest '%s' could not be opened. Exiting.\n", manifest_path);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	ret = batch_manifest_load(&manifest, manifest_stream, frames, decoder_type);
+	if (manifest_stream != stdin)
+		fclose(manifest_stream);
+	OK_OR_RETURN(ret == 0, EXIT_FAILURE);
+
+	if (output_path != NULL) {
+		pool.output = fopen(output_path, "w");
+		if (pool.output == NULL) {
+			fprintf(stderr, "The output '%s' could not be opened. Exiting.\n", output_path);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	pool.manifest = &manifest;
+
+	ret = batch_run(&pool, MIN((size_t)workers, MAX(manifest.count, 1)));
+	OK_OR_WARN(ret == 0);
+
+	if (pool.output != stdout)
+		fclose(pool.output);
+	batch_manifest_free(&manifest);
+
+	return ret == 0 && atomic_load(&pool.failures) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
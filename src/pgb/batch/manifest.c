@@ -0,0 +1,131 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pgb/batch/batch.h>
+#include <pgb/debug.h>
+#include <pgb/utils.h>
+
+#define BATCH_MANIFEST_INITIAL_CAPACITY 64
+
+/*
+ * A manifest has one job per line, made of space separated key=value pairs:
+ *
+ *   rom=PATH [bios=PATH] [state=PATH] [movie=PATH] [frames=N]
+ *   [serial=PATTERN] [decoder=table|logical] [core=instruction|mcycle]
+ *
+ * Blank lines and lines starting with '#' are skipped.
+ */
+static
+int batch_manifest_parse(struct batch_job *job, char *text)
+{
+	char *token, *value, *end;
+
+	while ((token = strsep(&text, " \t")) != NULL) {
+		if (*token == '\0')
+			continue;
+
+		value = strchr(token, '=');
+		if (value == NULL)
+			return -EINVAL;
+		*value++ = '\0';
+
+		if (strcmp(token, "rom") == 0) {
+			job->rom_path = value;
+		} else if (strcmp(token, "bios") == 0) {
+			job->bios_path = value;
+		} else if (strcmp(token, "state") == 0) {
+			job->state_path = value;
+		} else if (strcmp(token, "movie") == 0) {
+			job->movie_path = value;
+		} else if (strcmp(token, "serial") == 0) {
+			job->serial_pattern = value;
+		} else if (strcmp(token, "decoder") == 0) {
+			job->decoder_type = value;
+		} else if (strcmp(token, "core") == 0) {
+			job->cpu_core = value;
+		} else if (strcmp(token, "frames") == 0) {
+			errno = 0;
+			job->frames = strtoull(value, &end, 0);
+			if (errno != 0 || *end != '\0')
+				return -EINVAL;
+		} else {
+			return -EINVAL;
+		}
+	}
+
+	return job->rom_path != NULL ? 0 : -EINVAL;
+}
+
+int batch_manifest_load(struct batch_manifest *manifest, FILE *stream, uint64_t default_frames, const char *decoder_type)
+{
+	int ret;
+	size_t capacity, length = 0;
+	ssize_t got;
+	unsigned line = 0;
+	char *text = NULL, *start;
+	struct batch_job *jobs, *job;
+
+	memset(manifest, 0, sizeof(*manifest));
+
+	while ((got = getline(&text, &length, stream)) >= 0) {
+		line++;
+
+		if (got > 0 && text[got - 1] == '\n')
+			text[got - 1] = '\0';
+
+		start = text + strspn(text, " \t");
+		if (*start == '\0' || *start == '#')
+			continue;
+
+		if (manifest->count == manifest->capacity) {
+			capacity = manifest->capacity ? manifest->capacity * 2 : BATCH_MANIFEST_INITIAL_CAPACITY;
+
+			jobs = realloc(manifest->jobs, capacity * sizeof(*jobs));
+			OK_OR_GOTO(jobs != NULL, out_of_memory);
+
+			manifest->jobs = jobs;
+			manifest->capacity = capacity;
+		}
+
+		job = &manifest->jobs[manifest->count];
+		memset(job, 0, sizeof(*job));
+		job->index = manifest->count;
+		job->line = line;
+		job->frames = default_frames;
+		job->decoder_type = decoder_type;
+
+		/* The job keeps pointers into its own copy of the line */
+		job->text = strdup(start);
+		OK_OR_GOTO(job->text != NULL, out_of_memory);
+		manifest->count++;
+
+		ret = batch_manifest_parse(job, job->text);
+		if (ret) {
+			fprintf(stderr, "Invalid manifest entry on line %u.\n", line);
+			goto error;
+		}
+	}
+
+	free(text);
+
+	return 0;
+
+out_of_memory:
+	ret = -ENOMEM;
+error:
+	free(text);
+	batch_manifest_free(manifest);
+	return ret;
+}
+
+void batch_manifest_free(struct batch_manifest *manifest)
+{
+	size_t i;
+
+	for (i = 0; i < manifest->count; i++)
+		free(manifest->jobs[i].text);
+
+	free(manifest->jobs);
+	memset(manifest, 0, sizeof(*manifest));
+}
@@ -0,0 +1,724 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <pgb/bench/bench.h>
+#include <pgb/cpu/decoder.h>
+#include <pgb/cpu/flags.h>
+#include <pgb/cpu/interpreter.h>
+#include <pgb/cpu/private/lr35902.h>
+#include <pgb/cpu/wide.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/io/private/io_regs.h>
+#include <pgb/mmu/private/mmu_constants.h>
+#include <pgb/state/hash.h>
+#include <pgb/utils.h>
+
+/*
+ * Sweeps every input of the 8-bit ALU, INC/DEC, accumulator and CB opcodes
+ * through interpreter_execute_instruction(), and compares A or the operand,
+ * and F, against what the hardware does. The reference is worked out for
+ * CONFORMANCE_LANES inputs at a time with vector arithmetic, and compared in
+ * bulk against the results of the sweep. Loads and stores between a register
+ * and memory through BC, DE or HL are swept on their own. Last, a wide group
+ * with OAM DMA running on one lane is checked against scalar devices.
+ */
+
+/* Where (HL) operands point */
+#define CONFORMANCE_ADDRESS 0xc000
+/* Mismatches reported on stderr per opcode, the rest are only counted */
+#define CONFORMANCE_MAX_REPORTS 4
+/* Lanes of the wide group, enough to put the DMA behind and ahead of the leader */
+#define CONFORMANCE_WIDE_LANES 4
+
+typedef uint32_t conformance_vec __attribute__((vector_size(16)));
+
+#define CONFORMANCE_LANES (sizeof(conformance_vec) / sizeof(uint32_t))
+
+static
+const conformance_vec conformance_lanes = { 0, 1, 2, 3 };
+
+enum conformance_kind {
+	CONFORMANCE_ALU,         /* A, operand and carry in */
+	CONFORMANCE_UNARY,       /* operand and carry in */
+	CONFORMANCE_ACCUMULATOR, /* A and all four flags in */
+};
+
+static
+const unsigned conformance_counts[] = {
+	[CONFORMANCE_ALU] = 1 << 17,
+	[CONFORMANCE_UNARY] = 1 << 9,
+	[CONFORMANCE_ACCUMULATOR] = 1 << 12,
+};
+
+/*
+ * Splits input index of a sweep into A, the operand and F. Carry in comes
+ * with Z, N and H set, so handlers that keep stale flags are caught too.
+ * Works on scalars and on vectors alike.
+ */
+#define CONFORMANCE_INPUT(kind, index, a, v, f) do { \
+	switch (kind) { \
+	case CONFORMANCE_ALU: \
+		(a) = (index) >> 9; \
+		(v) = ((index) >> 1) & 0xff; \
+		(f) = ((index) & 1) * 0xf0; \
+		break; \
+	case CONFORMANCE_UNARY: \
+		(a) = (index) & 0; \
+		(v) = (index) >> 1; \
+		(f) = ((index) & 1) * 0xf0; \
+		break; \
+	case CONFORMANCE_ACCUMULATOR: \
+		(a) = (index) >> 4; \
+		(v) = (index) & 0; \
+		(f) = ((index) & 0xf) << 4; \
+		break; \
+	} \
+} while (0)
+
+/* flag in every lane where condition holds */
+#define CONFORMANCE_FLAG(condition, flag) ((conformance_vec)(condition) & (flag))
+#define CONFORMANCE_ZERO(result) CONFORMANCE_FLAG((result) == 0, CPU_FLAG_ZERO)
+
+static
+int conformance_kind(const struct instruction_info *info, enum conformance_kind *kind)
+{
+	switch (info->instruction_class) {
+	case INSTRUCTION_CLASS_ADD:
+		if (info->operands.a.type != INSTRUCTION_OPERAND_TYPE_REGISTER8)
+			return -ENOENT;
+		/* fallthrough */
+	case INSTRUCTION_CLASS_ADC:
+	case INSTRUCTION_CLASS_SUB:
+	case INSTRUCTION_CLASS_SBC:
+	case INSTRUCTION_CLASS_AND:
+	case INSTRUCTION_CLASS_XOR:
+	case INSTRUCTION_CLASS_OR:
+	case INSTRUCTION_CLASS_CP:
+		*kind = CONFORMANCE_ALU;
+		return 0;
+	case INSTRUCTION_CLASS_INC:
+	case INSTRUCTION_CLASS_DEC:
+		/* INC rr and DEC rr leave F alone and are not 8-bit */
+		if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_REGISTER16 &&
+		    info->operands.a.modifier == INSTRUCTION_OPERAND_MODIFIER_NONE)
+			return -ENOENT;
+		*kind = CONFORMANCE_UNARY;
+		return 0;
+	case INSTRUCTION_CLASS_RLC:
+	case INSTRUCTION_CLASS_RRC:
+	case INSTRUCTION_CLASS_RL:
+	case INSTRUCTION_CLASS_RR:
+	case INSTRUCTION_CLASS_SLA:
+	case INSTRUCTION_CLASS_SRA:
+	case INSTRUCTION_CLASS_SRL:
+	case INSTRUCTION_CLASS_SWAP:
+	case INSTRUCTION_CLASS_BIT:
+	case INSTRUCTION_CLASS_RES:
+	case INSTRUCTION_CLASS_SET:
+		*kind = CONFORMANCE_UNARY;
+		return 0;
+	case INSTRUCTION_CLASS_RLCA:
+	case INSTRUCTION_CLASS_RRCA:
+	case INSTRUCTION_CLASS_RLA:
+	case INSTRUCTION_CLASS_RRA:
+	case INSTRUCTION_CLASS_DAA:
+	case INSTRUCTION_CLASS_CPL:
+	case INSTRUCTION_CLASS_SCF:
+	case INSTRUCTION_CLASS_CCF:
+		*kind = CONFORMANCE_ACCUMULATOR;
+		return 0;
+	default:
+		return -ENOENT;
+	}
+}
+
+/* Whether the operand is b, as for ADD A, n, ADC, SBC and BIT/RES/SET, or a */
+static
+bool conformance_operand_is_b(const struct instruction_info *info)
+{
+	return info->operands.b.type != INSTRUCTION_OPERAND_TYPE_NONE;
+}
+
+/*
+ * What the hardware leaves in the result and F for every lane, packed as
+ * result | F << 8. v is the operand, a the accumulator.
+ */
+static
+int conformance_reference(const struct instruction_info *info, conformance_vec a, conformance_vec v, conformance_vec f,
+			  conformance_vec *expected)
+{
+	uint8_t bit = 0;
+	conformance_vec carry, carry_in = {0}, value, result, flags, subtract, high, low, correction;
+
+	carry = (f >> 4) & 1;
+	if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_U3)
+		bit = info->operands.a.operand - INSTRUCTION_OPERAND_U3_0;
+
+	/* The accumulator rotates shift A, the CB ones their operand */
+	value = info->operands.a.type == INSTRUCTION_OPERAND_TYPE_NONE ? a : v;
+
+	switch (info->instruction_class) {
+	case INSTRUCTION_CLASS_ADC:
+		carry_in = carry;
+		/* fallthrough */
+	case INSTRUCTION_CLASS_ADD:
+		result = (a + v + carry_in) & 0xff;
+		flags = CONFORMANCE_ZERO(result) |
+			CONFORMANCE_FLAG((a & 0xf) + (v & 0xf) + carry_in > 0xf, CPU_FLAG_HALF_CARRY) |
+			CONFORMANCE_FLAG(a + v + carry_in > 0xff, CPU_FLAG_CARRY);
+		break;
+	case INSTRUCTION_CLASS_SBC:
+		carry_in = carry;
+		/* fallthrough */
+	case INSTRUCTION_CLASS_SUB:
+	case INSTRUCTION_CLASS_CP:
+		result = (a - v - carry_in) & 0xff;
+		flags = CONFORMANCE_ZERO(result) | CPU_FLAG_SUBTRACTION |
+			CONFORMANCE_FLAG((a & 0xf) < (v & 0xf) + carry_in, CPU_FLAG_HALF_CARRY) |
+			CONFORMANCE_FLAG(a < v + carry_in, CPU_FLAG_CARRY);
+		if (info->instruction_class == INSTRUCTION_CLASS_CP)
+			result = a;
+		break;
+	case INSTRUCTION_CLASS_AND:
+		result = a & v;
+		flags = CONFORMANCE_ZERO(result) | CPU_FLAG_HALF_CARRY;
+		break;
+	case INSTRUCTION_CLASS_XOR:
+		result = a ^ v;
+		flags = CONFORMANCE_ZERO(result);
+		break;
+	case INSTRUCTION_CLASS_OR:
+		result = a | v;
+		flags = CONFORMANCE_ZERO(result);
+		break;
+	case INSTRUCTION_CLASS_INC:
+		result = (v + 1) & 0xff;
+		flags = (f & CPU_FLAG_CARRY) | CONFORMANCE_ZERO(result) |
+			CONFORMANCE_FLAG((v & 0xf) == 0xf, CPU_FLAG_HALF_CARRY);
+		break;
+	case INSTRUCTION_CLASS_DEC:
+		result = (v - 1) & 0xff;
+		flags = (f & CPU_FLAG_CARRY) | CONFORMANCE_ZERO(result) | CPU_FLAG_SUBTRACTION |
+			CONFORMANCE_FLAG((v & 0xf) == 0, CPU_FLAG_HALF_CARRY);
+		break;
+	case INSTRUCTION_CLASS_RLC:
+	case INSTRUCTION_CLASS_RLCA:
+		result = ((value << 1) | (value >> 7)) & 0xff;
+		flags = CONFORMANCE_FLAG((value & 0x80) != 0, CPU_FLAG_CARRY);
+		break;
+	case INSTRUCTION_CLASS_RRC:
+	case INSTRUCTION_CLASS_RRCA:
+		result = (value >> 1) | ((value & 1) << 7);
+		flags = CONFORMANCE_FLAG((value & 1) != 0, CPU_FLAG_CARRY);
+		break;
+	case INSTRUCTION_CLASS_RL:
+	case INSTRUCTION_CLASS_RLA:
+		result = ((value << 1) | carry) & 0xff;
+		flags = CONFORMANCE_FLAG((value & 0x80) != 0, CPU_FLAG_CARRY);
+		break;
+	case INSTRUCTION_CLASS_RR:
+	case INSTRUCTION_CLASS_RRA:
+		result = (value >> 1) | (carry << 7);
+		flags = CONFORMANCE_FLAG((value & 1) != 0, CPU_FLAG_CARRY);
+		break;
+	case INSTRUCTION_CLASS_SLA:
+		result = (value << 1) & 0xff;
+		flags = CONFORMANCE_FLAG((value & 0x80) != 0, CPU_FLAG_CARRY);
+		break;
+	case INSTRUCTION_CLASS_SRA:
+		result = (value >> 1) | (value & 0x80);
+		flags = CONFORMANCE_FLAG((value & 1) != 0, CPU_FLAG_CARRY);
+		break;
+	case INSTRUCTION_CLASS_SRL:
+		result = value >> 1;
+		flags = CONFORMANCE_FLAG((value & 1) != 0, CPU_FLAG_CARRY);
+		break;
+	case INSTRUCTION_CLASS_SWAP:
+		result = ((value << 4) | (value >> 4)) & 0xff;
+		flags = (conformance_vec){0};
+		break;
+	case INSTRUCTION_CLASS_BIT:
+		result = v;
+		flags = (f & CPU_FLAG_CARRY) | CPU_FLAG_HALF_CARRY | CONFORMANCE_ZERO(v & (1 << bit));
+		break;
+	case INSTRUCTION_CLASS_RES:
+		result = v & ~(1 << bit);
+		flags = f;
+		break;
+	case INSTRUCTION_CLASS_SET:
+		result = v | (1 << bit);
+		flags = f;
+		break;
+	case INSTRUCTION_CLASS_DAA:
+		subtract = (conformance_vec)((f & CPU_FLAG_SUBTRACTION) != 0);
+		high = (conformance_vec)((f & CPU_FLAG_CARRY) != 0) | (~subtract & (conformance_vec)(a > 0x99));
+		low = (conformance_vec)((f & CPU_FLAG_HALF_CARRY) != 0) | (~subtract & (conformance_vec)((a & 0xf) > 0x9));
+		correction = (high & 0x60) | (low & 0x06);
+		result = (((a + correction) & ~subtract) | ((a - correction) & subtract)) & 0xff;
+		flags = CONFORMANCE_ZERO(result) | (f & CPU_FLAG_SUBTRACTION) | (high & CPU_FLAG_CARRY);
+		break;
+	case INSTRUCTION_CLASS_CPL:
+		result = ~a & 0xff;
+		flags = (f & (CPU_FLAG_ZERO | CPU_FLAG_CARRY)) | CPU_FLAG_SUBTRACTION | CPU_FLAG_HALF_CARRY;
+		break;
+	case INSTRUCTION_CLASS_SCF:
+		result = a;
+		flags = (f & CPU_FLAG_ZERO) | CPU_FLAG_CARRY;
+		break;
+	case INSTRUCTION_CLASS_CCF:
+		result = a;
+		flags = (f & CPU_FLAG_ZERO) | (~f & CPU_FLAG_CARRY);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	/* The CB rotates set Z from their result, the accumulator ones never do */
+	switch (info->instruction_class) {
+	case INSTRUCTION_CLASS_RLC:
+	case INSTRUCTION_CLASS_RRC:
+	case INSTRUCTION_CLASS_RL:
+	case INSTRUCTION_CLASS_RR:
+	case INSTRUCTION_CLASS_SLA:
+	case INSTRUCTION_CLASS_SRA:
+	case INSTRUCTION_CLASS_SRL:
+	case INSTRUCTION_CLASS_SWAP:
+		flags |= CONFORMANCE_ZERO(result);
+		break;
+	default:
+		break;
+	}
+
+	*expected = result | flags << 8;
+
+	return 0;
+}
+
+static
+int conformance_operand_write(struct device *device, struct decoded_instruction *instruction, bool second, uint8_t value)
+{
+	const struct instruction_info *info = instruction->info;
+
+	switch (second ? info->operands.b.type : info->operands.a.type) {
+	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
+		return cpu_register_write8(&device->cpu, second ? info->operands.b.operand : info->operands.a.operand, value);
+	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
+		device->cpu.registers.hl = CONFORMANCE_ADDRESS;
+		return mmu_write8(&device->mmu, CONFORMANCE_ADDRESS, value);
+	case INSTRUCTION_OPERAND_TYPE_U8:
+		if (second)
+			instruction->b.u8 = value;
+		else
+			instruction->a.u8 = value;
+		return 0;
+	case INSTRUCTION_OPERAND_TYPE_NONE:
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static
+int conformance_operand_read(struct device *device, struct decoded_instruction *instruction, bool second, uint8_t *value)
+{
+	const struct instruction_info *info = instruction->info;
+
+	switch (second ? info->operands.b.type : info->operands.a.type) {
+	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
+		return cpu_register_read8(&device->cpu, second ? info->operands.b.operand : info->operands.a.operand, value);
+	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
+		return mmu_read8(&device->mmu, CONFORMANCE_ADDRESS, value);
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Runs one input through the interpreter, packing what it left like conformance_reference() */
+static
+int conformance_execute(struct device *device, const struct instruction_info *info, enum conformance_kind kind,
+			uint8_t a, uint8_t v, uint8_t f, uint32_t *got)
+{
+	int ret;
+	bool second;
+	uint8_t result, flags;
+	struct decoded_instruction instruction = {
+		.info = info,
+	};
+
+	second = conformance_operand_is_b(info);
+
+	device->cpu.registers.a = a;
+
+	ret = conformance_operand_write(device, &instruction, second, v);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = cpu_register_write8(&device->cpu, INSTRUCTION_OPERAND_F, f);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = interpreter_execute_instruction(device, &instruction);
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (kind == CONFORMANCE_UNARY) {
+		ret = conformance_operand_read(device, &instruction, second, &result);
+		OK_OR_RETURN(ret == 0, ret);
+	} else {
+		result = device->cpu.registers.a;
+	}
+
+	ret = cpu_register_read8(&device->cpu, INSTRUCTION_OPERAND_F, &flags);
+	OK_OR_RETURN(ret == 0, ret);
+
+	*got = result | flags << 8;
+
+	return 0;
+}
+
+/*
+ * Sweeps every input of one opcode, then checks the lot against the
+ * reference. Returns -ENOENT for opcodes the sweep does not cover, and
+ * -EILSEQ when any input disagrees.
+ */
+static
+int conformance_check(struct device *device, unsigned opcode, uint32_t *got, unsigned *count, double *ns_per_op)
+{
+	int ret;
+	unsigned i, j, reported = 0, mismatches = 0;
+	uint8_t a = 0, v = 0, f = 0;
+	bool is_prefix, operand_is_a;
+	double start;
+	uint64_t any[sizeof(conformance_vec) / sizeof(uint64_t)];
+	enum conformance_kind kind;
+	conformance_vec index, va, vv, vf, expected, difference;
+	const struct instruction_info *info;
+	const struct instruction_text *text;
+
+	is_prefix = opcode >= LR35902_OPCODE_TABLE_SIZE;
+
+	if (is_prefix)
+		ret = cpu_decoder_get_prefix_cb_instruction(opcode & 0xff, &info);
+	else
+		ret = cpu_decoder_get_instruction(opcode & 0xff, &info);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = conformance_kind(info, &kind);
+	if (ret != 0)
+		return ret;
+
+	/* ADD A, A and friends read A twice, so A is the operand */
+	if (conformance_operand_is_b(info))
+		operand_is_a = info->operands.b.type == INSTRUCTION_OPERAND_TYPE_REGISTER8 &&
+			info->operands.b.operand == INSTRUCTION_OPERAND_A;
+	else
+		operand_is_a = info->operands.a.type == INSTRUCTION_OPERAND_TYPE_REGISTER8 &&
+			info->operands.a.operand == INSTRUCTION_OPERAND_A;
+
+	*count = conformance_counts[kind];
+
+	start = bench_now();
+	for (i = 0; i < *count; i++) {
+		CONFORMANCE_INPUT(kind, i, a, v, f);
+
+		ret = conformance_execute(device, info, kind, a, v, f, &got[i]);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+	*ns_per_op = (bench_now() - start) * 1e9 / *count;
+
+	for (i = 0; i < *count; i += CONFORMANCE_LANES) {
+		index = conformance_lanes + i;
+		CONFORMANCE_INPUT(kind, index, va, vv, vf);
+		if (operand_is_a)
+			va = vv;
+
+		ret = conformance_reference(info, va, vv, vf, &expected);
+		OK_OR_RETURN(ret == 0, ret);
+
+		difference = *(conformance_vec *)&got[i] ^ expected;
+
+		memcpy(any, &difference, sizeof(any));
+		if ((any[0] | any[1]) == 0)
+			continue;
+
+		for (j = 0; j < CONFORMANCE_LANES; j++) {
+			if (difference[j] == 0)
+				continue;
+
+			mismatches++;
+			if (reported++ >= CONFORMANCE_MAX_REPORTS)
+				continue;
+
+			if (is_prefix)
+				ret = cpu_decoder_get_prefix_cb_instruction_text(opcode & 0xff, &text);
+			else
+				ret = cpu_decoder_get_instruction_text(opcode & 0xff, &text);
+			OK_OR_RETURN(ret == 0, ret);
+
+			fprintf(stderr, "%s%02x %s: A=%02x operand=%02x F=%02x gave %02x F=%02x, expected %02x F=%02x\n",
+				is_prefix ? "cb " : "", opcode & 0xff, text->assembly, va[j], vv[j], vf[j],
+				got[i + j] & 0xff, got[i + j] >> 8, expected[j] & 0xff, expected[j] >> 8);
+		}
+	}
+
+	if (mismatches > CONFORMANCE_MAX_REPORTS)
+		fprintf(stderr, "%s%02x: %u more mismatches\n", is_prefix ? "cb " : "", opcode & 0xff,
+			mismatches - CONFORMANCE_MAX_REPORTS);
+
+	return mismatches == 0 ? 0 : -EILSEQ;
+}
+
+/*
+ * LD, LDI and LDD between an 8-bit register and memory at a register pair,
+ * leaving out those where the register is half of the pair.
+ */
+static
+bool conformance_is_load_store(const struct instruction_info *info, bool *store)
+{
+	enum instruction_operand pair, reg;
+
+	if (info->instruction_class != INSTRUCTION_CLASS_LD && info->instruction_class != INSTRUCTION_CLASS_LDI &&
+	    info->instruction_class != INSTRUCTION_CLASS_LDD)
+		return false;
+
+	*store = info->operands.a.modifier != INSTRUCTION_OPERAND_MODIFIER_NONE;
+
+	if (*store) {
+		if (info->operands.a.type != INSTRUCTION_OPERAND_TYPE_REGISTER16 ||
+		    info->operands.b.type != INSTRUCTION_OPERAND_TYPE_REGISTER8)
+			return false;
+		pair = info->operands.a.operand;
+		reg = info->operands.b.operand;
+	} else {
+		if (info->operands.b.type != INSTRUCTION_OPERAND_TYPE_REGISTER16 ||
+		    info->operands.b.modifier == INSTRUCTION_OPERAND_MODIFIER_NONE ||
+		    info->operands.a.type != INSTRUCTION_OPERAND_TYPE_REGISTER8)
+			return false;
+		pair = info->operands.b.operand;
+		reg = info->operands.a.operand;
+	}
+
+	return pair != INSTRUCTION_OPERAND_HL || (reg != INSTRUCTION_OPERAND_H && reg != INSTRUCTION_OPERAND_L);
+}
+
+/*
+ * Moves every value through one load or store, checking the byte that got
+ * there, the address register, which LDI and LDD step, and that F is kept.
+ * Returns -ENOENT for anything else, and -EILSEQ on any mismatch.
+ */
+static
+int conformance_check_load_store(struct device *device, unsigned opcode, unsigned *count, double *ns_per_op)
+{
+	int ret;
+	unsigned value, mismatches = 0;
+	bool store;
+	double start;
+	uint8_t moved, flags;
+	uint16_t address, expected_address;
+	enum instruction_operand pair, reg;
+	const struct instruction_info *info;
+	const struct instruction_text *text;
+	struct decoded_instruction instruction;
+
+	ret = cpu_decoder_get_instruction(opcode, &info);
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (!conformance_is_load_store(info, &store))
+		return -ENOENT;
+
+	pair = store ? info->operands.a.operand : info->operands.b.operand;
+	reg = store ? info->operands.b.operand : info->operands.a.operand;
+	expected_address = CONFORMANCE_ADDRESS;
+	if (info->instruction_class == INSTRUCTION_CLASS_LDI)
+		expected_address++;
+	else if (info->instruction_class == INSTRUCTION_CLASS_LDD)
+		expected_address--;
+
+	*count = 256;
+
+	start = bench_now();
+	for (value = 0; value < *count; value++) {
+		memset(&instruction, 0, sizeof(instruction));
+		instruction.info = info;
+
+		/* Whichever side the value is not on starts out as something else */
+		ret = cpu_register_write16(&device->cpu, pair, CONFORMANCE_ADDRESS);
+		OK_OR_RETURN(ret == 0, ret);
+
+		ret = cpu_register_write8(&device->cpu, reg, store ? value : ~value);
+		OK_OR_RETURN(ret == 0, ret);
+
+		ret = mmu_write8(&device->mmu, CONFORMANCE_ADDRESS, store ? ~value : value);
+		OK_OR_RETURN(ret == 0, ret);
+
+		ret = cpu_register_write8(&device->cpu, INSTRUCTION_OPERAND_F, value & 0xf0);
+		OK_OR_RETURN(ret == 0, ret);
+
+		ret = interpreter_execute_instruction(device, &instruction);
+		if (ret == 0) {
+			if (store)
+				ret = mmu_read8(&device->mmu, CONFORMANCE_ADDRESS, &moved);
+			else
+				ret = cpu_register_read8(&device->cpu, reg, &moved);
+		}
+		if (ret == 0)
+			ret = cpu_register_read16(&device->cpu, pair, &address);
+		if (ret == 0)
+			ret = cpu_register_read8(&device->cpu, INSTRUCTION_OPERAND_F, &flags);
+
+		if (ret == 0 && moved == value && address == expected_address && flags == (value & 0xf0))
+			continue;
+
+		if (mismatches++ >= CONFORMANCE_MAX_REPORTS)
+			continue;
+
+		ret = cpu_decoder_get_instruction_text(opcode, &text);
+		OK_OR_RETURN(ret == 0, ret);
+
+		fprintf(stderr, "%02x %s: %02x did not make it across\n", opcode, text->assembly, value);
+	}
+	*ns_per_op = (bench_now() - start) * 1e9 / *count;
+
+	if (mismatches > CONFORMANCE_MAX_REPORTS)
+		fprintf(stderr, "%02x: %u more mismatches\n", opcode, mismatches - CONFORMANCE_MAX_REPORTS);
+
+	return mismatches == 0 ? 0 : -EILSEQ;
+}
+
+static
+int conformance_wide_setup(struct device *device, bool dma)
+{
+	int ret;
+	/* INC A four times and JR back, all from WRAM, which OAM DMA locks out */
+	static const uint8_t code[] = { 0x3c, 0x3c, 0x3c, 0x3c, 0x18, 0xfa };
+
+	ret = device_init(device, "table");
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = mmu_copy_in(&device->mmu, CONFORMANCE_ADDRESS, code, sizeof(code));
+	OK_OR_RETURN(ret == 0, ret);
+
+	device->cpu.registers.pc = CONFORMANCE_ADDRESS;
+	device->cpu.registers.sp = 0xfffe;
+
+	if (dma) {
+		ret = mmu_write8(&device->mmu, LR35902_IO_REGS_DMA, CONFORMANCE_ADDRESS >> 8);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+
+	return 0;
+}
+
+/*
+ * Runs a wide group with OAM DMA started on one lane at a time, next to the
+ * same devices run alone, and compares their state hashes. Lanes agreeing on
+ * PC and code bytes must still not step together while only some of them
+ * have the bus locked.
+ */
+static
+int conformance_check_wide_dma(unsigned *count, double *ns_per_op)
+{
+	static struct device lanes[CONFORMANCE_WIDE_LANES], scalar[CONFORMANCE_WIDE_LANES];
+	static struct wide wide;
+	int ret = 0;
+	unsigned dma, i, mismatches = 0;
+	double start;
+	uint64_t timestamp;
+	struct device *devices[CONFORMANCE_WIDE_LANES];
+	struct state_hash expected, got;
+
+	*count = 0;
+
+	start = bench_now();
+	for (dma = 0; dma < CONFORMANCE_WIDE_LANES; dma++) {
+		for (i = 0; i < CONFORMANCE_WIDE_LANES; i++) {
+			ret = conformance_wide_setup(&lanes[i], i == dma);
+			OK_OR_BREAK(ret == 0);
+
+			ret = conformance_wide_setup(&scalar[i], i == dma);
+			OK_OR_BREAK(ret == 0);
+
+			devices[i] = &lanes[i];
+		}
+		OK_OR_RETURN(ret == 0, ret);
+
+		timestamp = lanes[0].scheduler.timestamp + 4 * LR35902_MMU_OAM_DMA_CYCLES;
+
+		ret = wide_init(&wide, devices, CONFORMANCE_WIDE_LANES);
+		if (ret == 0)
+			ret = wide_run_until(&wide, timestamp);
+
+		for (i = 0; i < CONFORMANCE_WIDE_LANES && ret == 0; i++) {
+			ret = device_run_until(&scalar[i], timestamp);
+			if (ret == 0)
+				ret = device_state_hash(&lanes[i], &got);
+			if (ret == 0)
+				ret = device_state_hash(&scalar[i], &expected);
+			if (ret != 0 || memcmp(&got, &expected, sizeof(got)) == 0)
+				continue;
+
+			mismatches++;
+			fprintf(stderr, "wide_dma: lane %u went its own way with DMA on lane %u\n", i, dma);
+		}
+
+		for (i = 0; i < CONFORMANCE_WIDE_LANES; i++) {
+			device_destroy(&lanes[i]);
+			device_destroy(&scalar[i]);
+		}
+		OK_OR_RETURN(ret == 0, ret);
+
+		*count += CONFORMANCE_WIDE_LANES;
+	}
+	*ns_per_op = (bench_now() - start) * 1e9 / *count;
+
+	return mismatches == 0 ? 0 : -EILSEQ;
+}
+
+/*
+ * Checks every covered opcode, writing one row per opcode and one for the
+ * wide group. ns_per_op is the time the interpreter took per input, set up
+ * included.
+ */
+int bench_conformance_run(FILE *stream, struct bench_options *options)
+{
+	static uint32_t got[1 << 17] CACHE_ALIGNED;
+	int ret, failed = 0;
+	unsigned opcode, count = 0;
+	char name[8];
+	struct device device;
+	struct bench_result result = {
+		.suite = "conformance",
+		.name = name,
+		.decoder = "table",
+	};
+
+	ret = device_init(&device, "table");
+	OK_OR_RETURN(ret == 0, ret);
+
+	for (opcode = 0; opcode < 2 * LR35902_OPCODE_TABLE_SIZE; opcode++) {
+		ret = conformance_check(&device, opcode, got, &count, &result.ns_per_op);
+		if (ret == -ENOENT && opcode < LR35902_OPCODE_TABLE_SIZE)
+			ret = conformance_check_load_store(&device, opcode, &count, &result.ns_per_op);
+		if (ret == -ENOENT)
+			continue;
+
+		snprintf(name, sizeof(name), "%s%02x", opcode >= LR35902_OPCODE_TABLE_SIZE ? "cb" : "", opcode & 0xff);
+		result.operations = count;
+		result.status = ret;
+		bench_report_result(stream, &result);
+
+		if (ret != 0)
+			failed = ret;
+	}
+
+	device_destroy(&device);
+
+	result.name = "wide_dma";
+	result.status = conformance_check_wide_dma(&count, &result.ns_per_op);
+	result.operations = count;
+	bench_report_result(stream, &result);
+
+	if (result.status != 0)
+		failed = result.status;
+
+	return failed;
+}
@@ -0,0 +1,321 @@
+#include <dirent.h>
+#include <errno.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <pgb/banner.h>
+#include <pgb/bench/bench.h>
+#include <pgb/bios.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/utils.h>
+
+#define BENCH_CORPUS_LINE_SIZE 1024
+
+/* Only the first of these per ROM is kept, so the baseline can be any older output */
+struct bench_baseline_entry {
+	char rom[256];
+	char decoder[32];
+	double fps;
+};
+
+struct bench_baseline {
+	struct bench_baseline_entry *entries;
+	size_t count;
+};
+
+static
+int bench_corpus_filter(const struct dirent *entry)
+{
+	const char *extension = strrchr(entry->d_name, '.');
+
+	if (extension == NULL || strpbrk(entry->d_name, ",\"\n") != NULL)
+		return 0;
+
+	return strcmp(extension, ".gb") == 0 || strcmp(extension, ".gbc") == 0;
+}
+
+/* Boots path and times options->frames frames of it, counting instructions on the way */
+static
+int bench_corpus_play(const char *path, struct bench_options *options, struct bench_corpus_result *result)
+{
+	int ret;
+	size_t stepped;
+	uint64_t begin, end;
+	double start;
+	struct device device;
+
+	ret = device_init(&device, options->decoder);
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (internal_bios_rom != NULL) {
+		ret = device_load_bios_from_address(&device, internal_bios_rom, internal_bios_rom_length);
+		OK_OR_GOTO(ret == 0, done);
+
+		ret = device_load_image_from_file(&device, path);
+	} else {
+		ret = device_load_image_without_bios(&device, path);
+	}
+	OK_OR_GOTO(ret == 0, done);
+
+	begin = device.scheduler.timestamp;
+	end = begin + options->frames * DEVICE_FRAME_CYCLES;
+	start = bench_now();
+
+	/* device_run_until() without the instruction count */
+	while (device.scheduler.timestamp < end) {
+		if (cpu_is_halted(&device.cpu)) {
+			result->halted = true;
+			break;
+		}
+
+		ret = cpu_step(&device, 1, &stepped);
+		OK_OR_BREAK(ret == 0);
+
+		result->instructions += stepped;
+	}
+
+	result->seconds = bench_now() - start;
+	result->frames = MIN(device.scheduler.timestamp, end) - begin;
+	result->frames /= DEVICE_FRAME_CYCLES;
+
+done:
+	device_destroy(&device);
+	return ret;
+}
+
+/*
+ * Each run gets a process of its own, so that the peak RSS reported for a
+ * ROM is that ROM's alone and a crash only costs its own row.
+ */
+static
+int bench_corpus_fork(const char *path, struct bench_options *options, struct bench_corpus_result *result)
+{
+	int ret, status, fds[2];
+	pid_t pid;
+	ssize_t length;
+	struct rusage usage;
+
+	ret = pipe(fds);
+	OK_OR_RETURN(ret == 0, -errno);
+
+	fflush(NULL);
+	pid = fork();
+	if (pid < 0) {
+		ret = -errno;
+		close(fds[0]);
+		close(fds[1]);
+		return ret;
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		result->error = bench_corpus_play(path, options, result);
+		length = write(fds[1], result, sizeof(*result));
+		_exit(length == sizeof(*result) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	length = read(fds[0], result, sizeof(*result));
+	close(fds[0]);
+
+	ret = wait4(pid, &status, 0, &usage);
+	OK_OR_RETURN(ret == pid, -errno);
+
+	if (length != sizeof(*result) || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+		return -ECHILD;
+
+	result->peak_rss = usage.ru_maxrss;
+
+	return result->error;
+}
+
+static
+int bench_corpus_measure(const char *directory, const char *name, struct bench_options *options,
+			 struct bench_corpus_result *result)
+{
+	int ret = 0;
+	unsigned i;
+	char path[4096];
+	struct bench_corpus_result run;
+
+	memset(result, 0, sizeof(*result));
+	snprintf(result->rom, sizeof(result->rom), "%s", name);
+	result->seconds = DBL_MAX;
+
+	ret = snprintf(path, sizeof(path), "%s/%s", directory, name);
+	OK_OR_RETURN(ret > 0 && (size_t)ret < sizeof(path), -ENAMETOOLONG);
+
+	for (i = 0; i < options->repetitions; i++) {
+		memset(&run, 0, sizeof(run));
+
+		ret = bench_corpus_fork(path, options, &run);
+		OK_OR_BREAK(ret == 0);
+
+		result->peak_rss = MAX(result->peak_rss, run.peak_rss);
+		if (run.seconds >= result->seconds)
+			continue;
+
+		result->halted = run.halted;
+		result->frames = run.frames;
+		result->instructions = run.instructions;
+		result->seconds = run.seconds;
+	}
+
+	result->error = ret;
+
+	return ret;
+}
+
+/*
+ * Reads the rows of an earlier corpus run. Lines that do not parse are
+ * skipped, so comments and the column header need no special casing.
+ */
+static
+int bench_baseline_load(struct bench_baseline *baseline, const char *path)
+{
+	int fields;
+	char line[BENCH_CORPUS_LINE_SIZE];
+	struct bench_baseline_entry entry, *entries;
+	FILE *stream;
+
+	memset(baseline, 0, sizeof(*baseline));
+
+	stream = fopen(path, "r");
+	OK_OR_RETURN(stream != NULL, -errno);
+
+	while (fgets(line, sizeof(line), stream) != NULL) {
+		fields = sscanf(line, "%255[^,],%31[^,],%*[^,],%*[^,],%*[^,],%lf", entry.rom, entry.decoder, &entry.fps);
+		if (fields != 3 || line[0] == '#')
+			continue;
+
+		entries = realloc(baseline->entries, (baseline->count + 1) * sizeof(*entries));
+		if (entries == NULL) {
+			free(baseline->entries);
+			fclose(stream);
+			return -ENOMEM;
+		}
+
+		baseline->entries = entries;
+		baseline->entries[baseline->count++] = entry;
+	}
+
+	fclose(stream);
+
+	return 0;
+}
+
+static
+struct bench_baseline_entry *bench_baseline_find(struct bench_baseline *baseline, const char *rom, const char *decoder)
+{
+	size_t i;
+
+	for (i = 0; i < baseline->count; i++) {
+		if (strcmp(baseline->entries[i].rom, rom) == 0 && strcmp(baseline->entries[i].decoder, decoder) == 0)
+			return &baseline->entries[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Rows are the same whether or not there is a baseline, so today's output
+ * can serve as tomorrow's baseline:
+ *
+ *   rom,decoder,frames,instructions,seconds,fps,ips,peak_rss_kib,status
+ */
+static
+void bench_corpus_report(FILE *stream, struct bench_options *options, struct bench_corpus_result *result)
+{
+	double seconds = result->seconds > 0 ? result->seconds : DBL_MIN;
+
+	fprintf(stream, "%s,%s,", result->rom, options->decoder);
+
+	if (result->error != 0) {
+		fprintf(stream, ",,,,,%ld,error\n", result->peak_rss);
+	} else {
+		fprintf(stream, "%llu,%llu,%.6f,%.3f,%.0f,%ld,%s\n",
+			(unsigned long long)result->frames, (unsigned long long)result->instructions,
+			result->seconds, result->frames / seconds, result->instructions / seconds,
+			result->peak_rss, result->halted ? "halted" : "ok");
+	}
+
+	fflush(stream);
+}
+
+/* Returns true if result is more than tolerance percent slower than its baseline */
+static
+bool bench_corpus_compare(struct bench_baseline *baseline, struct bench_options *options,
+			  struct bench_corpus_result *result, double tolerance)
+{
+	double fps, change;
+	struct bench_baseline_entry *entry;
+
+	entry = bench_baseline_find(baseline, result->rom, options->decoder);
+	if (entry == NULL || entry->fps <= 0 || result->error != 0 || result->seconds <= 0) {
+		fprintf(stderr, "%-32s no baseline\n", result->rom);
+		return false;
+	}
+
+	fps = result->frames / result->seconds;
+	change = 100.0 * (fps - entry->fps) / entry->fps;
+
+	fprintf(stderr, "%-32s %10.1f fps, baseline %10.1f fps, %+7.2f%%\n", result->rom, fps, entry->fps, change);
+
+	return tolerance > 0 && change < -tolerance;
+}
+
+/*
+ * Plays every .gb and .gbc file in directory for options->frames frames,
+ * writing one row per ROM. With a baseline, each ROM's frames per second are
+ * also compared to it on stderr, and -EDOM is returned if any of them got
+ * more than tolerance percent slower.
+ */
+int bench_corpus_run(FILE *stream, struct bench_options *options, const char *directory,
+		     const char *baseline_path, double tolerance)
+{
+	int ret, failed = 0, i, count;
+	bool regressed = false;
+	struct dirent **names;
+	struct bench_baseline baseline = { 0 };
+	struct bench_corpus_result result;
+
+	if (baseline_path != NULL) {
+		ret = bench_baseline_load(&baseline, baseline_path);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+
+	count = scandir(directory, &names, bench_corpus_filter, alphasort);
+	if (count < 0) {
+		free(baseline.entries);
+		return -errno;
+	}
+
+	fprintf(stream, "# pgb corpus v%d %s\n", BENCH_FORMAT_VERSION, GIT_HEAD_HASH);
+	fprintf(stream, "rom,decoder,frames,instructions,seconds,fps,ips,peak_rss_kib,status\n");
+
+	for (i = 0; i < count; i++) {
+		ret = bench_corpus_measure(directory, names[i]->d_name, options, &result);
+		if (ret != 0)
+			failed = ret;
+
+		bench_corpus_report(stream, options, &result);
+
+		if (baseline_path != NULL)
+			regressed |= bench_corpus_compare(&baseline, options, &result, tolerance);
+
+		free(names[i]);
+	}
+
+	free(names);
+	free(baseline.entries);
+
+	if (failed != 0)
+		return failed;
+
+	return regressed ? -EDOM : 0;
+}
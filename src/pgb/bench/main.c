@@ -0,0 +1,146 @@
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pgb/bench/bench.h>
+#include <pgb/debug.h>
+
+#define BENCH_DEFAULT_REPETITIONS 5
+#define BENCH_DEFAULT_OPERATIONS 2000000
+#define BENCH_DEFAULT_FRAMES 600
+
+static
+const char *help_text =
+	"libpgb-bench - Measures the speed of the emulator core.\n"
+	"\n"
+	"Usage: ./libpgb-bench [-h] [-r REPETITIONS] [-n OPERATIONS] [-o PATH]\n"
+	"       ./libpgb-bench -c DIRECTORY [-f FRAMES] [-d DECODER] [-b BASELINE] [-t PERCENT]\n"
+	"                      [-r REPETITIONS] [-o PATH]\n"
+	"       ./libpgb-bench -a [-o PATH]\n"
+	"\n"
+	"Options:\n"
+	"  -a\n"
+	"    Checks the interpreter against a reference over every input of the ALU\n"
+	"    and CB opcodes instead of timing anything.\n"
+	"  -h\n"
+	"    Displays this help menu and then exits.\n"
+	"  -r REPETITIONS\n"
+	"    Runs of each case, the fastest is reported. Defaults to 5.\n"
+	"  -n OPERATIONS\n"
+	"    Instructions or memory accesses per run. Defaults to 2000000.\n"
+	"  -o PATH\n"
+	"    Where to write results as CSV. Defaults to stdout.\n"
+	"  -c DIRECTORY\n"
+	"    Plays every .gb and .gbc rom in DIRECTORY instead of the synthetic cases.\n"
+	"  -f FRAMES\n"
+	"    Frames each rom of the corpus runs for. Defaults to 600.\n"
+	"  -d DECODER\n"
+	"    The decoder the corpus runs with, 'table' by default.\n"
+	"  -b BASELINE\n"
+	"    An earlier corpus result to compare frames per second against on stderr.\n"
+	"  -t PERCENT\n"
+	"    Exit with failure if any rom got more than PERCENT slower than BASELINE.\n"
+	"\n"
+	"Synthetic instruction streams (alu, load_store, branchy and prefix_cb) run\n"
+	"through cpu_step() under each decoder and report nanoseconds per\n"
+	"instruction; the decode suite times each decoder alone over all 512 opcodes,\n"
+	"and the mmu suite reports nanoseconds per mmu_read8() or mmu_write8() call.\n"
+	"The logical decoder is checked against the tables first and only timed if\n"
+	"they agree on every opcode.\n"
+	"\n"
+	"A corpus run reports frames and instructions per host second and the peak\n"
+	"resident set of each rom, which runs in a process of its own.\n"
+	"\n"
+	"A conformance run sweeps A, the operand and the incoming flags of every 8-bit\n"
+	"ALU, INC/DEC, accumulator and CB opcode, writes one row per opcode and lists\n"
+	"mismatches on stderr. It fails if any input disagrees, or if a wide lockstep\n"
+	"group with OAM DMA running on one lane ends up anywhere else than the same\n"
+	"devices run alone.\n"
+	"";
+
+int main(int argc, char *argv[])
+{
+	int ret, opt;
+	long long repetitions = BENCH_DEFAULT_REPETITIONS, operations = BENCH_DEFAULT_OPERATIONS;
+	long long frames = BENCH_DEFAULT_FRAMES;
+	double tolerance = 0;
+	const char *output_path = NULL;
+	const char *corpus_path = NULL;
+	const char *baseline_path = NULL;
+	bool conformance = false;
+	FILE *output = stdout;
+	struct bench_options options = {
+		.decoder = "table",
+	};
+
+	while ((opt = getopt(argc, argv, "ab:c:d:f:n:o:r:t:h")) != -1) {
+		switch (opt) {
+		case 'a':
+			conformance = true;
+			break;
+		case 'b':
+			baseline_path = optarg;
+			break;
+		case 'c':
+			corpus_path = optarg;
+			break;
+		case 'd':
+			options.decoder = optarg;
+			break;
+		case 'f':
+			frames = strtoll(optarg, NULL, 0);
+			break;
+		case 'n':
+			operations = strtoll(optarg, NULL, 0);
+			break;
+		case 'o':
+			output_path = optarg;
+			break;
+		case 'r':
+			repetitions = strtoll(optarg, NULL, 0);
+			break;
+		case 't':
+			tolerance = strtod(optarg, NULL);
+			break;
+		case 'h':
+			printf("%s", help_text);
+			exit(EXIT_SUCCESS);
+		default:
+			fprintf(stderr, "%s", help_text);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (repetitions <= 0 || operations <= 0 || frames <= 0) {
+		fprintf(stderr, "Repetitions, operations and frames must be positive. Exiting.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (output_path != NULL) {
+		output = fopen(output_path, "w");
+		if (output == NULL) {
+			fprintf(stderr, "The output '%s' could not be opened. Exiting.\n", output_path);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	options.repetitions = repetitions;
+	options.operations = operations;
+	options.frames = frames;
+
+	if (corpus_path != NULL) {
+		ret = bench_corpus_run(output, &options, corpus_path, baseline_path, tolerance);
+	} else if (conformance) {
+		bench_report_header(output);
+		ret = bench_conformance_run(output, &options);
+	} else {
+		bench_report_header(output);
+		ret = bench_micro_run(output, &options);
+	}
+
+	if (output != stdout)
+		fclose(output);
+
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
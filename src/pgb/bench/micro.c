@@ -0,0 +1,323 @@
+#include <errno.h>
+#include <float.h>
+#include <string.h>
+
+#include <pgb/bench/bench.h>
+#include <pgb/cpu/logical_decoder.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/utils.h>
+
+/* Streams start where a cartridge does and loop back with a trailing jr */
+#define BENCH_STREAM_ADDRESS 0x0100
+/* Where the branchy stream calls into */
+#define BENCH_ROUTINE_ADDRESS 0x0200
+#define BENCH_JR 0x18
+
+struct bench_stream {
+	const char *name;
+	const uint8_t *code;
+	size_t length;
+	const uint8_t *routine;
+	size_t routine_length;
+};
+
+/* Register to register arithmetic, nothing touches memory past the fetch */
+static
+const uint8_t bench_alu_code[] = {
+	0x04,			/* inc b */
+	0x0d,			/* dec c */
+	0x80,			/* add a, b */
+	0x92,			/* sub d */
+	0xab,			/* xor e */
+	0xbb,			/* cp e */
+	0x78,			/* ld a, b */
+	0x4f,			/* ld c, a */
+	0x3c,			/* inc a */
+	0x15,			/* dec d */
+	0xa8,			/* xor b */
+	0xfe, 0x10,		/* cp 0x10 */
+};
+
+static
+const uint8_t bench_load_store_code[] = {
+	0x21, 0x00, 0xc0,	/* ld hl, 0xc000 */
+	0x22,			/* ld (hl+), a */
+	0x32,			/* ld (hl-), a */
+	0xe0, 0x80,		/* ldh (0x80), a */
+	0xf0, 0x81,		/* ldh a, (0x81) */
+	0xc5,			/* push bc */
+	0xd1,			/* pop de */
+	0x08, 0x00, 0xc1,	/* ld (0xc100), sp */
+	0x31, 0xfe, 0xdf,	/* ld sp, 0xdffe */
+};
+
+static
+const uint8_t bench_branchy_code[] = {
+	0xcd, 0x00, 0x02,	/* call BENCH_ROUTINE_ADDRESS */
+	0xfe, 0x80,		/* cp 0x80 */
+	0x20, 0x01,		/* jr nz, +1 */
+	0x00,			/* nop */
+	0x28, 0x01,		/* jr z, +1 */
+	0x00,			/* nop */
+};
+
+static
+const uint8_t bench_branchy_routine[] = {
+	0x3c,			/* inc a */
+	0xc9,			/* ret */
+};
+
+static
+const uint8_t bench_prefix_cb_code[] = {
+	0xcb, 0x40,		/* bit 0, b */
+	0xcb, 0x7c,		/* bit 7, h */
+	0xcb, 0x11,		/* rl c */
+	0xcb, 0x47,		/* bit 0, a */
+	0x04,			/* inc b */
+	0xcb, 0x7f,		/* bit 7, a */
+};
+
+static
+const struct bench_stream bench_streams[] = {
+	{ "alu", bench_alu_code, sizeof(bench_alu_code), NULL, 0 },
+	{ "load_store", bench_load_store_code, sizeof(bench_load_store_code), NULL, 0 },
+	{ "branchy", bench_branchy_code, sizeof(bench_branchy_code),
+	  bench_branchy_routine, sizeof(bench_branchy_routine) },
+	{ "prefix_cb", bench_prefix_cb_code, sizeof(bench_prefix_cb_code), NULL, 0 },
+};
+
+static
+const char *const bench_decoders[] = {
+	"table",
+	"logical"
+};
+
+enum bench_mmu_access {
+	BENCH_MMU_READ8,
+	BENCH_MMU_WRITE8
+};
+
+struct bench_mmu_case {
+	const char *name;
+	enum bench_mmu_access access;
+	uint16_t base;
+	uint16_t mask;
+};
+
+static
+const struct bench_mmu_case bench_mmu_cases[] = {
+	{ "read8_rom", BENCH_MMU_READ8, 0x0000, 0x3fff },
+	{ "read8_wram", BENCH_MMU_READ8, 0xc000, 0x1fff },
+	{ "write8_wram", BENCH_MMU_WRITE8, 0xc000, 0x1fff },
+	{ "write8_hram", BENCH_MMU_WRITE8, 0xff80, 0x007f },
+};
+
+static
+int bench_stream_setup(struct device *device, const char *decoder, const struct bench_stream *stream)
+{
+	int ret;
+	uint8_t jr[2] = { BENCH_JR, (uint8_t)-(stream->length + sizeof(jr)) };
+	struct registers *registers = &device->cpu.registers;
+
+	ret = device_init(device, decoder);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = mmu_copy_in(&device->mmu, BENCH_STREAM_ADDRESS, stream->code, stream->length);
+	OK_OR_GOTO(ret == 0, fail);
+
+	ret = mmu_copy_in(&device->mmu, BENCH_STREAM_ADDRESS + stream->length, jr, sizeof(jr));
+	OK_OR_GOTO(ret == 0, fail);
+
+	if (stream->routine != NULL) {
+		ret = mmu_copy_in(&device->mmu, BENCH_ROUTINE_ADDRESS, stream->routine, stream->routine_length);
+		OK_OR_GOTO(ret == 0, fail);
+	}
+
+	/* As after boot, but with HL and SP where the streams expect them */
+	registers_init_post_boot(registers);
+	registers->hl = 0xc000;
+	registers->sp = 0xdffe;
+	registers->pc = BENCH_STREAM_ADDRESS;
+
+	return 0;
+
+fail:
+	device_destroy(device);
+	return ret;
+}
+
+/* Times cpu_step() over a stream, fetch, decode, execute and clock included */
+static
+int bench_stream_run(const char *decoder, const struct bench_stream *stream, struct bench_options *options,
+		     double *ns_per_op)
+{
+	int ret;
+	unsigned i;
+	size_t stepped;
+	double start, elapsed, best = DBL_MAX;
+	struct device device;
+
+	for (i = 0; i < options->repetitions; i++) {
+		ret = bench_stream_setup(&device, decoder, stream);
+		OK_OR_RETURN(ret == 0, ret);
+
+		start = bench_now();
+		ret = cpu_step(&device, options->operations, &stepped);
+		elapsed = bench_now() - start;
+
+		device_destroy(&device);
+		OK_OR_RETURN(ret == 0, ret);
+		OK_OR_RETURN(stepped == options->operations, -EINVAL);
+
+		best = MIN(best, elapsed);
+	}
+
+	*ns_per_op = best * 1e9 / options->operations;
+
+	return 0;
+}
+
+/* Times the decoder alone, cycling through every opcode with and without the CB prefix */
+static
+int bench_decode_run(const char *decoder, struct bench_options *options, double *ns_per_op)
+{
+	int ret = 0;
+	unsigned i;
+	uint64_t j;
+	double start, elapsed, best = DBL_MAX;
+	struct device device;
+	struct decoded_instruction decoded_instruction;
+
+	for (i = 0; i < options->repetitions; i++) {
+		ret = device_init(&device, decoder);
+		OK_OR_RETURN(ret == 0, ret);
+
+		start = bench_now();
+		for (j = 0; j < options->operations; j++) {
+			device.cpu.registers.pc = BENCH_STREAM_ADDRESS;
+
+			ret = decode(&device, j & 0xff, j & 0x100, &decoded_instruction);
+			OK_OR_BREAK(ret == 0);
+		}
+		elapsed = bench_now() - start;
+
+		device_destroy(&device);
+		OK_OR_RETURN(ret == 0, ret);
+
+		best = MIN(best, elapsed);
+	}
+
+	*ns_per_op = best * 1e9 / options->operations;
+
+	return 0;
+}
+
+static
+int bench_mmu_run(const struct bench_mmu_case *mmu_case, struct bench_options *options, double *ns_per_op)
+{
+	int ret = 0;
+	unsigned i;
+	uint64_t j;
+	uint8_t value, sum = 0;
+	double start, elapsed, best = DBL_MAX;
+	struct device device;
+
+	for (i = 0; i < options->repetitions; i++) {
+		ret = device_init(&device, "table");
+		OK_OR_RETURN(ret == 0, ret);
+
+		start = bench_now();
+		for (j = 0; j < options->operations; j++) {
+			if (mmu_case->access == BENCH_MMU_READ8) {
+				ret = mmu_read8(&device.mmu, mmu_case->base + (j & mmu_case->mask), &value);
+				sum += value;
+			} else {
+				ret = mmu_write8(&device.mmu, mmu_case->base + (j & mmu_case->mask), j);
+			}
+			OK_OR_BREAK(ret == 0);
+		}
+		elapsed = bench_now() - start;
+
+		device_destroy(&device);
+		OK_OR_RETURN(ret == 0, ret);
+
+		best = MIN(best, elapsed);
+	}
+
+	/* Keeps the reads from being optimised away */
+	__asm__ volatile("" : : "r"(sum));
+
+	*ns_per_op = best * 1e9 / options->operations;
+
+	return 0;
+}
+
+/*
+ * Runs every synthetic stream under every decoder, then the decoders and the
+ * MMU accessors on their own, writing one row per case. The logical decoder
+ * is only timed if it agrees with the tables on every opcode. A case that
+ * fails is reported as such and does not stop the others; the return value
+ * is the last failure, if any.
+ */
+int bench_micro_run(FILE *stream, struct bench_options *options)
+{
+	int ret, failed = 0, verified;
+	size_t i, j;
+	struct bench_result result = {
+		.operations = options->operations,
+	};
+
+	verified = cpu_logical_decoder_verify(stderr, NULL);
+	if (verified != 0)
+		failed = verified;
+
+	result.suite = "cpu";
+	for (i = 0; i < ARRAY_SIZE(bench_streams); i++) {
+		for (j = 0; j < ARRAY_SIZE(bench_decoders); j++) {
+			result.name = bench_streams[i].name;
+			result.decoder = bench_decoders[j];
+
+			if (strcmp(bench_decoders[j], "logical") == 0 && verified != 0)
+				ret = verified;
+			else
+				ret = bench_stream_run(bench_decoders[j], &bench_streams[i], options, &result.ns_per_op);
+			result.status = ret;
+			bench_report_result(stream, &result);
+
+			if (ret != 0)
+				failed = ret;
+		}
+	}
+
+	result.suite = "decode";
+	result.name = "all_opcodes";
+	for (j = 0; j < ARRAY_SIZE(bench_decoders); j++) {
+		result.decoder = bench_decoders[j];
+
+		if (strcmp(bench_decoders[j], "logical") == 0 && verified != 0)
+			ret = verified;
+		else
+			ret = bench_decode_run(bench_decoders[j], options, &result.ns_per_op);
+		result.status = ret;
+		bench_report_result(stream, &result);
+
+		if (ret != 0)
+			failed = ret;
+	}
+
+	result.suite = "mmu";
+	result.decoder = "-";
+	for (i = 0; i < ARRAY_SIZE(bench_mmu_cases); i++) {
+		result.name = bench_mmu_cases[i].name;
+
+		ret = bench_mmu_run(&bench_mmu_cases[i], options, &result.ns_per_op);
+		result.status = ret;
+		bench_report_result(stream, &result);
+
+		if (ret != 0)
+			failed = ret;
+	}
+
+	return failed;
+}
@@ -0,0 +1,41 @@
+#include <time.h>
+
+#include <pgb/banner.h>
+#include <pgb/bench/bench.h>
+
+double bench_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Results are CSV with one row per case, so runs of different builds can be
+ * diffed or joined on suite,case,decoder:
+ *
+ *   suite,case,decoder,operations,ns_per_op,status
+ *
+ * decoder is '-' for cases that do not execute instructions, and ns_per_op is
+ * empty when status is anything but ok.
+ */
+void bench_report_header(FILE *stream)
+{
+	fprintf(stream, "# pgb bench v%d %s\n", BENCH_FORMAT_VERSION, GIT_HEAD_HASH);
+	fprintf(stream, "suite,case,decoder,operations,ns_per_op,status\n");
+}
+
+void bench_report_result(FILE *stream, struct bench_result *result)
+{
+	fprintf(stream, "%s,%s,%s,%llu,", result->suite, result->name, result->decoder,
+		(unsigned long long)result->operations);
+
+	if (result->status == 0)
+		fprintf(stream, "%.3f,ok\n", result->ns_per_op);
+	else
+		fprintf(stream, ",error\n");
+
+	fflush(stream);
+}
@@ -2,6 +2,7 @@
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -11,12 +12,16 @@
 #include <pgb/cpu/decoder.h>
 #include <pgb/cpu/instruction_info.h>
 #include <pgb/cpu/interpreter.h>
+#include <pgb/cpu/private/fetch.h>
+#include <pgb/cpu/private/flags.h>
 #include <pgb/cpu/private/lr35902.h>
+#include <pgb/cpu/private/profile.h>
 #include <pgb/cpu/registers.h>
 #include <pgb/debug.h>
 #include <pgb/device/device.h>
 #include <pgb/gpu/gpu.h>
 #include <pgb/mmu/private/mmu.h>
+#include <pgb/scheduler/scheduler.h>
 #include <pgb/utils.h>
 
 LIBEXPORT
@@ -26,6 +31,15 @@ int cpu_init(struct cpu *cpu, const char *decoder_str)
 	enum decoder_type decoder_type;
 
 	cpu->status.halted = false;
+	cpu->status.stopped = false;
+	cpu->status.ime = false;
+	cpu->core = CPU_CORE_INSTRUCTION;
+	/* No such page, the first fetch looks it up */
+	cpu->code.data = NULL;
+	cpu->code.index = MMU_NUM_PAGES;
+	cpu->code.generation = 0;
+	cpu->profile = NULL;
+	cpu->lazy_flags.op = LAZY_FLAGS_OP_NONE;
 
 	ret = registers_init(&cpu->registers);
 	OK_OR_RETURN(ret == 0, ret);
@@ -45,6 +59,9 @@ int cpu_init(struct cpu *cpu, const char *decoder_str)
 LIBEXPORT
 int cpu_destroy(struct cpu *cpu)
 {
+	free(cpu->profile);
+	cpu->profile = NULL;
+
 	return 0;
 }
 
@@ -65,41 +82,95 @@ int cpu_load_rom_from_file(struct cpu *cpu, struct mmu *mmu, const char *path)
 	OK_OR_RETURN(data != MAP_FAILED, -EIO);
 
 	// XXX: handle rom image larger than the size of section 00
-	memcpy(mmu->ram, data, rom_st.st_size);
+	ret = mmu_copy_in(mmu, 0, data, rom_st.st_size);
+	OK_OR_WARN(ret == 0);
 
 	munmap(data, rom_st.st_size);
 
+	return ret;
+}
+
+/*
+ * Brings F up to date in builds made with LAZY_FLAGS=1, where it is only
+ * worked out on demand. Call this before reading or writing F, or AF, through
+ * cpu->registers directly.
+ */
+LIBEXPORT
+int cpu_flags_sync(struct cpu *cpu)
+{
+	flags_sync(cpu);
+
 	return 0;
 }
 
+LIBEXPORT
+int string_to_cpu_core(const char *str, enum cpu_core *core)
+{
+	int ret = 0;
+
+	if (strcmp(str, "instruction") == 0) {
+		*core = CPU_CORE_INSTRUCTION;
+	} else if (strcmp(str, "mcycle") == 0) {
+		*core = CPU_CORE_MCYCLE;
+	} else {
+		ret = -EINVAL;
+	}
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
+
 LIBEXPORT
 bool cpu_is_halted(struct cpu *cpu)
 {
 	return cpu->status.halted;
 }
 
-LIBEXPORT
-int fetch(struct device *device, uint8_t *opcode, bool *found_prefix)
+/*
+ * Slow path of cpu_fetch_read8(), which also points the code page at the page
+ * of address. The page holding the I/O registers, and any page while OAM DMA
+ * locks the bus, are read through mmu_read8() every time instead.
+ */
+int cpu_fetch_refill(struct device *device, uint16_t address, uint8_t *value)
 {
-	struct cpu *cpu;
+	unsigned index;
 	struct mmu *mmu;
-	struct registers *registers;
+	struct cpu_code_page *code;
 
-	cpu = &device->cpu;
 	mmu = &device->mmu;
-	registers = &cpu->registers;
+	code = &device->cpu.code;
+	index = address >> MMU_PAGE_SHIFT;
+
+	if (index == LR35902_MMU_REGION_IO_REGISTERS_START >> MMU_PAGE_SHIFT || mmu->oam_dma.active)
+		return mmu_read8(mmu, address, value);
 
-	OK_OR_RETURN(registers->pc < MMU_REGION_SIZE(ROM_BANK_00), -EINVAL);
+	code->data = mmu->pages[index]->data;
+	code->index = index;
+	code->generation = mmu->generation;
+
+	*value = code->data[address & MMU_PAGE_MASK];
+
+	return 0;
+}
+
+LIBEXPORT
+int fetch(struct device *device, uint8_t *opcode, bool *found_prefix)
+{
+	int ret;
+	struct registers *registers;
+
+	registers = &device->cpu.registers;
 
 	*found_prefix = false;
-	*opcode = mmu->ram[registers->pc];
+
+	ret = cpu_fetch_read8(device, registers->pc, opcode);
+	OK_OR_RETURN(ret == 0, ret);
 
 	if (*opcode == LR35902_OPCODE_PREFIX_CB) {
 		*found_prefix = true;
 
-		OK_OR_RETURN((registers->pc + 1) < MMU_REGION_SIZE(ROM_BANK_00), -EINVAL);
-
-		*opcode = mmu->ram[registers->pc + 1];
+		ret = cpu_fetch_read8(device, registers->pc + 1, opcode);
+		OK_OR_RETURN(ret == 0, ret);
 	}
 
 	return 0;
@@ -127,15 +198,33 @@ int execute(struct device *device, struct decoded_instruction *decoded_instructi
 	return ret;
 }
 
+/* Moves the clock, the scheduler and the GPU on by cycles T-cycles */
 LIBEXPORT
-int update_clock(struct device *device, struct decoded_instruction *decoded_instruction)
+int cpu_tick(struct device *device, uint8_t cycles)
 {
+	int ret;
 
-	/* Update CPU timings */
-	device->cpu.clock.m += decoded_instruction->info->timing.c0;
-	device->cpu.clock.t += decoded_instruction->info->timing.c1;
+	/* Four T-cycles to an M-cycle */
+	device->cpu.clock.t += cycles;
+	device->cpu.clock.m += cycles / 4;
 
-	return 0;
+	ret = scheduler_advance(device, cycles);
+	OK_OR_RETURN(ret == 0, ret);
+
+	/* Update GPU timings */
+	ret = gpu_step(&device->gpu, &device->mmu, cycles);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
+
+/* Ticks through whatever the instruction took that the M-cycle core has not */
+LIBEXPORT
+int update_clock(struct device *device, struct decoded_instruction *decoded_instruction)
+{
+	OK_OR_RETURN(decoded_instruction->elapsed <= decoded_instruction->cycles, -EINVAL);
+
+	return cpu_tick(device, decoded_instruction->cycles - decoded_instruction->elapsed);
 }
 
 LIBEXPORT
@@ -144,6 +233,7 @@ int cpu_step(struct device *device, size_t step, size_t *instructions_stepped)
 	int ret = 0;
 	size_t i;
 	uint8_t opcode;
+	uint16_t address;
 	struct decoded_instruction decoded_instruction;
 	bool found_prefix;
 
@@ -152,6 +242,8 @@ int cpu_step(struct device *device, size_t step, size_t *instructions_stepped)
 	for (i = 0; i < step; i++) {
 		memset(&decoded_instruction, 0, sizeof(decoded_instruction));
 
+		address = device->cpu.registers.pc;
+
 		ret = fetch(device, &opcode, &found_prefix);
 		OK_OR_BREAK(ret == 0);
 
@@ -162,11 +254,9 @@ int cpu_step(struct device *device, size_t step, size_t *instructions_stepped)
 		ret = execute(device, &decoded_instruction);
 		OK_OR_BREAK(ret == 0);
 
-		ret = update_clock(device, &decoded_instruction);
-		OK_OR_BREAK(ret == 0);
+		profile_record(&device->cpu, &decoded_instruction, address, opcode, found_prefix);
 
-		/* Update GPU timings */
-		ret = gpu_step(&device->gpu, &device->mmu, device->cpu.clock.t);
+		ret = update_clock(device, &decoded_instruction);
 		OK_OR_BREAK(ret == 0);
 	}
 
@@ -198,6 +288,7 @@ int cpu_register_read8(struct cpu *cpu, enum instruction_operand reg, uint8_t *v
 		*value = cpu->registers.e;
 		break;
 	case INSTRUCTION_OPERAND_F:
+		flags_sync(cpu);
 		*value = cpu->registers.f;
 		break;
 	case INSTRUCTION_OPERAND_H:
@@ -237,6 +328,7 @@ int cpu_register_write8(struct cpu *cpu, enum instruction_operand reg, uint8_t v
 		cpu->registers.e = value;
 		break;
 	case INSTRUCTION_OPERAND_F:
+		flags_sync(cpu);
 		cpu->registers.f = value;
 		break;
 	case INSTRUCTION_OPERAND_H:
@@ -261,6 +353,7 @@ int cpu_register_read16(struct cpu *cpu, enum instruction_operand reg, uint16_t
 
 	switch (reg) {
 	case INSTRUCTION_OPERAND_AF:
+		flags_sync(cpu);
 		*value = cpu->registers.af;
 		break;
 	case INSTRUCTION_OPERAND_BC:
@@ -294,6 +387,7 @@ int cpu_register_write16(struct cpu *cpu, enum instruction_operand reg, uint16_t
 
 	switch (reg) {
 	case INSTRUCTION_OPERAND_AF:
+		flags_sync(cpu);
 		cpu->registers.af = value;
 		break;
 	case INSTRUCTION_OPERAND_BC:
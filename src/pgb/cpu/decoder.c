@@ -4,11 +4,159 @@
 #include <pgb/cpu/decoder.h>
 #include <pgb/cpu/instruction_info.h>
 #include <pgb/cpu/logical_decoder.h>
+#include <pgb/cpu/private/decoder.h>
+#include <pgb/cpu/private/fetch.h>
 #include <pgb/cpu/private/lr35902.h>
 #include <pgb/cpu/table_decoder.h>
 #include <pgb/debug.h>
+#include <pgb/device/device.h>
 #include <pgb/utils.h>
 
+static
+int extract_u16_from_ib(uint8_t *instruction_buffer, size_t size, uint16_t *immediate)
+{
+	unsigned i;
+	uint16_t value;
+
+	value = 0;
+	for (i = 1; i < size; i++) {
+		value |= instruction_buffer[i] << ((i - 1) * 8);
+	}
+
+	*immediate = value;
+
+	return 0;
+}
+
+static
+int extract_u8_from_ib(uint8_t *instruction_buffer, size_t size, uint8_t *immediate)
+{
+	unsigned i;
+	uint8_t value;
+
+	value = 0;
+	for (i = 1; i < size; i++) {
+		value |= instruction_buffer[i] << ((i - 1) * 8);
+	}
+
+	*immediate = value;
+
+	return 0;
+}
+
+static __attribute__((used))
+void dump_instruction(struct device *device, const struct instruction_info *instruction_info, uint8_t *instruction_buffer, size_t size)
+{
+	int ret;
+	unsigned i, j;
+	uint16_t immediate = 0;
+	const struct instruction_text *text;
+
+	if (!IS_DEBUG())
+		return;
+
+	if (size > 1 && instruction_buffer[0] == LR35902_OPCODE_PREFIX_CB)
+		ret = cpu_decoder_get_prefix_cb_instruction_text(instruction_info->opcode, &text);
+	else
+		ret = cpu_decoder_get_instruction_text(instruction_info->opcode, &text);
+	OK_OR_RETURN_VOID(ret == 0);
+
+
+	for (i = 1; i < size; i++) {
+		immediate |= instruction_buffer[i] << ((i - 1) * 8);
+	}
+
+	printf("%04x ", device->cpu.registers.pc - (uint16_t)size);
+
+	for (j = 0; j < 3 - size; j++) {
+		printf("  ");
+	}
+
+	for (j = 0; j < size; j++) {
+		printf("%02x", instruction_buffer[j]);
+	}
+
+	printf(" %s", text->assembly);
+	if (size > 1) {
+		printf("\t; ($%x)", immediate);
+	}
+	printf("\n");
+}
+
+static
+int fill_instruction_buffer(struct device *device, uint8_t opcode, const struct instruction_info *instruction_info,
+			    uint8_t *instruction_buffer, size_t ib_size)
+{
+	int ret;
+	struct registers *registers;
+	size_t i, num_bytes;
+
+	registers = &device->cpu.registers;
+	num_bytes = instruction_info->num_bytes;
+
+	OK_OR_RETURN(num_bytes <= ib_size, -EINVAL);
+
+	/* pc wraps around the top of the address space like the hardware's */
+	for (i = 0; i < num_bytes; i++) {
+		ret = cpu_fetch_read8(device, registers->pc + i, &instruction_buffer[i]);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+
+	registers->pc += num_bytes;
+
+#if 0
+	dump_instruction(device, instruction_info, instruction_buffer, num_bytes);
+#endif
+
+	return 0;
+}
+
+/*
+ * Shared by every decoder: copies the bytes of the instruction at pc into
+ * decoded_instruction, moves pc past them and pulls out its immediates.
+ */
+int cpu_decoder_read_operands(struct device *device, const struct instruction_info *instruction_info,
+			      struct decoded_instruction *decoded_instruction)
+{
+	int ret;
+	uint8_t instruction_buffer[4];
+
+	ret = fill_instruction_buffer(device, instruction_info->opcode, instruction_info, instruction_buffer, sizeof(instruction_buffer));
+	OK_OR_RETURN(ret == 0, ret);
+
+	memcpy(decoded_instruction->raw_data, instruction_buffer, sizeof(instruction_buffer));
+
+	switch (instruction_info->operands.a.type) {
+	case INSTRUCTION_OPERAND_TYPE_U8:
+	case INSTRUCTION_OPERAND_TYPE_I8:
+		ret = extract_u8_from_ib(instruction_buffer, sizeof(instruction_buffer), &decoded_instruction->a.u8);
+		break;
+	case INSTRUCTION_OPERAND_TYPE_U16:
+		ret = extract_u16_from_ib(instruction_buffer, sizeof(instruction_buffer), &decoded_instruction->a.u16);
+		break;
+	default:
+		ret = 0;
+		break;
+	}
+	OK_OR_RETURN(ret == 0, ret);
+
+	switch (instruction_info->operands.b.type) {
+	case INSTRUCTION_OPERAND_TYPE_U8:
+	case INSTRUCTION_OPERAND_TYPE_I8:
+		ret = extract_u8_from_ib(instruction_buffer, sizeof(instruction_buffer), &decoded_instruction->b.u8);
+		break;
+	case INSTRUCTION_OPERAND_TYPE_U16:
+		ret = extract_u16_from_ib(instruction_buffer, sizeof(instruction_buffer), &decoded_instruction->b.u16);
+		break;
+	default:
+		ret = 0;
+		break;
+	}
+	OK_OR_RETURN(ret == 0, ret);
+
+	return 0;
+}
+
 LIBEXPORT
 int string_to_decoder_type(const char *str, enum decoder_type *type)
 {
@@ -49,24 +197,44 @@ int cpu_decoder_configure_decoder(enum decoder_type type, struct decoder *decode
 	return ret;
 }
 
+_Static_assert(sizeof(struct instruction_info) == 16, "four opcodes per cache line");
+
+/* Read-only and shared by every device, each table starts on its own cache line */
 static
-struct instruction_info isa_instruction_set[LR35902_OPCODE_TABLE_SIZE] = {
-#define SET(MNEMONIC, ASSEMBLY, OPCODE, OPERATION_CLASS, OPERAND_A, TYPE_A, MODIFIER_A, OPERAND_B, TYPE_B, MODIFIER_B, NUM_BYTES, C0, C1, FLAG_MASK, FLAG_Z, FLAG_N, FLAG_H, FLAG_C, IS_PREFIX) \
-	{#MNEMONIC, ASSEMBLY, OPCODE, NUM_BYTES, IS_PREFIX, {C0, C1}, {FLAG_MASK, FLAG_Z, FLAG_N, FLAG_H, FLAG_C}, {{TYPE_A, OPERAND_A, MODIFIER_A}, {TYPE_B, OPERAND_B, MODIFIER_B}}, OPERATION_CLASS},
+const struct instruction_info isa_instruction_set[LR35902_OPCODE_TABLE_SIZE] CACHE_ALIGNED = {
+#define SET(OPCODE, OPERATION_CLASS, OPERAND_A, TYPE_A, MODIFIER_A, OPERAND_B, TYPE_B, MODIFIER_B, NUM_BYTES, C0, C1, FLAG_MASK, FLAG_Z, FLAG_N, FLAG_H, FLAG_C, IS_PREFIX) \
+	{OPERATION_CLASS, OPCODE, NUM_BYTES, IS_PREFIX, {C0, C1}, {FLAG_MASK, FLAG_Z, FLAG_N, FLAG_H, FLAG_C}, {{TYPE_A, OPERAND_A, MODIFIER_A}, {TYPE_B, OPERAND_B, MODIFIER_B}}},
 #include <pgb/cpu/private/lr35902_ops.def>
 #undef SET
 };
 
 static
-struct instruction_info prefix_isa_instruction_set[LR35902_PREFIX_CB_OPCODE_TABLE_SIZE] = {
-#define SET(MNEMONIC, ASSEMBLY, OPCODE, OPERATION_CLASS, OPERAND_A, TYPE_A, MODIFIER_A, OPERAND_B, TYPE_B, MODIFIER_B, NUM_BYTES, C0, C1, FLAG_MASK, FLAG_Z, FLAG_N, FLAG_H, FLAG_C, IS_PREFIX) \
-	{#MNEMONIC, ASSEMBLY, OPCODE, NUM_BYTES, IS_PREFIX, {C0, C1}, {FLAG_MASK, FLAG_Z, FLAG_N, FLAG_H, FLAG_C}, {{TYPE_A, OPERAND_A, MODIFIER_A}, {TYPE_B, OPERAND_B, MODIFIER_B}}, OPERATION_CLASS},
+const struct instruction_info prefix_isa_instruction_set[LR35902_PREFIX_CB_OPCODE_TABLE_SIZE] CACHE_ALIGNED = {
+#define SET(OPCODE, OPERATION_CLASS, OPERAND_A, TYPE_A, MODIFIER_A, OPERAND_B, TYPE_B, MODIFIER_B, NUM_BYTES, C0, C1, FLAG_MASK, FLAG_Z, FLAG_N, FLAG_H, FLAG_C, IS_PREFIX) \
+	{OPERATION_CLASS, OPCODE, NUM_BYTES, IS_PREFIX, {C0, C1}, {FLAG_MASK, FLAG_Z, FLAG_N, FLAG_H, FLAG_C}, {{TYPE_A, OPERAND_A, MODIFIER_A}, {TYPE_B, OPERAND_B, MODIFIER_B}}},
 #include <pgb/cpu/private/lr35902_prefix_cb_ops.def>
 #undef SET
 };
 
+/* Only the debugger and reports read these, keep them out of the hot tables */
+static
+const struct instruction_text isa_instruction_text[LR35902_OPCODE_TABLE_SIZE] = {
+#define TEXT(OPCODE, MNEMONIC, ASSEMBLY) \
+	[OPCODE] = {#MNEMONIC, ASSEMBLY},
+#include <pgb/cpu/private/lr35902_ops_text.def>
+#undef TEXT
+};
+
+static
+const struct instruction_text prefix_isa_instruction_text[LR35902_PREFIX_CB_OPCODE_TABLE_SIZE] = {
+#define TEXT(OPCODE, MNEMONIC, ASSEMBLY) \
+	[OPCODE] = {#MNEMONIC, ASSEMBLY},
+#include <pgb/cpu/private/lr35902_prefix_cb_ops_text.def>
+#undef TEXT
+};
+
 LIBEXPORT
-int cpu_decoder_get_instruction(uint8_t opcode, struct instruction_info **instruction)
+int cpu_decoder_get_instruction(uint8_t opcode, const struct instruction_info **instruction)
 {
 	OK_OR_RETURN((unsigned)opcode < ARRAY_SIZE(isa_instruction_set), -EINVAL);
 
@@ -76,7 +244,7 @@ int cpu_decoder_get_instruction(uint8_t opcode, struct instruction_info **instru
 }
 
 LIBEXPORT
-int cpu_decoder_get_prefix_cb_instruction(uint8_t opcode, struct instruction_info **instruction)
+int cpu_decoder_get_prefix_cb_instruction(uint8_t opcode, const struct instruction_info **instruction)
 {
 	OK_OR_RETURN((unsigned)opcode < ARRAY_SIZE(prefix_isa_instruction_set), -EINVAL);
 
@@ -84,3 +252,23 @@ int cpu_decoder_get_prefix_cb_instruction(uint8_t opcode, struct instruction_inf
 
 	return 0;
 }
+
+LIBEXPORT
+int cpu_decoder_get_instruction_text(uint8_t opcode, const struct instruction_text **text)
+{
+	OK_OR_RETURN((unsigned)opcode < ARRAY_SIZE(isa_instruction_text), -EINVAL);
+
+	*text = &isa_instruction_text[opcode];
+
+	return 0;
+}
+
+LIBEXPORT
+int cpu_decoder_get_prefix_cb_instruction_text(uint8_t opcode, const struct instruction_text **text)
+{
+	OK_OR_RETURN((unsigned)opcode < ARRAY_SIZE(prefix_isa_instruction_text), -EINVAL);
+
+	*text = &prefix_isa_instruction_text[opcode];
+
+	return 0;
+}
@@ -1,5 +1,6 @@
 #include <errno.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <pgb/cpu/decoder.h>
 #include <pgb/cpu/instruction_info.h>
@@ -9,27 +10,184 @@
 #include <pgb/device/device.h>
 #include <pgb/utils.h>
 
+/*
+ * Decodes from the x/y/z/p/q fields of the opcode instead of looking the
+ * whole instruction up, see "Decoding Gameboy Z80 opcodes". What it derives
+ * matches the generated tables field for field, which
+ * cpu_logical_decoder_verify() checks.
+ */
+
+#define LOGICAL_OPERAND(field, TYPE, OPERAND, MODIFIER) do { \
+	(field).type = INSTRUCTION_OPERAND_TYPE_##TYPE; \
+	(field).operand = (OPERAND); \
+	(field).modifier = INSTRUCTION_OPERAND_MODIFIER_##MODIFIER; \
+} while (0)
+
+/* r[index], where 6 is (HL) accessed with MODIFIER */
+#define LOGICAL_OPERAND_R(field, index, MODIFIER) do { \
+	if ((index) == 6) \
+		LOGICAL_OPERAND(field, REGISTER16, INSTRUCTION_OPERAND_HL, MODIFIER); \
+	else \
+		LOGICAL_OPERAND(field, REGISTER8, logical_r[index], NONE); \
+} while (0)
+
+enum logical_flags {
+	LOGICAL_FLAGS_NONE,
+	LOGICAL_FLAGS_INC,
+	LOGICAL_FLAGS_DEC,
+	LOGICAL_FLAGS_ROTATE_A,
+	LOGICAL_FLAGS_ADD_HL,
+	LOGICAL_FLAGS_DAA,
+	LOGICAL_FLAGS_CPL,
+	LOGICAL_FLAGS_SCF,
+	LOGICAL_FLAGS_CCF,
+	LOGICAL_FLAGS_ADD,
+	LOGICAL_FLAGS_SUB,
+	LOGICAL_FLAGS_AND,
+	LOGICAL_FLAGS_OR,
+	LOGICAL_FLAGS_POP_AF,
+	LOGICAL_FLAGS_SP_I8,
+	LOGICAL_FLAGS_ROTATE,
+	LOGICAL_FLAGS_SHIFT_RESET_C,
+	LOGICAL_FLAGS_BIT
+};
+
+/* mask, zero, sub, half carry, carry */
+static
+const uint8_t logical_flag_modifiers[][5] = {
+	[LOGICAL_FLAGS_NONE] = { 0x0, 3, 3, 3, 3 },
+	[LOGICAL_FLAGS_INC] = { 0xe, 2, 0, 2, 3 },
+	[LOGICAL_FLAGS_DEC] = { 0xe, 2, 1, 2, 3 },
+	[LOGICAL_FLAGS_ROTATE_A] = { 0xf, 0, 0, 0, 2 },
+	[LOGICAL_FLAGS_ADD_HL] = { 0x7, 3, 0, 2, 2 },
+	[LOGICAL_FLAGS_DAA] = { 0xb, 2, 3, 0, 2 },
+	[LOGICAL_FLAGS_CPL] = { 0x6, 3, 1, 1, 3 },
+	[LOGICAL_FLAGS_SCF] = { 0x7, 3, 0, 0, 1 },
+	[LOGICAL_FLAGS_CCF] = { 0x7, 3, 0, 0, 2 },
+	[LOGICAL_FLAGS_ADD] = { 0xf, 2, 0, 2, 2 },
+	[LOGICAL_FLAGS_SUB] = { 0xf, 2, 1, 2, 2 },
+	[LOGICAL_FLAGS_AND] = { 0xf, 2, 0, 1, 0 },
+	[LOGICAL_FLAGS_OR] = { 0xf, 2, 0, 0, 0 },
+	[LOGICAL_FLAGS_POP_AF] = { 0xf, 2, 2, 2, 2 },
+	[LOGICAL_FLAGS_SP_I8] = { 0xf, 0, 0, 2, 2 },
+	[LOGICAL_FLAGS_ROTATE] = { 0xf, 2, 0, 0, 2 },
+	[LOGICAL_FLAGS_SHIFT_RESET_C] = { 0xf, 2, 0, 0, 0 },
+	[LOGICAL_FLAGS_BIT] = { 0xe, 2, 0, 1, 3 },
+};
+
+static
+const enum instruction_operand logical_r[] = {
+	INSTRUCTION_OPERAND_B, INSTRUCTION_OPERAND_C, INSTRUCTION_OPERAND_D, INSTRUCTION_OPERAND_E,
+	INSTRUCTION_OPERAND_H, INSTRUCTION_OPERAND_L, INSTRUCTION_OPERAND_HL, INSTRUCTION_OPERAND_A
+};
+
+static
+const enum instruction_operand logical_rp[] = {
+	INSTRUCTION_OPERAND_BC, INSTRUCTION_OPERAND_DE, INSTRUCTION_OPERAND_HL, INSTRUCTION_OPERAND_SP
+};
+
+static
+const enum instruction_operand logical_rp2[] = {
+	INSTRUCTION_OPERAND_BC, INSTRUCTION_OPERAND_DE, INSTRUCTION_OPERAND_HL, INSTRUCTION_OPERAND_AF
+};
+
+static
+const enum instruction_operand logical_cc[] = {
+	INSTRUCTION_OPERAND_COND_NZ, INSTRUCTION_OPERAND_COND_Z, INSTRUCTION_OPERAND_COND_NC, INSTRUCTION_OPERAND_COND_C
+};
+
+static
+const enum instruction_class logical_alu[] = {
+	INSTRUCTION_CLASS_ADD, INSTRUCTION_CLASS_ADC, INSTRUCTION_CLASS_SUB, INSTRUCTION_CLASS_SBC,
+	INSTRUCTION_CLASS_AND, INSTRUCTION_CLASS_XOR, INSTRUCTION_CLASS_OR, INSTRUCTION_CLASS_CP
+};
+
+static
+const enum logical_flags logical_alu_flags[] = {
+	LOGICAL_FLAGS_ADD, LOGICAL_FLAGS_ADD, LOGICAL_FLAGS_SUB, LOGICAL_FLAGS_SUB,
+	LOGICAL_FLAGS_AND, LOGICAL_FLAGS_OR, LOGICAL_FLAGS_OR, LOGICAL_FLAGS_SUB
+};
+
+static
+const enum instruction_class logical_rot[] = {
+	INSTRUCTION_CLASS_RLC, INSTRUCTION_CLASS_RRC, INSTRUCTION_CLASS_RL, INSTRUCTION_CLASS_RR,
+	INSTRUCTION_CLASS_SLA, INSTRUCTION_CLASS_SRA, INSTRUCTION_CLASS_SWAP, INSTRUCTION_CLASS_SRL
+};
+
 static
-int cpu_logical_decoder_prefix_cb_instr(uint8_t opcode, uint8_t *instruction_buffer,
-					struct decoded_instruction *decoded_instruction)
+const enum instruction_class logical_accumulator_ops[] = {
+	INSTRUCTION_CLASS_RLCA, INSTRUCTION_CLASS_RRCA, INSTRUCTION_CLASS_RLA, INSTRUCTION_CLASS_RRA,
+	INSTRUCTION_CLASS_DAA, INSTRUCTION_CLASS_CPL, INSTRUCTION_CLASS_SCF, INSTRUCTION_CLASS_CCF
+};
+
+static
+const enum logical_flags logical_accumulator_flags[] = {
+	LOGICAL_FLAGS_ROTATE_A, LOGICAL_FLAGS_ROTATE_A, LOGICAL_FLAGS_ROTATE_A, LOGICAL_FLAGS_ROTATE_A,
+	LOGICAL_FLAGS_DAA, LOGICAL_FLAGS_CPL, LOGICAL_FLAGS_SCF, LOGICAL_FLAGS_CCF
+};
+
+static
+void logical_set(struct instruction_info *info, enum instruction_class instruction_class, size_t num_bytes,
+		 size_t c0, size_t c1, enum logical_flags flags)
+{
+	const uint8_t *modifiers = logical_flag_modifiers[flags];
+
+	info->instruction_class = instruction_class;
+	info->num_bytes = num_bytes;
+	info->timing.c0 = c0;
+	info->timing.c1 = c1;
+	info->flag_modifiers.flag_mask = modifiers[0];
+	info->flag_modifiers.flag_zero = modifiers[1];
+	info->flag_modifiers.flag_sub = modifiers[2];
+	info->flag_modifiers.flag_half_carry = modifiers[3];
+	info->flag_modifiers.flag_carry = modifiers[4];
+}
+
+/* ADD, ADC and SBC name A as their first operand, the other ALU ops leave it implied */
+static
+bool logical_alu_names_a(uint8_t y)
+{
+	return y == 0 || y == 1 || y == 3;
+}
+
+static
+int cpu_logical_decoder_prefix_cb_instr(uint8_t opcode, struct instruction_info *info)
 {
 	int ret = 0;
-	uint8_t x;
+	uint8_t x, y, z;
+	size_t cycles;
 
 	x = BF_GET_FLD(LR35902_OPCODE_FIELD_X, opcode);
+	y = BF_GET_FLD(LR35902_OPCODE_FIELD_Y, opcode);
+	z = BF_GET_FLD(LR35902_OPCODE_FIELD_Z, opcode);
+
+	cycles = z == 6 ? 16 : 8;
 
 	switch (x) {
 	case 0:
 		/* Roll/Shift register or memory location */
+		logical_set(info, logical_rot[y], 2, cycles, cycles,
+			    logical_rot[y] == INSTRUCTION_CLASS_SRA || logical_rot[y] == INSTRUCTION_CLASS_SWAP ?
+			    LOGICAL_FLAGS_SHIFT_RESET_C : LOGICAL_FLAGS_ROTATE);
+		LOGICAL_OPERAND_R(info->operands.a, z, MEM_WRITE_16);
 		break;
 	case 1:
 		/* Test bit */
+		logical_set(info, INSTRUCTION_CLASS_BIT, 2, cycles, cycles, LOGICAL_FLAGS_BIT);
+		LOGICAL_OPERAND(info->operands.a, U3, INSTRUCTION_OPERAND_U3_0 + y, NONE);
+		LOGICAL_OPERAND_R(info->operands.b, z, MEM_READ_16);
 		break;
 	case 2:
 		/* Reset bit */
+		logical_set(info, INSTRUCTION_CLASS_RES, 2, cycles, cycles, LOGICAL_FLAGS_NONE);
+		LOGICAL_OPERAND(info->operands.a, U3, INSTRUCTION_OPERAND_U3_0 + y, NONE);
+		LOGICAL_OPERAND_R(info->operands.b, z, MEM_READ_16);
 		break;
 	case 3:
 		/* Set bit */
+		logical_set(info, INSTRUCTION_CLASS_SET, 2, cycles, cycles, LOGICAL_FLAGS_NONE);
+		LOGICAL_OPERAND(info->operands.a, U3, INSTRUCTION_OPERAND_U3_0 + y, NONE);
+		LOGICAL_OPERAND_R(info->operands.b, z, MEM_READ_16);
 		break;
 	default:
 		ret = -EINVAL;
@@ -40,38 +198,156 @@ int cpu_logical_decoder_prefix_cb_instr(uint8_t opcode, uint8_t *instruction_buf
 }
 
 static
-int cpu_logical_decoder_decode_core_x_3(uint8_t opcode, uint8_t *instruction_buffer,
-					struct decoded_instruction *decoded_instruction)
+int cpu_logical_decoder_decode_core_x_3(uint8_t opcode, struct instruction_info *info)
 {
 	int ret = 0;
-	uint8_t z;
+	uint8_t y, z, p, q;
 
+	y = BF_GET_FLD(LR35902_OPCODE_FIELD_Y, opcode);
 	z = BF_GET_FLD(LR35902_OPCODE_FIELD_Z, opcode);
+	p = BF_GET_FLD(LR35902_OPCODE_FIELD_P, opcode);
+	q = BF_GET_FLD(LR35902_OPCODE_FIELD_Q, opcode);
 
 	switch (z) {
 	case 0:
-		/* Conditional return */
+		/* Conditional return, and the high page and SP offset ops in its place */
+		switch (y) {
+		case 4:
+			logical_set(info, INSTRUCTION_CLASS_LDH, 2, 12, 12, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, U8, INSTRUCTION_OPERAND_U8, MEM_WRITE_8);
+			LOGICAL_OPERAND(info->operands.b, REGISTER8, INSTRUCTION_OPERAND_A, NONE);
+			break;
+		case 5:
+			logical_set(info, INSTRUCTION_CLASS_ADD, 2, 16, 16, LOGICAL_FLAGS_SP_I8);
+			LOGICAL_OPERAND(info->operands.a, REGISTER16, INSTRUCTION_OPERAND_SP, NONE);
+			LOGICAL_OPERAND(info->operands.b, I8, INSTRUCTION_OPERAND_I8, NONE);
+			break;
+		case 6:
+			logical_set(info, INSTRUCTION_CLASS_LDH, 2, 12, 12, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, REGISTER8, INSTRUCTION_OPERAND_A, NONE);
+			LOGICAL_OPERAND(info->operands.b, U8, INSTRUCTION_OPERAND_U8, MEM_READ_8);
+			break;
+		case 7:
+			logical_set(info, INSTRUCTION_CLASS_LDHL, 2, 12, 12, LOGICAL_FLAGS_SP_I8);
+			LOGICAL_OPERAND(info->operands.a, REGISTER16, INSTRUCTION_OPERAND_SP, NONE);
+			LOGICAL_OPERAND(info->operands.b, I8, INSTRUCTION_OPERAND_I8, NONE);
+			break;
+		default:
+			logical_set(info, INSTRUCTION_CLASS_RET, 1, 20, 8, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, CONDITION, logical_cc[y], NONE);
+			break;
+		}
 		break;
 	case 1:
 		/* POP and various ops */
+		if (q == 0) {
+			logical_set(info, INSTRUCTION_CLASS_POP, 1, 12, 12, p == 3 ? LOGICAL_FLAGS_POP_AF : LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, REGISTER16, logical_rp2[p], NONE);
+			break;
+		}
+
+		switch (p) {
+		case 0:
+			logical_set(info, INSTRUCTION_CLASS_RET, 1, 16, 16, LOGICAL_FLAGS_NONE);
+			break;
+		case 1:
+			logical_set(info, INSTRUCTION_CLASS_RETI, 1, 16, 16, LOGICAL_FLAGS_NONE);
+			break;
+		case 2:
+			logical_set(info, INSTRUCTION_CLASS_JP, 1, 4, 4, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, REGISTER16, INSTRUCTION_OPERAND_HL, MEM_WRITE_16);
+			break;
+		default:
+			logical_set(info, INSTRUCTION_CLASS_LD, 1, 8, 8, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, REGISTER16, INSTRUCTION_OPERAND_SP, NONE);
+			LOGICAL_OPERAND(info->operands.b, REGISTER16, INSTRUCTION_OPERAND_HL, NONE);
+			break;
+		}
 		break;
 	case 2:
-		/* Conditional jump */
+		/* Conditional jump, and the (C) and (a16) loads in its place */
+		switch (y) {
+		case 4:
+			logical_set(info, INSTRUCTION_CLASS_LD, 1, 8, 8, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, REGISTER8, INSTRUCTION_OPERAND_C, MEM_WRITE_8);
+			LOGICAL_OPERAND(info->operands.b, REGISTER8, INSTRUCTION_OPERAND_A, NONE);
+			break;
+		case 5:
+			logical_set(info, INSTRUCTION_CLASS_LD, 3, 16, 16, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, U16, INSTRUCTION_OPERAND_U16, MEM_WRITE_16);
+			LOGICAL_OPERAND(info->operands.b, REGISTER8, INSTRUCTION_OPERAND_A, NONE);
+			break;
+		case 6:
+			logical_set(info, INSTRUCTION_CLASS_LD, 1, 8, 8, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, REGISTER8, INSTRUCTION_OPERAND_A, NONE);
+			LOGICAL_OPERAND(info->operands.b, REGISTER8, INSTRUCTION_OPERAND_C, MEM_READ_8);
+			break;
+		case 7:
+			logical_set(info, INSTRUCTION_CLASS_LD, 3, 16, 16, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, REGISTER8, INSTRUCTION_OPERAND_A, NONE);
+			LOGICAL_OPERAND(info->operands.b, U16, INSTRUCTION_OPERAND_U16, MEM_READ_16);
+			break;
+		default:
+			logical_set(info, INSTRUCTION_CLASS_JP, 3, 16, 12, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, CONDITION, logical_cc[y], NONE);
+			LOGICAL_OPERAND(info->operands.b, U16, INSTRUCTION_OPERAND_U16, NONE);
+			break;
+		}
 		break;
 	case 3:
 		/* Assorted operations */
+		switch (y) {
+		case 0:
+			logical_set(info, INSTRUCTION_CLASS_JP, 3, 16, 16, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, U16, INSTRUCTION_OPERAND_U16, NONE);
+			break;
+		case 1:
+			logical_set(info, INSTRUCTION_CLASS_PREFIX, 1, 4, 4, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, NONE, INSTRUCTION_OPERAND_NONE, CB);
+			break;
+		case 6:
+			logical_set(info, INSTRUCTION_CLASS_DI, 1, 4, 4, LOGICAL_FLAGS_NONE);
+			break;
+		case 7:
+			logical_set(info, INSTRUCTION_CLASS_EI, 1, 4, 4, LOGICAL_FLAGS_NONE);
+			break;
+		default:
+			/* The Z80's OUT, IN and EX have no counterpart */
+			break;
+		}
 		break;
 	case 4:
 		/* conditional call */
+		if (y < 4) {
+			logical_set(info, INSTRUCTION_CLASS_CALL, 3, 24, 12, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, CONDITION, logical_cc[y], NONE);
+			LOGICAL_OPERAND(info->operands.b, U16, INSTRUCTION_OPERAND_U16, NONE);
+		}
 		break;
 	case 5:
 		/* PUSH and various ops */
+		if (q == 0) {
+			logical_set(info, INSTRUCTION_CLASS_PUSH, 1, 16, 16, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, REGISTER16, logical_rp2[p], NONE);
+		} else if (p == 0) {
+			logical_set(info, INSTRUCTION_CLASS_CALL, 3, 24, 24, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, U16, INSTRUCTION_OPERAND_U16, NONE);
+		}
 		break;
 	case 6:
 		/* Operate on accumulator and immediate operand */
+		logical_set(info, logical_alu[y], 2, 8, 8, logical_alu_flags[y]);
+		if (logical_alu_names_a(y)) {
+			LOGICAL_OPERAND(info->operands.a, REGISTER8, INSTRUCTION_OPERAND_A, NONE);
+			LOGICAL_OPERAND(info->operands.b, U8, INSTRUCTION_OPERAND_U8, NONE);
+		} else {
+			LOGICAL_OPERAND(info->operands.a, U8, INSTRUCTION_OPERAND_U8, NONE);
+		}
 		break;
 	case 7:
 		/* Restart */
+		logical_set(info, INSTRUCTION_CLASS_RST, 1, 16, 16, LOGICAL_FLAGS_NONE);
+		LOGICAL_OPERAND(info->operands.a, VEC, INSTRUCTION_OPERAND_VEC_00H + y, NONE);
 		break;
 	default:
 		ret = -EINVAL;
@@ -83,59 +359,56 @@ int cpu_logical_decoder_decode_core_x_3(uint8_t opcode, uint8_t *instruction_buf
 }
 
 static
-int cpu_logical_decoder_decode_core_x_2(uint8_t opcode, uint8_t *instruction_buffer,
-					struct decoded_instruction *decoded_instruction)
+int cpu_logical_decoder_decode_core_x_2(uint8_t opcode, struct instruction_info *info)
 {
+	uint8_t y, z;
+
+	y = BF_GET_FLD(LR35902_OPCODE_FIELD_Y, opcode);
+	z = BF_GET_FLD(LR35902_OPCODE_FIELD_Z, opcode);
+
 	/* Operate on accumulator and register/memory loacation */
+	logical_set(info, logical_alu[y], 1, z == 6 ? 8 : 4, z == 6 ? 8 : 4, logical_alu_flags[y]);
+
+	if (logical_alu_names_a(y)) {
+		LOGICAL_OPERAND(info->operands.a, REGISTER8, INSTRUCTION_OPERAND_A, NONE);
+		LOGICAL_OPERAND_R(info->operands.b, z, MEM_READ_16);
+	} else {
+		LOGICAL_OPERAND_R(info->operands.a, z, MEM_WRITE_16);
+	}
+
 	return 0;
 }
 
 static
-int cpu_logical_decoder_decode_core_x_1(uint8_t opcode, uint8_t *instruction_buffer,
-					struct decoded_instruction *decoded_instruction)
+int cpu_logical_decoder_decode_core_x_1(uint8_t opcode, struct instruction_info *info)
 {
-	int ret = 0;
-	uint8_t y, z, p, q;
-
-	(void) p; (void) q;
+	uint8_t y, z;
 
 	y = BF_GET_FLD(LR35902_OPCODE_FIELD_Y, opcode);
 	z = BF_GET_FLD(LR35902_OPCODE_FIELD_Z, opcode);
-	p = BF_GET_FLD(LR35902_OPCODE_FIELD_P, opcode);
-	q = BF_GET_FLD(LR35902_OPCODE_FIELD_Q, opcode);
 
 	if (z == 6 && y == 6) {
 		/* HALT */
+		logical_set(info, INSTRUCTION_CLASS_HALT, 1, 4, 4, LOGICAL_FLAGS_NONE);
 	} else {
-		switch (z) {
-		case 0:
-		case 1:
-		case 2:
-		case 3:
-		case 4:
-		case 5:
-		case 6:
-		case 7:
-			/* 8-bit loading */
-			break;
-		default:
-			ret = -EINVAL;
-			break;
-		}
+		/* 8-bit loading */
+		logical_set(info, INSTRUCTION_CLASS_LD, 1, y == 6 || z == 6 ? 8 : 4, y == 6 || z == 6 ? 8 : 4,
+			    LOGICAL_FLAGS_NONE);
+		LOGICAL_OPERAND_R(info->operands.a, y, MEM_WRITE_16);
+		LOGICAL_OPERAND_R(info->operands.b, z, MEM_READ_16);
 	}
-	OK_OR_WARN(ret == 0);
 
-	return ret;
+	return 0;
 }
 
 static
-int cpu_logical_decoder_decode_core_x_0(uint8_t opcode, uint8_t *instruction_buffer,
-					struct decoded_instruction *decoded_instruction)
+int cpu_logical_decoder_decode_core_x_0(uint8_t opcode, struct instruction_info *info)
 {
 	int ret = 0;
 	uint8_t y, z, p, q;
-
-	(void) p; (void) q; (void) y;
+	static const enum instruction_class indirect_classes[] = {
+		INSTRUCTION_CLASS_LD, INSTRUCTION_CLASS_LD, INSTRUCTION_CLASS_LDI, INSTRUCTION_CLASS_LDD
+	};
 
 	y = BF_GET_FLD(LR35902_OPCODE_FIELD_Y, opcode);
 	z = BF_GET_FLD(LR35902_OPCODE_FIELD_Z, opcode);
@@ -145,27 +418,76 @@ int cpu_logical_decoder_decode_core_x_0(uint8_t opcode, uint8_t *instruction_buf
 	switch (z) {
 	case 0:
 		/* Relative jumps and assorted ops */
+		switch (y) {
+		case 0:
+			logical_set(info, INSTRUCTION_CLASS_NOP, 1, 4, 4, LOGICAL_FLAGS_NONE);
+			break;
+		case 1:
+			logical_set(info, INSTRUCTION_CLASS_LD, 3, 20, 20, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, U16, INSTRUCTION_OPERAND_U16, MEM_WRITE_16);
+			LOGICAL_OPERAND(info->operands.b, REGISTER16, INSTRUCTION_OPERAND_SP, NONE);
+			break;
+		case 2:
+			logical_set(info, INSTRUCTION_CLASS_STOP, 2, 4, 4, LOGICAL_FLAGS_NONE);
+			break;
+		case 3:
+			logical_set(info, INSTRUCTION_CLASS_JR, 2, 12, 12, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, I8, INSTRUCTION_OPERAND_I8, NONE);
+			break;
+		default:
+			logical_set(info, INSTRUCTION_CLASS_JR, 2, 12, 8, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, CONDITION, logical_cc[y - 4], NONE);
+			LOGICAL_OPERAND(info->operands.b, I8, INSTRUCTION_OPERAND_I8, NONE);
+			break;
+		}
 		break;
 	case 1:
 		/* 16-bit load immediate/add */
+		if (q == 0) {
+			logical_set(info, INSTRUCTION_CLASS_LD, 3, 12, 12, LOGICAL_FLAGS_NONE);
+			LOGICAL_OPERAND(info->operands.a, REGISTER16, logical_rp[p], NONE);
+			LOGICAL_OPERAND(info->operands.b, U16, INSTRUCTION_OPERAND_U16, NONE);
+		} else {
+			logical_set(info, INSTRUCTION_CLASS_ADD, 1, 8, 8, LOGICAL_FLAGS_ADD_HL);
+			LOGICAL_OPERAND(info->operands.a, REGISTER16, INSTRUCTION_OPERAND_HL, NONE);
+			LOGICAL_OPERAND(info->operands.b, REGISTER16, logical_rp[p], NONE);
+		}
 		break;
 	case 2:
-		/* Indirect loading */
+		/* Indirect loading, through HL with post increment or decrement for p = 2, 3 */
+		logical_set(info, indirect_classes[p], 1, 8, 8, LOGICAL_FLAGS_NONE);
+		if (q == 0) {
+			LOGICAL_OPERAND(info->operands.a, REGISTER16, logical_rp[MIN(p, 2)], MEM_WRITE_16);
+			LOGICAL_OPERAND(info->operands.b, REGISTER8, INSTRUCTION_OPERAND_A, NONE);
+		} else {
+			LOGICAL_OPERAND(info->operands.a, REGISTER8, INSTRUCTION_OPERAND_A, NONE);
+			LOGICAL_OPERAND(info->operands.b, REGISTER16, logical_rp[MIN(p, 2)], MEM_READ_16);
+		}
 		break;
 	case 3:
 		/* 16-bit INC/DEC */
+		logical_set(info, q == 0 ? INSTRUCTION_CLASS_INC : INSTRUCTION_CLASS_DEC, 1, 8, 8, LOGICAL_FLAGS_NONE);
+		LOGICAL_OPERAND(info->operands.a, REGISTER16, logical_rp[p], NONE);
 		break;
 	case 4:
 		/* 8-bit INC */
+		logical_set(info, INSTRUCTION_CLASS_INC, 1, y == 6 ? 12 : 4, y == 6 ? 12 : 4, LOGICAL_FLAGS_INC);
+		LOGICAL_OPERAND_R(info->operands.a, y, MEM_WRITE_16);
 		break;
 	case 5:
 		/* 8 bit dec */
+		logical_set(info, INSTRUCTION_CLASS_DEC, 1, y == 6 ? 12 : 4, y == 6 ? 12 : 4, LOGICAL_FLAGS_DEC);
+		LOGICAL_OPERAND_R(info->operands.a, y, MEM_WRITE_16);
 		break;
 	case 6:
 		/* 8 bit load immediate */
+		logical_set(info, INSTRUCTION_CLASS_LD, 2, y == 6 ? 12 : 8, y == 6 ? 12 : 8, LOGICAL_FLAGS_NONE);
+		LOGICAL_OPERAND_R(info->operands.a, y, MEM_WRITE_16);
+		LOGICAL_OPERAND(info->operands.b, U8, INSTRUCTION_OPERAND_U8, NONE);
 		break;
 	case 7:
 		/* Assorted operations on accumulator/flags */
+		logical_set(info, logical_accumulator_ops[y], 1, 4, 4, logical_accumulator_flags[y]);
 		break;
 	default:
 		ret = -EINVAL;
@@ -177,8 +499,7 @@ int cpu_logical_decoder_decode_core_x_0(uint8_t opcode, uint8_t *instruction_buf
 }
 
 static
-int cpu_logical_decoder_decode_core_instr(uint8_t opcode, uint8_t *instruction_buffer,
-					  struct decoded_instruction *decoded_instruction)
+int cpu_logical_decoder_decode_core_instr(uint8_t opcode, struct instruction_info *info)
 {
 	int ret;
 	uint8_t x;
@@ -187,16 +508,16 @@ int cpu_logical_decoder_decode_core_instr(uint8_t opcode, uint8_t *instruction_b
 
 	switch (x) {
 	case 0:
-		ret = cpu_logical_decoder_decode_core_x_0(opcode, instruction_buffer, decoded_instruction);
+		ret = cpu_logical_decoder_decode_core_x_0(opcode, info);
 		break;
 	case 1:
-		ret = cpu_logical_decoder_decode_core_x_1(opcode, instruction_buffer, decoded_instruction);
+		ret = cpu_logical_decoder_decode_core_x_1(opcode, info);
 		break;
 	case 2:
-		ret = cpu_logical_decoder_decode_core_x_2(opcode, instruction_buffer, decoded_instruction);
+		ret = cpu_logical_decoder_decode_core_x_2(opcode, info);
 		break;
 	case 3:
-		ret = cpu_logical_decoder_decode_core_x_3(opcode, instruction_buffer, decoded_instruction);
+		ret = cpu_logical_decoder_decode_core_x_3(opcode, info);
 		break;
 	default:
 		ret = -EINVAL;
@@ -204,26 +525,95 @@ int cpu_logical_decoder_decode_core_instr(uint8_t opcode, uint8_t *instruction_b
 	}
 	OK_OR_WARN(ret == 0);
 
+	return ret;
+}
+
+/*
+ * Works out everything about opcode into info. Opcodes with no instruction
+ * come out as INSTRUCTION_CLASS_INVALID, as they do in the tables.
+ */
+static
+int cpu_logical_decoder_derive(uint8_t opcode, bool is_prefix, struct instruction_info *info)
+{
+	int ret;
+
+	memset(info, 0, sizeof(*info));
+	logical_set(info, INSTRUCTION_CLASS_INVALID, 0, 0, 0, LOGICAL_FLAGS_NONE);
+	info->opcode = opcode;
+	info->is_prefix = false;
+
+	if (is_prefix)
+		ret = cpu_logical_decoder_prefix_cb_instr(opcode, info);
+	else
+		ret = cpu_logical_decoder_decode_core_instr(opcode, info);
+	OK_OR_RETURN(ret == 0, ret);
+
 	return 0;
 }
 
 LIBEXPORT
-int cpu_logical_decoder_decode(struct device *device, uint8_t opcode,
+int cpu_logical_decoder_decode(struct device *device, uint8_t opcode, bool is_prefix,
 			       struct decoded_instruction *decoded_instruction)
 {
 	int ret;
+	struct instruction_info *info = &device->cpu.decoder.logical;
 
-	return -EINVAL;
+	ret = cpu_logical_decoder_derive(opcode, is_prefix, info);
+	OK_OR_RETURN(ret == 0, ret);
 
-	switch (opcode) {
-	case LR35902_OPCODE_PREFIX_CB:
-		ret = cpu_logical_decoder_prefix_cb_instr(opcode, NULL, decoded_instruction);
-		break;
-	default:
-		ret = cpu_logical_decoder_decode_core_instr(opcode, NULL, decoded_instruction);
-		break;
+	ret = cpu_decoder_read_operands(device, info, decoded_instruction);
+	OK_OR_RETURN(ret == 0, ret);
+
+	decoded_instruction->info = info;
+
+	return 0;
+}
+
+/*
+ * Decodes all 512 opcodes both ways and compares every field the interpreter
+ * reads. Returns -EILSEQ and names the first opcodes that differ on stream
+ * if the two decoders disagree.
+ */
+LIBEXPORT
+int cpu_logical_decoder_verify(FILE *stream, unsigned *mismatches)
+{
+	int ret;
+	unsigned opcode, count = 0;
+	bool is_prefix;
+	struct instruction_info derived;
+	const struct instruction_info *expected;
+	const struct instruction_text *text;
+
+	for (opcode = 0; opcode < 2 * LR35902_OPCODE_TABLE_SIZE; opcode++) {
+		is_prefix = opcode >= LR35902_OPCODE_TABLE_SIZE;
+
+		if (is_prefix)
+			ret = cpu_decoder_get_prefix_cb_instruction(opcode & 0xff, &expected);
+		else
+			ret = cpu_decoder_get_instruction(opcode & 0xff, &expected);
+		OK_OR_RETURN(ret == 0, ret);
+
+		ret = cpu_logical_decoder_derive(opcode & 0xff, is_prefix, &derived);
+		OK_OR_RETURN(ret == 0, ret);
+
+		/* Both sides start zeroed, so padding compares equal too */
+		if (memcmp(&derived, expected, sizeof(derived)) == 0)
+			continue;
+
+		if (is_prefix)
+			ret = cpu_decoder_get_prefix_cb_instruction_text(opcode & 0xff, &text);
+		else
+			ret = cpu_decoder_get_instruction_text(opcode & 0xff, &text);
+		OK_OR_RETURN(ret == 0, ret);
+
+		if (stream != NULL)
+			fprintf(stream, "%s%02x %s: logical decoder disagrees with the table\n",
+				is_prefix ? "cb " : "", opcode & 0xff, text->assembly);
+		count++;
 	}
-	OK_OR_WARN(ret == 0);
 
-	return ret;
+	if (mismatches != NULL)
+		*mismatches = count;
+
+	return count == 0 ? 0 : -EILSEQ;
 }
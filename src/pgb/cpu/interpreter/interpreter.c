@@ -3,9 +3,11 @@
 #include <stddef.h>
 
 #include <pgb/cpu/instruction_info.h>
+#include <pgb/cpu/private/flags.h>
 #include <pgb/cpu/private/lr35902.h>
 #include <pgb/cpu/registers.h>
 #include <pgb/debug.h>
+#include <pgb/device/device.h>
 #include <pgb/utils.h>
 
 #define DETECT_UNSIGNED_ARITHMETIC_OVERFLOW(a, b) (((a) + (b)) < (a))
@@ -50,17 +52,81 @@ int bit_u3_to_value(enum instruction_operand operand, uint8_t *value)
 	return ret;
 }
 
+/*
+ * The M-cycle core hands time to the rest of the device as the instruction
+ * gets to it, rather than all at once after it.
+ */
 static
-int utils_pop16(struct device *device, uint16_t *result)
+int interpreter_tick(struct device *device, struct decoded_instruction *instruction, uint8_t cycles)
+{
+	if (device->cpu.core != CPU_CORE_MCYCLE)
+		return 0;
+
+	instruction->elapsed += cycles;
+
+	return cpu_tick(device, cycles);
+}
+
+/* Memory accesses take an M-cycle each, which the access comes at the end of */
+static
+int interpreter_read8(struct device *device, struct decoded_instruction *instruction, uint16_t address, uint8_t *value)
+{
+	int ret;
+
+	ret = interpreter_tick(device, instruction, 4);
+	OK_OR_RETURN(ret == 0, ret);
+
+	return mmu_read8(&device->mmu, address, value);
+}
+
+static
+int interpreter_write8(struct device *device, struct decoded_instruction *instruction, uint16_t address, uint8_t value)
+{
+	int ret;
+
+	ret = interpreter_tick(device, instruction, 4);
+	OK_OR_RETURN(ret == 0, ret);
+
+	return mmu_write8(&device->mmu, address, value);
+}
+
+static
+int interpreter_read16(struct device *device, struct decoded_instruction *instruction, uint16_t address, uint16_t *value)
+{
+	int ret;
+	uint8_t lo, hi;
+
+	ret = interpreter_read8(device, instruction, address, &lo);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = interpreter_read8(device, instruction, address + 1, &hi);
+	OK_OR_RETURN(ret == 0, ret);
+
+	*value = (hi << 8) | lo;
+
+	return 0;
+}
+
+static
+int interpreter_write16(struct device *device, struct decoded_instruction *instruction, uint16_t address, uint16_t value)
+{
+	int ret;
+
+	ret = interpreter_write8(device, instruction, address, value & 0xff);
+	OK_OR_RETURN(ret == 0, ret);
+
+	return interpreter_write8(device, instruction, address + 1, value >> 8);
+}
+
+static
+int utils_pop16(struct device *device, struct decoded_instruction *instruction, uint16_t *result)
 {
 	int ret;
 	struct cpu *cpu;
-	struct mmu *mmu;
 
 	cpu = &device->cpu;
-	mmu = &device->mmu;
 
-	ret = mmu_read16(mmu, cpu->registers.sp, result);
+	ret = interpreter_read16(device, instruction, cpu->registers.sp, result);
 	OK_OR_RETURN(ret == 0, ret);
 
 	cpu->registers.sp += 2;
@@ -68,410 +134,578 @@ int utils_pop16(struct device *device, uint16_t *result)
 	return 0;
 }
 
+/* Pushes take an internal M-cycle before writing the high byte, then the low */
 static
-int utils_push16(struct device *device, uint16_t value)
+int utils_push16(struct device *device, struct decoded_instruction *instruction, uint16_t value)
 {
 	int ret;
 	struct cpu *cpu;
-	struct mmu *mmu;
 
 	cpu = &device->cpu;
-	mmu = &device->mmu;
+
+	ret = interpreter_tick(device, instruction, 4);
+	OK_OR_RETURN(ret == 0, ret);
 
 	cpu->registers.sp -= 2;
 
-	ret = mmu_write16(mmu, cpu->registers.sp, value);
+	ret = interpreter_write8(device, instruction, cpu->registers.sp + 1, value >> 8);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = interpreter_write8(device, instruction, cpu->registers.sp, value & 0xff);
 	OK_OR_WARN(ret == 0);
 
 	return ret;
 }
 
+/*
+ * Address of a memory operand: (rr), (a16), and the high page forms (C) and
+ * (a8). second picks operand b over operand a.
+ */
 static
-int interpreter_execute_instruction_adc(struct device *device, struct decoded_instruction *instruction)
-{
-	TRAP_GDB("Not implemented: instruction 'adc'");
-	return 0;
-}
-
-static
-int interpreter_execute_instruction_add(struct device *device, struct decoded_instruction *instruction)
+int interpreter_operand_address(struct device *device, struct decoded_instruction *instruction, bool second, uint16_t *address)
 {
-	int ret;
-	uint8_t src8, dst8;
-	uint16_t src16, dst16;
-	struct cpu *cpu;
-	struct instruction_info *info;
+	int ret = 0;
+	uint8_t r8;
+	enum instruction_operand_type type;
+	enum instruction_operand operand;
+	const struct instruction_info *info;
 
-	cpu = &device->cpu;
 	info = instruction->info;
+	type = second ? info->operands.b.type : info->operands.a.type;
+	operand = second ? info->operands.b.operand : info->operands.a.operand;
 
-	switch (info->operands.a.type) {
+	switch (type) {
 	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.a.operand, &dst8);
+		ret = cpu_register_read8(&device->cpu, operand, &r8);
+		*address = 0xff00 + r8;
 		break;
 	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_read16(cpu, info->operands.a.operand, &dst16);
+		ret = cpu_register_read16(&device->cpu, operand, address);
+		break;
+	case INSTRUCTION_OPERAND_TYPE_U8:
+		*address = 0xff00 + (second ? instruction->b.u8 : instruction->a.u8);
+		break;
+	case INSTRUCTION_OPERAND_TYPE_U16:
+		*address = second ? instruction->b.u16 : instruction->a.u16;
 		break;
 	default:
 		ret = -EINVAL;
 		break;
 	}
-	OK_OR_RETURN(ret == 0, ret);
 
-	switch (info->operands.b.type) {
+	return ret;
+}
+
+/* Reads an 8-bit operand: a register, an immediate or memory */
+static
+int interpreter_read_operand8(struct device *device, struct decoded_instruction *instruction, bool second, uint8_t *value)
+{
+	int ret;
+	uint16_t address;
+	const struct instruction_info *info;
+
+	info = instruction->info;
+
+	if ((second ? info->operands.b.modifier : info->operands.a.modifier) != INSTRUCTION_OPERAND_MODIFIER_NONE) {
+		ret = interpreter_operand_address(device, instruction, second, &address);
+		OK_OR_RETURN(ret == 0, ret);
+
+		return interpreter_read8(device, instruction, address, value);
+	}
+
+	switch (second ? info->operands.b.type : info->operands.a.type) {
 	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.b.operand, &src8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_read16(cpu, info->operands.b.operand, &src16);
+		ret = cpu_register_read8(&device->cpu, second ? info->operands.b.operand : info->operands.a.operand, value);
 		break;
-	case INSTRUCTION_OPERAND_TYPE_NONE:
-		ret = cpu_register_read8(cpu, INSTRUCTION_OPERAND_A, &src8);
+	case INSTRUCTION_OPERAND_TYPE_U8:
+		*value = second ? instruction->b.u8 : instruction->a.u8;
+		ret = 0;
 		break;
 	default:
 		ret = -EINVAL;
 		break;
 	}
-	OK_OR_RETURN(ret == 0, ret);
 
-	switch (info->operands.a.type) {
+	return ret;
+}
+
+/* Writes an 8-bit operand: a register or memory */
+static
+int interpreter_write_operand8(struct device *device, struct decoded_instruction *instruction, bool second, uint8_t value)
+{
+	int ret;
+	uint16_t address;
+	const struct instruction_info *info;
+
+	info = instruction->info;
+
+	if ((second ? info->operands.b.modifier : info->operands.a.modifier) != INSTRUCTION_OPERAND_MODIFIER_NONE) {
+		ret = interpreter_operand_address(device, instruction, second, &address);
+		OK_OR_RETURN(ret == 0, ret);
+
+		return interpreter_write8(device, instruction, address, value);
+	}
+
+	switch (second ? info->operands.b.type : info->operands.a.type) {
 	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		dst8 += src8;
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		dst16 += src16;
+		ret = cpu_register_write8(&device->cpu, second ? info->operands.b.operand : info->operands.a.operand, value);
 		break;
 	default:
 		ret = -EINVAL;
 		break;
 	}
-	OK_OR_RETURN(ret == 0, ret);
 
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_write8(cpu, info->operands.a.operand, dst8);
+	return ret;
+}
+
+static
+int interpreter_condition_met(struct cpu *cpu, enum instruction_operand condition, bool *condition_met)
+{
+	int ret = 0;
+
+	flags_sync(cpu);
+
+	switch (condition) {
+	case INSTRUCTION_OPERAND_COND_Z:
+		*condition_met = cpu->registers.flags.zero == 1;
 		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_write16(cpu, info->operands.a.operand, dst16);
+	case INSTRUCTION_OPERAND_COND_NZ:
+		*condition_met = cpu->registers.flags.zero == 0;
+		break;
+	case INSTRUCTION_OPERAND_COND_C:
+		*condition_met = cpu->registers.flags.carry == 1;
+		break;
+	case INSTRUCTION_OPERAND_COND_NC:
+		*condition_met = cpu->registers.flags.carry == 0;
 		break;
 	default:
 		ret = -EINVAL;
 		break;
 	}
-	OK_OR_WARN(ret == 0);
 
 	return ret;
 }
 
+/*
+ * ADD, ADC, SUB, SBC, AND, XOR, OR and CP on A. The table names the source
+ * second for ADD A, n, ADC and SBC, and first for the others.
+ */
 static
-int interpreter_execute_instruction_addc(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_alu8(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'addc'");
+	int ret;
+	uint8_t a, value, carry;
+	struct cpu *cpu;
+	const struct instruction_info *info;
+
+	cpu = &device->cpu;
+	info = instruction->info;
+	carry = 0;
+
+	ret = interpreter_read_operand8(device, instruction, info->operands.b.type != INSTRUCTION_OPERAND_TYPE_NONE, &value);
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (info->instruction_class == INSTRUCTION_CLASS_ADC || info->instruction_class == INSTRUCTION_CLASS_SBC) {
+		flags_sync(cpu);
+		carry = cpu->registers.flags.carry;
+	}
+
+	a = cpu->registers.a;
+
+	switch (info->instruction_class) {
+	case INSTRUCTION_CLASS_ADD:
+	case INSTRUCTION_CLASS_ADC:
+		flags_set(cpu, LAZY_FLAGS_OP_ADD, a, value, carry);
+		a += value + carry;
+		break;
+	case INSTRUCTION_CLASS_SUB:
+	case INSTRUCTION_CLASS_SBC:
+		flags_set(cpu, LAZY_FLAGS_OP_SUB, a, value, carry);
+		a -= value + carry;
+		break;
+	case INSTRUCTION_CLASS_CP:
+		flags_set(cpu, LAZY_FLAGS_OP_SUB, a, value, 0);
+		break;
+	case INSTRUCTION_CLASS_AND:
+		a &= value;
+		flags_set(cpu, LAZY_FLAGS_OP_AND, a, 0, 0);
+		break;
+	case INSTRUCTION_CLASS_XOR:
+		a ^= value;
+		flags_set(cpu, LAZY_FLAGS_OP_OR, a, 0, 0);
+		break;
+	case INSTRUCTION_CLASS_OR:
+		a |= value;
+		flags_set(cpu, LAZY_FLAGS_OP_OR, a, 0, 0);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	cpu->registers.a = a;
+
 	return 0;
 }
 
+/* INC and DEC of an 8-bit register, (HL), or a register pair */
 static
-int interpreter_execute_instruction_and(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_inc_dec(struct device *device, struct decoded_instruction *instruction, int delta)
 {
-	TRAP_GDB("Not implemented: instruction 'and'");
-	return 0;
+	int ret;
+	uint8_t v8;
+	uint16_t v16;
+	struct cpu *cpu;
+	const struct instruction_info *info;
+
+	cpu = &device->cpu;
+	info = instruction->info;
+
+	if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_REGISTER16 &&
+	    info->operands.a.modifier == INSTRUCTION_OPERAND_MODIFIER_NONE) {
+		ret = cpu_register_read16(cpu, info->operands.a.operand, &v16);
+		OK_OR_RETURN(ret == 0, ret);
+
+		return cpu_register_write16(cpu, info->operands.a.operand, v16 + delta);
+	}
+
+	ret = interpreter_read_operand8(device, instruction, false, &v8);
+	OK_OR_RETURN(ret == 0, ret);
+
+	flags_set(cpu, delta > 0 ? LAZY_FLAGS_OP_INC : LAZY_FLAGS_OP_DEC, v8, 0, 0);
+
+	ret = interpreter_write_operand8(device, instruction, false, v8 + delta);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
 }
 
+/*
+ * The CB rotates and shifts, and the RLCA, RRCA, RLA and RRA forms on A,
+ * which have no operand and always reset Z.
+ */
 static
-int interpreter_execute_instruction_call(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_shift(struct device *device, struct decoded_instruction *instruction)
 {
-	int ret = 0;
-	uint16_t address;
-	bool condition_met, is_condition;
+	int ret;
+	uint8_t value, result, carry;
+	bool accumulator;
 	struct cpu *cpu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
 	info = instruction->info;
+	accumulator = info->operands.a.type == INSTRUCTION_OPERAND_TYPE_NONE;
 
-	if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_CONDITION) {
-		is_condition = true;
-		address = instruction->b.u16;
+	if (accumulator) {
+		value = cpu->registers.a;
 	} else {
-		is_condition = false;
-		address = instruction->a.u16;
+		ret = interpreter_read_operand8(device, instruction, false, &value);
+		OK_OR_RETURN(ret == 0, ret);
 	}
 
-	if (is_condition) {
-		switch (info->operands.a.operand) {
-		case INSTRUCTION_OPERAND_COND_Z:
-			condition_met = cpu->registers.flags.zero == 1;
-			break;
-		case INSTRUCTION_OPERAND_COND_NZ:
-			condition_met = cpu->registers.flags.zero == 0;
-			break;
-		default:
-			ret = -EINVAL;
-			break;
-		}
-		OK_OR_RETURN(ret == 0, ret);
+	switch (info->instruction_class) {
+	case INSTRUCTION_CLASS_RLC:
+	case INSTRUCTION_CLASS_RLCA:
+		carry = value >> 7;
+		result = (value << 1) | carry;
+		break;
+	case INSTRUCTION_CLASS_RRC:
+	case INSTRUCTION_CLASS_RRCA:
+		carry = value & 1;
+		result = (value >> 1) | (carry << 7);
+		break;
+	case INSTRUCTION_CLASS_RL:
+	case INSTRUCTION_CLASS_RLA:
+		flags_sync(cpu);
+		carry = value >> 7;
+		result = (value << 1) | cpu->registers.flags.carry;
+		break;
+	case INSTRUCTION_CLASS_RR:
+	case INSTRUCTION_CLASS_RRA:
+		flags_sync(cpu);
+		carry = value & 1;
+		result = (value >> 1) | (cpu->registers.flags.carry << 7);
+		break;
+	case INSTRUCTION_CLASS_SLA:
+		carry = value >> 7;
+		result = value << 1;
+		break;
+	case INSTRUCTION_CLASS_SRA:
+		carry = value & 1;
+		result = (value >> 1) | (value & 0x80);
+		break;
+	case INSTRUCTION_CLASS_SRL:
+		carry = value & 1;
+		result = value >> 1;
+		break;
+	case INSTRUCTION_CLASS_SWAP:
+		carry = 0;
+		result = (value << 4) | (value >> 4);
+		break;
+	default:
+		return -EINVAL;
 	}
 
-	if ((is_condition && condition_met) || !is_condition) {
-		ret = utils_push16(device, cpu->registers.pc);
-		OK_OR_RETURN(ret == 0, ret);
+	if (accumulator) {
+		cpu->registers.a = result;
+		flags_set(cpu, LAZY_FLAGS_OP_ROTATE_A, result, 0, carry);
 
-		cpu->registers.pc = address;
+		return 0;
 	}
 
-	return 0;
+	flags_set(cpu, LAZY_FLAGS_OP_SHIFT, result, 0, carry);
+
+	ret = interpreter_write_operand8(device, instruction, false, result);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
 }
 
+/* RES and SET of bit a in register or (HL) b */
 static
-int interpreter_execute_instruction_ccf(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_res_set(struct device *device, struct decoded_instruction *instruction, bool set)
 {
-	TRAP_GDB("Not implemented: instruction 'ccf'");
-	return 0;
+	int ret;
+	uint8_t bit, value;
+
+	ret = bit_u3_to_value(instruction->info->operands.a.operand, &bit);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = interpreter_read_operand8(device, instruction, true, &value);
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (set)
+		value |= 1 << bit;
+	else
+		value &= ~(1 << bit);
+
+	ret = interpreter_write_operand8(device, instruction, true, value);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
 }
 
 static
-int interpreter_execute_instruction_cp(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_adc(struct device *device, struct decoded_instruction *instruction)
 {
-	int ret = 0;
-	uint8_t a, v8;
+	return interpreter_execute_alu8(device, instruction);
+}
+
+static
+int interpreter_execute_instruction_add(struct device *device, struct decoded_instruction *instruction)
+{
+	int ret;
+	uint16_t src16, dst16;
 	struct cpu *cpu;
-	struct mmu *mmu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
-	mmu = &device->mmu;
 	info = instruction->info;
 
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.a.operand, &v8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = mmu_read8(mmu, cpu->registers.hl, &v8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_U8:
-		v8 = instruction->a.u8;
-		break;
-	default:
-		ret = -EINVAL;
-		break;
+	if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_REGISTER8)
+		return interpreter_execute_alu8(device, instruction);
+
+	/* ADD SP, i8 */
+	if (info->operands.b.type == INSTRUCTION_OPERAND_TYPE_I8) {
+		flags_set(cpu, LAZY_FLAGS_OP_ADD_SP, cpu->registers.sp, (uint8_t)instruction->b.i8, 0);
+		cpu->registers.sp += instruction->b.i8;
+
+		return 0;
 	}
+
+	ret = cpu_register_read16(cpu, info->operands.a.operand, &dst16);
 	OK_OR_RETURN(ret == 0, ret);
 
-	a = cpu->registers.a;
-	// Operation performed here is A - n
-	cpu->registers.flags.zero = (a == v8);
-	cpu->registers.flags.subtraction = 1;
-	cpu->registers.flags.half_carry = (((a & 0xf) - (v8 & 0xf)) < 0);
-	cpu->registers.flags.carry = (a < v8);
+	ret = cpu_register_read16(cpu, info->operands.b.operand, &src16);
+	OK_OR_RETURN(ret == 0, ret);
 
-	return 0;
+	flags_set(cpu, LAZY_FLAGS_OP_ADD16, dst16, src16, 0);
+
+	ret = cpu_register_write16(cpu, info->operands.a.operand, dst16 + src16);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
 }
 
 static
-int interpreter_execute_instruction_cpl(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_addc(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'cpl'");
-	return 0;
+	/* No opcode decodes to ADDC, ADC has its own class */
+	return -EINVAL;
 }
 
 static
-int interpreter_execute_instruction_daa(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_and(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'daa'");
-	return 0;
+	return interpreter_execute_alu8(device, instruction);
 }
 
 static
-int interpreter_execute_instruction_dec(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_call(struct device *device, struct decoded_instruction *instruction)
 {
 	int ret;
-	uint8_t src8;
-	uint16_t src16;
+	uint16_t address;
+	bool condition_met;
 	struct cpu *cpu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
 	info = instruction->info;
+	condition_met = true;
 
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.a.operand, &src8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_read16(cpu, info->operands.a.operand, &src16);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
+	if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_CONDITION) {
+		ret = interpreter_condition_met(cpu, info->operands.a.operand, &condition_met);
+		OK_OR_RETURN(ret == 0, ret);
 
-	switch (info->operands.a.type) {
-		case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		src8 -= 1;
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		src16 -= 1;
-		break;
-	default:
-		ret = -EINVAL;
-		break;
+		address = instruction->b.u16;
+	} else {
+		address = instruction->a.u16;
 	}
-	OK_OR_RETURN(ret == 0, ret);
 
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_write8(cpu, info->operands.a.operand, src8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_write16(cpu, info->operands.a.operand, src16);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
+	if (!condition_met) {
+		instruction->cycles = info->timing.c1;
+		return 0;
 	}
+
+	ret = utils_push16(device, instruction, cpu->registers.pc);
 	OK_OR_RETURN(ret == 0, ret);
 
-	cpu->registers.flags.zero = (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_REGISTER8 ? (src8 == 0) : (src16 == 0));
-	cpu->registers.flags.subtraction = 1;
-	cpu->registers.flags.half_carry = cpu->registers.flags.zero;
+	cpu->registers.pc = address;
 
 	return 0;
 }
 
 static
-int interpreter_execute_instruction_di(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_ccf(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'di'");
+	struct cpu *cpu;
+
+	cpu = &device->cpu;
+
+	flags_sync(cpu);
+
+	cpu->registers.flags.subtraction = 0;
+	cpu->registers.flags.half_carry = 0;
+	cpu->registers.flags.carry = !cpu->registers.flags.carry;
+
 	return 0;
 }
 
 static
-int interpreter_execute_instruction_ei(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_cp(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'ei'");
-	return 0;
+	return interpreter_execute_alu8(device, instruction);
 }
 
 static
-int interpreter_execute_instruction_halt(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_cpl(struct device *device, struct decoded_instruction *instruction)
 {
-	device->cpu.status.halted = true;
+	struct cpu *cpu;
+
+	cpu = &device->cpu;
+
+	flags_sync(cpu);
+
+	cpu->registers.a = ~cpu->registers.a;
+	cpu->registers.flags.subtraction = 1;
+	cpu->registers.flags.half_carry = 1;
 
 	return 0;
 }
 
 static
-int interpreter_execute_instruction_inc(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_daa(struct device *device, struct decoded_instruction *instruction)
 {
-	int ret;
-	uint8_t src8;
-	uint16_t src16;
+	uint8_t a, correction;
 	struct cpu *cpu;
-	struct instruction_info *info;
 
 	cpu = &device->cpu;
-	info = instruction->info;
 
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.a.operand, &src8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_read16(cpu, info->operands.a.operand, &src16);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
+	flags_sync(cpu);
 
-	switch (info->operands.a.type) {
-		case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		src8 += 1;
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		src16 += 1;
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
+	a = cpu->registers.a;
+	correction = 0;
 
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_write8(cpu, info->operands.a.operand, src8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_write16(cpu, info->operands.a.operand, src16);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
+	/* Undoes the binary ADD or SUB before it into two BCD digits */
+	if (cpu->registers.flags.half_carry || (!cpu->registers.flags.subtraction && (a & 0x0f) > 0x09))
+		correction |= 0x06;
+
+	if (cpu->registers.flags.carry || (!cpu->registers.flags.subtraction && a > 0x99)) {
+		correction |= 0x60;
+		cpu->registers.flags.carry = 1;
 	}
-	OK_OR_WARN(ret == 0);
 
-	return ret;
+	a = cpu->registers.flags.subtraction ? a - correction : a + correction;
+
+	cpu->registers.a = a;
+	cpu->registers.flags.zero = a == 0;
+	cpu->registers.flags.half_carry = 0;
+
+	return 0;
 }
 
 static
-int interpreter_execute_instruction_jp(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_dec(struct device *device, struct decoded_instruction *instruction)
 {
-	int ret = 0;
-	bool condition_met;
-	struct cpu *cpu;
-	struct instruction_info *info;
+	return interpreter_execute_inc_dec(device, instruction, -1);
+}
 
-	cpu = &device->cpu;
-	info = instruction->info;
+static
+int interpreter_execute_instruction_di(struct device *device, struct decoded_instruction *instruction)
+{
+	device->cpu.status.ime = false;
 
-	switch (info->operands.a.operand) {
-	case INSTRUCTION_OPERAND_COND_NZ:
-		condition_met = cpu->registers.flags.zero == 0;
-		break;
-	case INSTRUCTION_OPERAND_COND_Z:
-		condition_met = cpu->registers.flags.zero == 1;
-		break;
-	case INSTRUCTION_OPERAND_TYPE_U16:
-		ret = -EINVAL;
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
+	return 0;
+}
 
-	if (condition_met) {
-		cpu->registers.pc += instruction->b.i8;
-	}
+static
+int interpreter_execute_instruction_ei(struct device *device, struct decoded_instruction *instruction)
+{
+	/* Hardware enables one instruction late, which only matters once interrupts are dispatched */
+	device->cpu.status.ime = true;
 
 	return 0;
 }
 
 static
-int interpreter_execute_instruction_jr(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_halt(struct device *device, struct decoded_instruction *instruction)
 {
-	int ret = 0;
-	bool condition_met, is_condition;
+	device->cpu.status.halted = true;
+
+	return 0;
+}
+
+static
+int interpreter_execute_instruction_inc(struct device *device, struct decoded_instruction *instruction)
+{
+	return interpreter_execute_inc_dec(device, instruction, 1);
+}
+
+static
+int interpreter_execute_instruction_jp(struct device *device, struct decoded_instruction *instruction)
+{
+	int ret;
+	uint16_t address;
+	bool condition_met;
 	struct cpu *cpu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
-	is_condition = false;
 	cpu = &device->cpu;
 	info = instruction->info;
+	condition_met = true;
 
-	switch (info->operands.a.operand) {
-	case INSTRUCTION_OPERAND_COND_NZ:
-		is_condition = true;
-		condition_met = cpu->registers.flags.zero == 0;
+	switch (info->operands.a.type) {
+	case INSTRUCTION_OPERAND_TYPE_CONDITION:
+		ret = interpreter_condition_met(cpu, info->operands.a.operand, &condition_met);
+		address = instruction->b.u16;
 		break;
-	case INSTRUCTION_OPERAND_COND_Z:
-		is_condition = true;
-		condition_met = cpu->registers.flags.zero == 1;
+	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
+		/* JP (HL) jumps to HL itself */
+		ret = cpu_register_read16(cpu, info->operands.a.operand, &address);
 		break;
-	case INSTRUCTION_OPERAND_I8:
+	case INSTRUCTION_OPERAND_TYPE_U16:
+		address = instruction->a.u16;
+		ret = 0;
 		break;
 	default:
 		ret = -EINVAL;
@@ -479,114 +713,82 @@ int interpreter_execute_instruction_jr(struct device *device, struct decoded_ins
 	}
 	OK_OR_RETURN(ret == 0, ret);
 
-	if (is_condition && condition_met) {
-		cpu->registers.pc += instruction->b.i8;
-	} else if (!is_condition) {
-		cpu->registers.pc += instruction->a.i8;
-	}
+	if (condition_met)
+		cpu->registers.pc = address;
+	else
+		instruction->cycles = info->timing.c1;
 
 	return 0;
 }
 
 static
-int interpreter_execute_instruction_ld(struct device *device, struct decoded_instruction *instruction)
+int interpreter_execute_instruction_jr(struct device *device, struct decoded_instruction *instruction)
 {
 	int ret;
-	uint8_t src8, addr8;
-	uint16_t src16, addr16;
+	int8_t offset;
+	bool condition_met;
 	struct cpu *cpu;
-	struct mmu *mmu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
-	mmu = &device->mmu;
 	info = instruction->info;
+	condition_met = true;
 
-	switch (info->operands.b.modifier) {
-	case INSTRUCTION_OPERAND_MODIFIER_MEM_READ_8:
-		ret = 0;
-		break;
-	case INSTRUCTION_OPERAND_MODIFIER_MEM_READ_16:
-		ret = 0;
-		break;
-	case INSTRUCTION_OPERAND_MODIFIER_NONE:
-		switch (info->operands.b.type) {
-		case INSTRUCTION_OPERAND_TYPE_U8:
-			src8 = instruction->b.u8;
-			ret = 0;
-			break;
-		case INSTRUCTION_OPERAND_TYPE_U16:
-			src16 = instruction->b.u16;
-			ret = 0;
-			break;
-		case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-			ret = cpu_register_read8(cpu, info->operands.b.operand, &src8);
-			break;
-		case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-			ret = cpu_register_read16(cpu, info->operands.b.operand, &src16);
-			break;
-		default:
-			ret = -EINVAL;
-			break;
-		}
-		break;
-	default:
-		ret = -EINVAL;
-		break;
+	if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_CONDITION) {
+		ret = interpreter_condition_met(cpu, info->operands.a.operand, &condition_met);
+		OK_OR_RETURN(ret == 0, ret);
+
+		offset = instruction->b.i8;
+	} else {
+		offset = instruction->a.i8;
 	}
-	OK_OR_RETURN(ret == 0, ret);
 
-	switch (info->operands.a.modifier) {
-	case INSTRUCTION_OPERAND_MODIFIER_MEM_WRITE_8:
-		{
-			switch (info->operands.a.type) {
-			case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-				ret = cpu_register_read8(cpu, info->operands.a.operand, &addr8);
-				break;
-			default:
-				ret = -EINVAL;
-				break;
-			}
-			OK_OR_RETURN(ret == 0, ret);
+	if (condition_met)
+		cpu->registers.pc += offset;
+	else
+		instruction->cycles = info->timing.c1;
+
+	return 0;
+}
 
-			ret = mmu_write8(mmu, addr8 + 0xff00, src8);
-		}
-		break;
-	case INSTRUCTION_OPERAND_MODIFIER_MEM_WRITE_16:
-		{
-			switch (info->operands.a.type) {
-			case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-				ret = cpu_register_read16(cpu, info->operands.a.operand, &addr16);
-				break;
-			case INSTRUCTION_OPERAND_TYPE_U16:
-				addr16 = instruction->a.u16;
-				break;
-			default:
-				ret = -EINVAL;
-				break;
-			}
-			OK_OR_RETURN(ret == 0, ret);
+static
+int interpreter_execute_instruction_ld(struct device *device, struct decoded_instruction *instruction)
+{
+	int ret;
+	uint8_t v8;
+	uint16_t v16;
+	struct cpu *cpu;
+	const struct instruction_info *info;
 
-			ret = mmu_write16(mmu, addr16, src16);
-		}
-		break;
-	case INSTRUCTION_OPERAND_MODIFIER_NONE:
-		switch (info->operands.a.type) {
-		case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-			ret = cpu_register_write8(cpu, info->operands.a.operand, src8);
-			break;
-		case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-			ret = cpu_register_write16(cpu, info->operands.a.operand, src16);
-			break;
-		default:
-			ret = -EINVAL;
-			break;
+	cpu = &device->cpu;
+	info = instruction->info;
+
+	/* LD rr, d16 and LD SP, HL */
+	if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_REGISTER16 &&
+	    info->operands.a.modifier == INSTRUCTION_OPERAND_MODIFIER_NONE) {
+		if (info->operands.b.type == INSTRUCTION_OPERAND_TYPE_U16) {
+			v16 = instruction->b.u16;
+		} else {
+			ret = cpu_register_read16(cpu, info->operands.b.operand, &v16);
+			OK_OR_RETURN(ret == 0, ret);
 		}
-		break;
-	default:
-		ret = -EINVAL;
-		break;
+
+		return cpu_register_write16(cpu, info->operands.a.operand, v16);
+	}
+
+	/* LD (a16), SP */
+	if (info->operands.b.type == INSTRUCTION_OPERAND_TYPE_REGISTER16 &&
+	    info->operands.b.modifier == INSTRUCTION_OPERAND_MODIFIER_NONE) {
+		ret = cpu_register_read16(cpu, info->operands.b.operand, &v16);
+		OK_OR_RETURN(ret == 0, ret);
+
+		return interpreter_write16(device, instruction, instruction->a.u16, v16);
 	}
+
+	ret = interpreter_read_operand8(device, instruction, true, &v8);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = interpreter_write_operand8(device, instruction, false, v8);
 	OK_OR_WARN(ret == 0);
 
 	return ret;
@@ -599,11 +801,9 @@ int interpreter_execute_instruction_ldd(struct device *device, struct decoded_in
 	uint8_t src8;
 	uint16_t addr16;
 	struct cpu *cpu;
-	struct mmu *mmu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
-	mmu = &device->mmu;
 	info = instruction->info;
 
 	switch (info->operands.b.modifier) {
@@ -612,7 +812,7 @@ int interpreter_execute_instruction_ldd(struct device *device, struct decoded_in
 			ret = cpu_register_read16(cpu, info->operands.b.operand, &addr16);
 			OK_OR_RETURN(ret == 0, ret);
 
-			ret = mmu_read8(mmu, addr16, &src8);
+			ret = interpreter_read8(device, instruction, addr16, &src8);
 		}
 		break;
 	case INSTRUCTION_OPERAND_MODIFIER_NONE:
@@ -637,11 +837,11 @@ int interpreter_execute_instruction_ldd(struct device *device, struct decoded_in
 			ret = cpu_register_read16(cpu, info->operands.a.operand, &addr16);
 			OK_OR_RETURN(ret == 0, ret);
 
-			ret = mmu_write8(mmu, addr16, src8);
+			ret = interpreter_write8(device, instruction, addr16, src8);
 		}
 		break;
 	case INSTRUCTION_OPERAND_MODIFIER_NONE:
-		switch (info->operands.b.type) {
+		switch (info->operands.a.type) {
 		case INSTRUCTION_OPERAND_TYPE_REGISTER8:
 			ret = cpu_register_write8(cpu, info->operands.a.operand, src8);
 			break;
@@ -668,17 +868,15 @@ int interpreter_execute_instruction_ldh(struct device *device, struct decoded_in
 	int ret;
 	uint8_t n8, value8;
 	struct cpu *cpu;
-	struct mmu *mmu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
-	mmu = &device->mmu;
 	info = instruction->info;
 
 	switch (info->operands.b.type) {
 	case INSTRUCTION_OPERAND_TYPE_U8 :
 		n8 = instruction->b.u8;
-		ret = mmu_read8(mmu, n8 + 0xff00, &value8);
+		ret = interpreter_read8(device, instruction, n8 + 0xff00, &value8);
 		break;
 	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
 		ret = cpu_register_read8(cpu, info->operands.b.operand, &value8);
@@ -692,7 +890,7 @@ int interpreter_execute_instruction_ldh(struct device *device, struct decoded_in
 	switch (info->operands.a.type) {
 	case INSTRUCTION_OPERAND_TYPE_U8 :
 		n8 = instruction->a.u8;
-		ret = mmu_write8(mmu, n8 + 0xff00, value8);
+		ret = interpreter_write8(device, instruction, n8 + 0xff00, value8);
 		break;
 	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
 		ret = cpu_register_write8(cpu, info->operands.a.operand, value8);
@@ -709,7 +907,13 @@ int interpreter_execute_instruction_ldh(struct device *device, struct decoded_in
 static
 int interpreter_execute_instruction_ldhl(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'ldhl'");
+	struct cpu *cpu;
+
+	cpu = &device->cpu;
+
+	flags_set(cpu, LAZY_FLAGS_OP_ADD_SP, cpu->registers.sp, (uint8_t)instruction->b.i8, 0);
+	cpu->registers.hl = cpu->registers.sp + instruction->b.i8;
+
 	return 0;
 }
 
@@ -723,23 +927,23 @@ int interpreter_execute_instruction_ldi(struct device *device, struct decoded_in
 	int ret;
 	uint8_t v8;
 	struct cpu *cpu;
-	struct mmu *mmu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
-	mmu = &device->mmu;
 	info = instruction->info;
 
 	if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_REGISTER8) {
-		ret = mmu_read8(mmu, cpu->registers.hl, &v8);
+		ret = interpreter_read8(device, instruction, cpu->registers.hl, &v8);
 		OK_OR_RETURN(ret == 0, ret);
 
 		cpu->registers.a = v8;
 	} else {
-		ret = mmu_write8(mmu, cpu->registers.hl, cpu->registers.a);
+		ret = interpreter_write8(device, instruction, cpu->registers.hl, cpu->registers.a);
 		OK_OR_RETURN(ret == 0, ret);
 	}
 
+	cpu->registers.hl += 1;
+
 	return 0;
 }
 
@@ -753,8 +957,7 @@ int interpreter_execute_instruction_nop(struct device *device, struct decoded_in
 static
 int interpreter_execute_instruction_or(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'and'");
-	return 0;
+	return interpreter_execute_alu8(device, instruction);
 }
 
 static
@@ -763,12 +966,12 @@ int interpreter_execute_instruction_pop(struct device *device, struct decoded_in
 	int ret;
 	uint16_t v16;
 	struct cpu *cpu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
 	info = instruction->info;
 
-	ret = utils_pop16(device, &v16);
+	ret = utils_pop16(device, instruction, &v16);
 	OK_OR_RETURN(ret == 0, ret);
 
 	switch (info->operands.a.type) {
@@ -787,8 +990,8 @@ int interpreter_execute_instruction_pop(struct device *device, struct decoded_in
 static
 int interpreter_execute_instruction_prefix(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'prefix'");
-	return 0;
+	/* fetch() decodes 0xcb together with the opcode after it */
+	return -EINVAL;
 }
 
 static
@@ -797,7 +1000,7 @@ int interpreter_execute_instruction_push(struct device *device, struct decoded_i
 	int ret;
 	uint16_t r16;
 	struct cpu *cpu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
 	info = instruction->info;
@@ -812,7 +1015,7 @@ int interpreter_execute_instruction_push(struct device *device, struct decoded_i
 	}
 	OK_OR_RETURN(ret == 0, ret);
 
-	ret = utils_push16(device, r16);
+	ret = utils_push16(device, instruction, r16);
 	OK_OR_WARN(ret == 0);
 
 	return ret;
@@ -822,12 +1025,25 @@ static
 int interpreter_execute_instruction_ret(struct device *device, struct decoded_instruction *instruction)
 {
 	int ret;
+	bool condition_met;
 	struct cpu *cpu;
 	uint16_t pc;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
+	info = instruction->info;
 
-	ret = utils_pop16(device, &pc);
+	if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_CONDITION) {
+		ret = interpreter_condition_met(cpu, info->operands.a.operand, &condition_met);
+		OK_OR_RETURN(ret == 0, ret);
+
+		if (!condition_met) {
+			instruction->cycles = info->timing.c1;
+			return 0;
+		}
+	}
+
+	ret = utils_pop16(device, instruction, &pc);
 	OK_OR_RETURN(ret == 0, ret);
 
 	cpu->registers.pc = pc;
@@ -838,217 +1054,96 @@ int interpreter_execute_instruction_ret(struct device *device, struct decoded_in
 static
 int interpreter_execute_instruction_reti(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'reti'");
+	int ret;
+
+	ret = interpreter_execute_instruction_ret(device, instruction);
+	OK_OR_RETURN(ret == 0, ret);
+
+	device->cpu.status.ime = true;
+
 	return 0;
 }
 
 static
 int interpreter_execute_instruction_rst(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'rst'");
+	int ret;
+	struct cpu *cpu;
+	const struct instruction_info *info;
+
+	cpu = &device->cpu;
+	info = instruction->info;
+
+	ret = utils_push16(device, instruction, cpu->registers.pc);
+	OK_OR_RETURN(ret == 0, ret);
+
+	cpu->registers.pc = (info->operands.a.operand - INSTRUCTION_OPERAND_VEC_00H) * 8;
+
 	return 0;
 }
 
 static
 int interpreter_execute_instruction_sbc(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'sbc'");
-	return 0;
+	return interpreter_execute_alu8(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_scf(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'scf'");
+	struct cpu *cpu;
+
+	cpu = &device->cpu;
+
+	flags_sync(cpu);
+
+	cpu->registers.flags.subtraction = 0;
+	cpu->registers.flags.half_carry = 0;
+	cpu->registers.flags.carry = 1;
+
 	return 0;
 }
 
 static
 int interpreter_execute_instruction_stop(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'stop'");
+	/* Sleeps like HALT until joypad_update() sees a press */
+	device->cpu.status.halted = true;
+	device->cpu.status.stopped = true;
+
 	return 0;
 }
 
 static
 int interpreter_execute_instruction_sub(struct device *device, struct decoded_instruction *instruction)
 {
-	int ret;
-	uint8_t src8, dst8;
-	uint16_t src16, dst16;
-	struct cpu *cpu;
-	struct instruction_info *info;
-
-	cpu = &device->cpu;
-	info = instruction->info;
-
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.a.operand, &dst8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_read16(cpu, info->operands.a.operand, &dst16);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
-
-	switch (info->operands.b.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.b.operand, &src8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_read16(cpu, info->operands.b.operand, &src16);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_NONE:
-		ret = cpu_register_read8(cpu, INSTRUCTION_OPERAND_A, &src8);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
-
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		dst8 -= src8;
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		dst16 -= src16;
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
-
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_write8(cpu, info->operands.a.operand, dst8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_write16(cpu, info->operands.a.operand, dst16);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_WARN(ret == 0);
-
-	return ret;
+	return interpreter_execute_alu8(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_xor(struct device *device, struct decoded_instruction *instruction)
 {
-	int ret;
-	uint8_t src8, dst8;
-	uint16_t src16, dst16;
-	struct cpu *cpu;
-	struct instruction_info *info;
-
-	cpu = &device->cpu;
-	info = instruction->info;
-
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.a.operand, &dst8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_read16(cpu, info->operands.a.operand, &dst16);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
-
-	switch (info->operands.b.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.b.operand, &src8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_read16(cpu, info->operands.b.operand, &src16);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_NONE:
-		ret = cpu_register_read8(cpu, INSTRUCTION_OPERAND_A, &src8);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
-
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		dst8 ^= src8;
-		cpu->registers.flags.half_carry = 0;
-		cpu->registers.flags.zero = (dst8 == 0);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		dst16 ^= src16;
-		cpu->registers.flags.half_carry = 0;
-		cpu->registers.flags.zero = (dst16 == 0);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
-
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_write8(cpu, info->operands.a.operand, dst8);
-		break;
-	case INSTRUCTION_OPERAND_TYPE_REGISTER16:
-		ret = cpu_register_write16(cpu, info->operands.a.operand, dst16);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_WARN(ret == 0);
-
-	return ret;
+	return interpreter_execute_alu8(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_bit(struct device *device, struct decoded_instruction *instruction)
 {
 	int ret;
-	uint8_t bit;
-	uint8_t reg;
+	uint8_t bit, value;
 	struct cpu *cpu;
-	struct instruction_info *info;
+	const struct instruction_info *info;
 
 	cpu = &device->cpu;
 	info = instruction->info;
 
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_U3:
-		ret = bit_u3_to_value(info->operands.a.operand, &bit);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
+	ret = bit_u3_to_value(info->operands.a.operand, &bit);
 	OK_OR_RETURN(ret == 0, ret);
 
-	switch (info->operands.b.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.b.operand, &reg);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
+	ret = interpreter_read_operand8(device, instruction, true, &value);
 	OK_OR_RETURN(ret == 0, ret);
 
-	cpu->registers.flags.half_carry = 1;
-	cpu->registers.flags.subtraction = 0;
-	cpu->registers.flags.zero = (reg & (1 << bit)) == 0;
+	flags_set(cpu, LAZY_FLAGS_OP_BIT, value & (1 << bit), 0, 0);
 
 	return 0;
 }
@@ -1056,140 +1151,85 @@ int interpreter_execute_instruction_bit(struct device *device, struct decoded_in
 static
 int interpreter_execute_instruction_res(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'res'");
-	return 0;
+	return interpreter_execute_res_set(device, instruction, false);
 }
 
 static
 int interpreter_execute_instruction_rl(struct device *device, struct decoded_instruction *instruction)
 {
-	int ret;
-	uint8_t r8;
-	struct cpu *cpu;
-	struct instruction_info *info;
-
-	cpu = &device->cpu;
-	info = instruction->info;
-
-	switch (info->operands.a.type) {
-	case INSTRUCTION_OPERAND_TYPE_REGISTER8:
-		ret = cpu_register_read8(cpu, info->operands.a.operand, &r8);
-		break;
-	default:
-		ret = -EINVAL;
-		break;
-	}
-	OK_OR_RETURN(ret == 0, ret);
-
-	ret = cpu_register_write8(cpu, info->operands.a.operand, r8 << 1);
-	OK_OR_RETURN(ret == 0, ret);
-
-	cpu->registers.flags.zero = (r8 << 1) == 0;
-	cpu->registers.flags.carry = (r8 >> 7) & 1;
-	cpu->registers.flags.half_carry = 0;
-	cpu->registers.flags.subtraction = 0;
-
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_rla(struct device *device, struct decoded_instruction *instruction)
 {
-	uint8_t r8;
-	bool has_carry;
-	struct cpu *cpu;
-
-	cpu = &device->cpu;
-
-	r8 = cpu->registers.a;
-	has_carry = r8 & 0x80;
-	r8 = (r8 << 7) | cpu->registers.flags.carry;
-
-	cpu->registers.a = r8;
-
-	cpu->registers.flags.zero = r8 == 0;
-	cpu->registers.flags.carry = has_carry;
-	cpu->registers.flags.half_carry = 0;
-	cpu->registers.flags.subtraction = 0;
-
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_rlc(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'rlc'");
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_rlca(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'rlca'");
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_rr(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'rr'");
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_rra(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'rra'");
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_rrc(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'rrc'");
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_rrca(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'rrca'");
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_set(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'set'");
-	return 0;
+	return interpreter_execute_res_set(device, instruction, true);
 }
 
 static
 int interpreter_execute_instruction_sla(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'sla'");
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_sra(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'sra'");
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_srl(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'srl'");
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 static
 int interpreter_execute_instruction_swap(struct device *device, struct decoded_instruction *instruction)
 {
-	TRAP_GDB("Not implemented: instruction 'swap'");
-	return 0;
+	return interpreter_execute_shift(device, instruction);
 }
 
 LIBEXPORT
@@ -1199,6 +1239,14 @@ int interpreter_execute_instruction(struct device *device, struct decoded_instru
 
 	assert(instruction->info != NULL && "Instruction information should not be NULL");
 
+	/* Conditional branches that are not taken lower this to timing.c1 */
+	instruction->cycles = instruction->info->timing.c0;
+	instruction->elapsed = 0;
+
+	/* Fetching each byte of the instruction takes an M-cycle */
+	ret = interpreter_tick(device, instruction, instruction->info->num_bytes * 4);
+	OK_OR_RETURN(ret == 0, ret);
+
 	switch (instruction->info->instruction_class) {
 	case INSTRUCTION_CLASS_ADC:
 		ret = interpreter_execute_instruction_adc(device, instruction);
@@ -0,0 +1,250 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pgb/cpu/decoder.h>
+#include <pgb/cpu/instruction_info.h>
+#include <pgb/cpu/profile.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/utils.h>
+
+#define PROFILE_FORMAT_VERSION 1
+
+enum profile_kind {
+	PROFILE_KIND_OPCODE,
+	PROFILE_KIND_PREFIX_CB_OPCODE,
+	PROFILE_KIND_ADDRESS
+};
+
+struct profile_entry {
+	enum profile_kind kind;
+	unsigned key;
+	const struct profile_counter *counter;
+};
+
+static
+const char *profile_entry_name(struct profile_entry *entry)
+{
+	int ret;
+	const struct instruction_text *text;
+
+	switch (entry->kind) {
+	case PROFILE_KIND_OPCODE:
+		ret = cpu_decoder_get_instruction_text(entry->key, &text);
+		break;
+	case PROFILE_KIND_PREFIX_CB_OPCODE:
+		ret = cpu_decoder_get_prefix_cb_instruction_text(entry->key, &text);
+		break;
+	default:
+		return "";
+	}
+
+	return ret == 0 ? text->assembly : "?";
+}
+
+/* Hottest first, ties broken by key so reports are stable */
+static
+int profile_entry_compare(const void *a, const void *b)
+{
+	const struct profile_entry *lhs = a, *rhs = b;
+
+	if (lhs->counter->cycles != rhs->counter->cycles)
+		return lhs->counter->cycles < rhs->counter->cycles ? 1 : -1;
+
+	if (lhs->kind != rhs->kind)
+		return lhs->kind < rhs->kind ? -1 : 1;
+
+	return lhs->key < rhs->key ? -1 : lhs->key > rhs->key;
+}
+
+/* Collects every counter of kind that ran at least once, hottest first */
+static
+size_t profile_collect(struct profile *profile, enum profile_kind kind, struct profile_entry *entries)
+{
+	unsigned i, count;
+	size_t length = 0;
+	const struct profile_counter *counters;
+
+	switch (kind) {
+	case PROFILE_KIND_OPCODE:
+		counters = profile->opcodes;
+		count = ARRAY_SIZE(profile->opcodes);
+		break;
+	case PROFILE_KIND_PREFIX_CB_OPCODE:
+		counters = profile->prefix_cb_opcodes;
+		count = ARRAY_SIZE(profile->prefix_cb_opcodes);
+		break;
+	default:
+		counters = profile->addresses;
+		count = ARRAY_SIZE(profile->addresses);
+		break;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (counters[i].executions == 0)
+			continue;
+
+		entries[length].kind = kind;
+		entries[length].key = i;
+		entries[length].counter = &counters[i];
+		length++;
+	}
+
+	qsort(entries, length, sizeof(*entries), profile_entry_compare);
+
+	return length;
+}
+
+static
+void profile_report_section(FILE *stream, const char *title, struct profile_entry *entries, size_t length,
+			    size_t top, uint64_t total_cycles)
+{
+	size_t i;
+	double share;
+
+	fprintf(stream, "%s\n", title);
+	fprintf(stream, "  %14s %7s %14s  %s\n", "cycles", "share", "executions", "where");
+
+	for (i = 0; i < MIN(length, top); i++) {
+		share = total_cycles ? 100.0 * entries[i].counter->cycles / total_cycles : 0;
+
+		fprintf(stream, "  %14llu %6.2f%% %14llu  ",
+			(unsigned long long)entries[i].counter->cycles, share,
+			(unsigned long long)entries[i].counter->executions);
+
+		switch (entries[i].kind) {
+		case PROFILE_KIND_OPCODE:
+			fprintf(stream, "%02x    %s\n", entries[i].key, profile_entry_name(&entries[i]));
+			break;
+		case PROFILE_KIND_PREFIX_CB_OPCODE:
+			fprintf(stream, "cb %02x %s\n", entries[i].key, profile_entry_name(&entries[i]));
+			break;
+		default:
+			fprintf(stream, "00:%04x\n", entries[i].key);
+			break;
+		}
+	}
+
+	fprintf(stream, "\n");
+}
+
+/*
+ * Starts counting executions of device from zero. Returns -ENOTSUP unless
+ * the library was built with PROFILE=1.
+ */
+LIBEXPORT
+int profile_enable(struct device *device)
+{
+	if (!PGB_PROFILE)
+		return -ENOTSUP;
+
+	if (device->cpu.profile != NULL)
+		return profile_reset(device);
+
+	device->cpu.profile = calloc(1, sizeof(*device->cpu.profile));
+	OK_OR_RETURN(device->cpu.profile != NULL, -ENOMEM);
+
+	return 0;
+}
+
+LIBEXPORT
+int profile_disable(struct device *device)
+{
+	free(device->cpu.profile);
+	device->cpu.profile = NULL;
+
+	return 0;
+}
+
+LIBEXPORT
+int profile_reset(struct device *device)
+{
+	OK_OR_RETURN(device->cpu.profile != NULL, -EINVAL);
+
+	memset(device->cpu.profile, 0, sizeof(*device->cpu.profile));
+
+	return 0;
+}
+
+/* Writes the top hottest opcodes and addresses of each kind, by cycles spent */
+LIBEXPORT
+int profile_report(struct device *device, FILE *stream, size_t top)
+{
+	unsigned i;
+	size_t opcodes, prefix_cb_opcodes, addresses;
+	uint64_t total_cycles = 0, total_executions = 0;
+	struct profile *profile = device->cpu.profile;
+	struct profile_entry *entries;
+
+	OK_OR_RETURN(profile != NULL, -EINVAL);
+
+	entries = malloc(PROFILE_NUM_ADDRESSES * sizeof(*entries));
+	OK_OR_RETURN(entries != NULL, -ENOMEM);
+
+	for (i = 0; i < ARRAY_SIZE(profile->addresses); i++) {
+		total_cycles += profile->addresses[i].cycles;
+		total_executions += profile->addresses[i].executions;
+	}
+
+	fprintf(stream, "%llu instructions, %llu cycles\n\n",
+		(unsigned long long)total_executions, (unsigned long long)total_cycles);
+
+	opcodes = profile_collect(profile, PROFILE_KIND_OPCODE, entries);
+	profile_report_section(stream, "Opcodes", entries, opcodes, top, total_cycles);
+
+	prefix_cb_opcodes = profile_collect(profile, PROFILE_KIND_PREFIX_CB_OPCODE, entries);
+	profile_report_section(stream, "CB prefixed opcodes", entries, prefix_cb_opcodes, top, total_cycles);
+
+	addresses = profile_collect(profile, PROFILE_KIND_ADDRESS, entries);
+	profile_report_section(stream, "Addresses (bank:pc)", entries, addresses, top, total_cycles);
+
+	free(entries);
+
+	return ferror(stream) ? -EIO : 0;
+}
+
+/*
+ * Writes every non-zero counter as CSV, hottest first within each kind:
+ *
+ *   kind,key,executions,cycles,instruction
+ *
+ * where kind is opcode, cb_opcode or pc, and the key of a pc is bank:address.
+ */
+LIBEXPORT
+int profile_dump(struct device *device, FILE *stream)
+{
+	size_t i, length;
+	enum profile_kind kind;
+	struct profile *profile = device->cpu.profile;
+	struct profile_entry *entries;
+	static const char *const kind_names[] = {
+		[PROFILE_KIND_OPCODE] = "opcode",
+		[PROFILE_KIND_PREFIX_CB_OPCODE] = "cb_opcode",
+		[PROFILE_KIND_ADDRESS] = "pc"
+	};
+
+	OK_OR_RETURN(profile != NULL, -EINVAL);
+
+	entries = malloc(PROFILE_NUM_ADDRESSES * sizeof(*entries));
+	OK_OR_RETURN(entries != NULL, -ENOMEM);
+
+	fprintf(stream, "# pgb profile v%d\n", PROFILE_FORMAT_VERSION);
+	fprintf(stream, "kind,key,executions,cycles,instruction\n");
+
+	for (kind = PROFILE_KIND_OPCODE; kind <= PROFILE_KIND_ADDRESS; kind++) {
+		length = profile_collect(profile, kind, entries);
+
+		for (i = 0; i < length; i++) {
+			fprintf(stream, kind == PROFILE_KIND_ADDRESS ? "%s,00:%04x," : "%s,0x%02x,", kind_names[kind], entries[i].key);
+			fprintf(stream, "%llu,%llu,\"%s\"\n",
+				(unsigned long long)entries[i].counter->executions,
+				(unsigned long long)entries[i].counter->cycles,
+				profile_entry_name(&entries[i]));
+		}
+	}
+
+	free(entries);
+
+	return ferror(stream) ? -EIO : 0;
+}
@@ -18,3 +18,17 @@ int registers_init(struct registers *registers)
 
 	return 0;
 }
+
+/* What the DMG boot ROM leaves behind when it hands over to the cartridge */
+LIBEXPORT
+int registers_init_post_boot(struct registers *registers)
+{
+	registers->af = 0x01b0;
+	registers->bc = 0x0013;
+	registers->de = 0x00d8;
+	registers->hl = 0x014d;
+	registers->sp = 0xfffe;
+	registers->pc = 0x0100;
+
+	return 0;
+}
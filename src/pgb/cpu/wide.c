@@ -0,0 +1,515 @@
+#include <errno.h>
+#include <string.h>
+
+#include <pgb/cpu/cpu.h>
+#include <pgb/cpu/flags.h>
+#include <pgb/cpu/instruction_info.h>
+#include <pgb/cpu/private/flags.h>
+#include <pgb/cpu/private/profile.h>
+#include <pgb/cpu/wide.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/mmu/private/mmu.h>
+#include <pgb/scheduler/scheduler.h>
+#include <pgb/utils.h>
+
+/* Longest instruction, prefix included */
+#define WIDE_MAX_INSTRUCTION_BYTES 3
+
+/* Instructions a diverged lane runs alone before lanes are compared again */
+#define WIDE_SCALAR_BURST 64
+
+static
+int wide_register_index(enum instruction_operand operand)
+{
+	switch (operand) {
+	case INSTRUCTION_OPERAND_A:
+		return WIDE_REGISTER_A;
+	case INSTRUCTION_OPERAND_B:
+		return WIDE_REGISTER_B;
+	case INSTRUCTION_OPERAND_C:
+		return WIDE_REGISTER_C;
+	case INSTRUCTION_OPERAND_D:
+		return WIDE_REGISTER_D;
+	case INSTRUCTION_OPERAND_E:
+		return WIDE_REGISTER_E;
+	case INSTRUCTION_OPERAND_H:
+		return WIDE_REGISTER_H;
+	case INSTRUCTION_OPERAND_L:
+		return WIDE_REGISTER_L;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Takes value in the lanes set in mask and keeps old everywhere else */
+static inline
+wide_vec wide_select(wide_vec mask, wide_vec value, wide_vec old)
+{
+	return (value & mask) | (old & ~mask);
+}
+
+static
+void wide_gather(struct wide *wide)
+{
+	unsigned i;
+	struct registers *registers;
+
+	if (wide->gathered)
+		return;
+
+	for (i = 0; i < wide->count; i++) {
+		registers = &wide->lanes[i]->cpu.registers;
+		flags_sync(&wide->lanes[i]->cpu);
+
+		wide->registers[WIDE_REGISTER_A][i] = registers->a;
+		wide->registers[WIDE_REGISTER_F][i] = registers->f;
+		wide->registers[WIDE_REGISTER_B][i] = registers->b;
+		wide->registers[WIDE_REGISTER_C][i] = registers->c;
+		wide->registers[WIDE_REGISTER_D][i] = registers->d;
+		wide->registers[WIDE_REGISTER_E][i] = registers->e;
+		wide->registers[WIDE_REGISTER_H][i] = registers->h;
+		wide->registers[WIDE_REGISTER_L][i] = registers->l;
+	}
+
+	wide->gathered = true;
+}
+
+static
+void wide_scatter(struct wide *wide)
+{
+	unsigned i;
+	struct registers *registers;
+
+	if (!wide->gathered)
+		return;
+
+	for (i = 0; i < wide->count; i++) {
+		registers = &wide->lanes[i]->cpu.registers;
+
+		registers->a = wide->registers[WIDE_REGISTER_A][i];
+		registers->f = wide->registers[WIDE_REGISTER_F][i];
+		registers->b = wide->registers[WIDE_REGISTER_B][i];
+		registers->c = wide->registers[WIDE_REGISTER_C][i];
+		registers->d = wide->registers[WIDE_REGISTER_D][i];
+		registers->e = wide->registers[WIDE_REGISTER_E][i];
+		registers->h = wide->registers[WIDE_REGISTER_H][i];
+		registers->l = wide->registers[WIDE_REGISTER_L][i];
+	}
+
+	wide->gathered = false;
+}
+
+static
+uint8_t wide_lane_flags(struct wide *wide, unsigned lane)
+{
+	if (wide->gathered)
+		return wide->registers[WIDE_REGISTER_F][lane];
+
+	flags_sync(&wide->lanes[lane]->cpu);
+
+	return wide->lanes[lane]->cpu.registers.f;
+}
+
+/* True if every running lane is about to execute the same bytes as leader */
+static
+bool wide_converged(struct wide *wide, unsigned leader, uint32_t running)
+{
+	unsigned i, j;
+	uint16_t pc, address;
+	struct mmu *mmu, *leader_mmu;
+
+	pc = wide->lanes[leader]->cpu.registers.pc;
+	leader_mmu = &wide->lanes[leader]->mmu;
+
+	for (i = leader + 1; i < wide->count; i++) {
+		if (!(running & (1 << i)))
+			continue;
+
+		if (wide->lanes[i]->cpu.registers.pc != pc)
+			return false;
+
+		/* Only the leader fetches, and an OAM DMA changes what a lane would fetch */
+		mmu = &wide->lanes[i]->mmu;
+		if (mmu->oam_dma.active != leader_mmu->oam_dma.active)
+			return false;
+
+		/* Lanes cloned from one another usually still share their ROM pages */
+		for (j = 0; j < WIDE_MAX_INSTRUCTION_BYTES; j++) {
+			address = pc + j;
+			if (mmu->pages[address >> MMU_PAGE_SHIFT] != leader_mmu->pages[address >> MMU_PAGE_SHIFT] &&
+			    mmu_peek(mmu, address) != mmu_peek(leader_mmu, address))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Relative jumps resolve per lane, lanes that disagree on the condition
+ * simply diverge and are picked up by the scalar path. taken is set to the
+ * lanes that jumped, as they take longer.
+ */
+static
+bool wide_execute_jr(struct wide *wide, struct decoded_instruction *instruction, uint32_t running, uint32_t *taken)
+{
+	unsigned i;
+	uint8_t zero;
+	const struct instruction_info *info = instruction->info;
+
+	switch (info->operands.a.operand) {
+	case INSTRUCTION_OPERAND_I8:
+		for (i = 0; i < wide->count; i++) {
+			if (running & (1 << i))
+				wide->lanes[i]->cpu.registers.pc += instruction->a.i8;
+		}
+		*taken = running;
+		return true;
+	case INSTRUCTION_OPERAND_COND_NZ:
+	case INSTRUCTION_OPERAND_COND_Z:
+		zero = info->operands.a.operand == INSTRUCTION_OPERAND_COND_Z ? CPU_FLAG_ZERO : 0;
+		*taken = 0;
+		for (i = 0; i < wide->count; i++) {
+			if ((running & (1 << i)) && (wide_lane_flags(wide, i) & CPU_FLAG_ZERO) == zero) {
+				wide->lanes[i]->cpu.registers.pc += instruction->b.i8;
+				*taken |= 1 << i;
+			}
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Executes instructions that only touch the 8-bit registers on every lane at
+ * once, with the same results as interpreter_execute_instruction(). Returns
+ * false, without touching anything, for anything else.
+ */
+static
+bool wide_execute_vector(struct wide *wide, struct decoded_instruction *instruction, wide_vec mask)
+{
+	int dst, src;
+	uint8_t bit;
+	wide_vec value, result, condition, flags;
+	wide_vec *registers = wide->registers;
+	const struct instruction_info *info = instruction->info;
+
+	dst = wide_register_index(info->operands.a.operand);
+	src = wide_register_index(info->operands.b.operand);
+
+	switch (info->instruction_class) {
+	case INSTRUCTION_CLASS_NOP:
+		return true;
+	case INSTRUCTION_CLASS_LD:
+		if (info->operands.a.type != INSTRUCTION_OPERAND_TYPE_REGISTER8 || dst < 0 ||
+		    info->operands.a.modifier != INSTRUCTION_OPERAND_MODIFIER_NONE ||
+		    info->operands.b.modifier != INSTRUCTION_OPERAND_MODIFIER_NONE)
+			return false;
+
+		if (info->operands.b.type == INSTRUCTION_OPERAND_TYPE_U8) {
+			wide_gather(wide);
+			value = (wide_vec){0} + instruction->b.u8;
+		} else if (info->operands.b.type == INSTRUCTION_OPERAND_TYPE_REGISTER8 && src >= 0) {
+			wide_gather(wide);
+			value = registers[src];
+		} else {
+			return false;
+		}
+
+		registers[dst] = wide_select(mask, value, registers[dst]);
+		return true;
+	case INSTRUCTION_CLASS_INC:
+	case INSTRUCTION_CLASS_DEC:
+		if (info->operands.a.type != INSTRUCTION_OPERAND_TYPE_REGISTER8 || dst < 0)
+			return false;
+
+		wide_gather(wide);
+
+		value = registers[dst];
+		flags = registers[WIDE_REGISTER_F] & (CPU_FLAG_CARRY | 0x0f);
+
+		if (info->instruction_class == INSTRUCTION_CLASS_INC) {
+			result = value + 1;
+			flags |= (wide_vec)((value & 0xf) == 0xf) & CPU_FLAG_HALF_CARRY;
+		} else {
+			result = value - 1;
+			flags |= CPU_FLAG_SUBTRACTION;
+			flags |= (wide_vec)((value & 0xf) == 0) & CPU_FLAG_HALF_CARRY;
+		}
+		flags |= (wide_vec)(result == 0) & CPU_FLAG_ZERO;
+
+		registers[dst] = wide_select(mask, result, registers[dst]);
+		registers[WIDE_REGISTER_F] = wide_select(mask, flags, registers[WIDE_REGISTER_F]);
+		return true;
+	case INSTRUCTION_CLASS_ADD:
+	case INSTRUCTION_CLASS_SUB:
+	case INSTRUCTION_CLASS_XOR:
+		if (info->operands.a.type != INSTRUCTION_OPERAND_TYPE_REGISTER8 || dst < 0)
+			return false;
+
+		/* SUB r and XOR r only name the source, A is the destination */
+		if (info->operands.b.type == INSTRUCTION_OPERAND_TYPE_NONE) {
+			src = dst;
+			dst = WIDE_REGISTER_A;
+		} else if (info->operands.b.type != INSTRUCTION_OPERAND_TYPE_REGISTER8 || src < 0)
+			return false;
+
+		wide_gather(wide);
+
+		value = registers[src];
+		flags = registers[WIDE_REGISTER_F] & 0x0f;
+
+		if (info->instruction_class == INSTRUCTION_CLASS_ADD) {
+			result = registers[dst] + value;
+			flags |= (wide_vec)((registers[dst] & 0xf) + (value & 0xf) > 0xf) & CPU_FLAG_HALF_CARRY;
+			flags |= (wide_vec)(result < value) & CPU_FLAG_CARRY;
+		} else if (info->instruction_class == INSTRUCTION_CLASS_SUB) {
+			result = registers[dst] - value;
+			flags |= CPU_FLAG_SUBTRACTION;
+			flags |= (wide_vec)((registers[dst] & 0xf) < (value & 0xf)) & CPU_FLAG_HALF_CARRY;
+			flags |= (wide_vec)(registers[dst] < value) & CPU_FLAG_CARRY;
+		} else {
+			result = registers[dst] ^ value;
+		}
+		flags |= (wide_vec)(result == 0) & CPU_FLAG_ZERO;
+
+		registers[dst] = wide_select(mask, result, registers[dst]);
+		registers[WIDE_REGISTER_F] = wide_select(mask, flags, registers[WIDE_REGISTER_F]);
+		return true;
+	case INSTRUCTION_CLASS_CP:
+		if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_U8) {
+			wide_gather(wide);
+			value = (wide_vec){0} + instruction->a.u8;
+		} else if (info->operands.a.type == INSTRUCTION_OPERAND_TYPE_REGISTER8 && dst >= 0) {
+			wide_gather(wide);
+			value = registers[dst];
+		} else {
+			return false;
+		}
+
+		flags = registers[WIDE_REGISTER_F] & ~(CPU_FLAG_ZERO | CPU_FLAG_HALF_CARRY | CPU_FLAG_CARRY);
+		flags |= CPU_FLAG_SUBTRACTION;
+		flags |= (wide_vec)(registers[WIDE_REGISTER_A] == value) & CPU_FLAG_ZERO;
+		flags |= (wide_vec)((registers[WIDE_REGISTER_A] & 0xf) < (value & 0xf)) & CPU_FLAG_HALF_CARRY;
+		flags |= (wide_vec)(registers[WIDE_REGISTER_A] < value) & CPU_FLAG_CARRY;
+
+		registers[WIDE_REGISTER_F] = wide_select(mask, flags, registers[WIDE_REGISTER_F]);
+		return true;
+	case INSTRUCTION_CLASS_BIT:
+		if (info->operands.a.type != INSTRUCTION_OPERAND_TYPE_U3 ||
+		    info->operands.a.operand < INSTRUCTION_OPERAND_U3_0 || info->operands.a.operand > INSTRUCTION_OPERAND_U3_7 ||
+		    info->operands.b.type != INSTRUCTION_OPERAND_TYPE_REGISTER8 || src < 0)
+			return false;
+
+		wide_gather(wide);
+
+		bit = 1 << (info->operands.a.operand - INSTRUCTION_OPERAND_U3_0);
+		condition = (wide_vec)((registers[src] & bit) == 0);
+		flags = (registers[WIDE_REGISTER_F] & ~(CPU_FLAG_ZERO | CPU_FLAG_SUBTRACTION)) |
+			CPU_FLAG_HALF_CARRY | (condition & CPU_FLAG_ZERO);
+
+		registers[WIDE_REGISTER_F] = wide_select(mask, flags, registers[WIDE_REGISTER_F]);
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Fetches and decodes once on leader, then executes on every running lane */
+static
+int wide_step_lockstep(struct wide *wide, unsigned leader, uint32_t running)
+{
+	int ret;
+	unsigned i;
+	uint8_t opcode;
+	uint16_t address;
+	uint32_t taken;
+	bool found_prefix, executed;
+	wide_vec mask = {0};
+	struct device *device;
+	struct decoded_instruction decoded_instruction;
+
+	memset(&decoded_instruction, 0, sizeof(decoded_instruction));
+
+	device = wide->lanes[leader];
+	address = device->cpu.registers.pc;
+	taken = running;
+
+	ret = fetch(device, &opcode, &found_prefix);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = decode(device, opcode, found_prefix, &decoded_instruction);
+	OK_OR_RETURN(ret == 0, ret);
+	OK_OR_RETURN(decoded_instruction.info->instruction_class != INSTRUCTION_CLASS_INVALID, -EINVAL);
+
+	for (i = 0; i < wide->count; i++) {
+		if (!(running & (1 << i)))
+			continue;
+
+		wide->lanes[i]->cpu.registers.pc = device->cpu.registers.pc;
+		mask[i] = 0xff;
+	}
+
+	if (decoded_instruction.info->instruction_class == INSTRUCTION_CLASS_JR)
+		executed = wide_execute_jr(wide, &decoded_instruction, running, &taken);
+	else
+		executed = wide_execute_vector(wide, &decoded_instruction, mask);
+
+	if (executed) {
+		wide->stats.vector++;
+	} else {
+		wide_scatter(wide);
+	}
+
+	for (i = 0; i < wide->count; i++) {
+		if (!(running & (1 << i)))
+			continue;
+
+		device = wide->lanes[i];
+
+		if (!executed) {
+			ret = execute(device, &decoded_instruction);
+			OK_OR_RETURN(ret == 0, ret);
+		} else {
+			decoded_instruction.cycles = taken & (1 << i) ? decoded_instruction.info->timing.c0 :
+									 decoded_instruction.info->timing.c1;
+		}
+
+		profile_record(&device->cpu, &decoded_instruction, address, opcode, found_prefix);
+
+		/* Must not touch CPU registers, which can be gathered here */
+		ret = update_clock(device, &decoded_instruction);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+
+	wide->stats.lockstep++;
+
+	return 0;
+}
+
+/*
+ * Diverged lanes run a burst on their own before convergence is checked
+ * again, rather than taking turns every instruction.
+ */
+static
+int wide_step_scalar(struct wide *wide, unsigned lane, uint64_t timestamp)
+{
+	int ret;
+	unsigned i;
+	struct device *device = wide->lanes[lane];
+
+	for (i = 0; i < WIDE_SCALAR_BURST; i++) {
+		if (cpu_is_halted(&device->cpu) || device->scheduler.timestamp >= timestamp)
+			break;
+
+		ret = cpu_step(device, 1, NULL);
+		OK_OR_RETURN(ret == 0, ret);
+
+		wide->stats.scalar++;
+	}
+
+	return 0;
+}
+
+static
+int wide_run(struct wide *wide, const uint64_t *timestamps)
+{
+	int ret = 0;
+	unsigned i, leader;
+	uint32_t running;
+	struct device *device;
+
+	while (true) {
+		running = 0;
+		for (i = 0; i < wide->count; i++) {
+			device = wide->lanes[i];
+			if (!cpu_is_halted(&device->cpu) && device->scheduler.timestamp < timestamps[i])
+				running |= 1 << i;
+		}
+
+		if (running == 0)
+			break;
+
+		leader = __builtin_ctz(running);
+
+		if (wide_converged(wide, leader, running)) {
+			ret = wide_step_lockstep(wide, leader, running);
+			OK_OR_BREAK(ret == 0);
+			continue;
+		}
+
+		wide_scatter(wide);
+
+		for (i = 0; i < wide->count; i++) {
+			if (!(running & (1 << i)))
+				continue;
+
+			ret = wide_step_scalar(wide, i, timestamps[i]);
+			OK_OR_BREAK(ret == 0);
+		}
+		OK_OR_BREAK(ret == 0);
+	}
+
+	wide_scatter(wide);
+
+	return ret;
+}
+
+/*
+ * Groups count devices, which must stay alive and otherwise untouched while
+ * the group runs them. Each device keeps its own memory, scheduler and
+ * peripherals; only the instruction stream is shared while it can be.
+ */
+LIBEXPORT
+int wide_init(struct wide *wide, struct device **devices, unsigned count)
+{
+	unsigned i;
+
+	OK_OR_RETURN(count > 0 && count <= WIDE_MAX_LANES, -EINVAL);
+
+	memset(wide, 0, sizeof(*wide));
+
+	for (i = 0; i < count; i++) {
+		OK_OR_RETURN(devices[i] != NULL, -EINVAL);
+		/* Lockstep decoding is only equivalent when every lane decodes alike */
+		OK_OR_RETURN(devices[i]->cpu.decoder.decode == devices[0]->cpu.decoder.decode, -EINVAL);
+		/* Vector execution hands out whole instructions only */
+		OK_OR_RETURN(devices[i]->cpu.core == CPU_CORE_INSTRUCTION, -EINVAL);
+
+		wide->lanes[i] = devices[i];
+	}
+
+	wide->count = count;
+
+	return 0;
+}
+
+/* Runs every lane until its scheduler reaches timestamp or its CPU halts */
+LIBEXPORT
+int wide_run_until(struct wide *wide, uint64_t timestamp)
+{
+	unsigned i;
+	uint64_t timestamps[WIDE_MAX_LANES];
+
+	for (i = 0; i < wide->count; i++)
+		timestamps[i] = timestamp;
+
+	return wide_run(wide, timestamps);
+}
+
+/* Runs every lane up to the start of its next frame */
+LIBEXPORT
+int wide_run_frame(struct wide *wide)
+{
+	unsigned i;
+	uint64_t frame, timestamps[WIDE_MAX_LANES];
+
+	for (i = 0; i < wide->count; i++) {
+		frame = wide->lanes[i]->scheduler.timestamp / DEVICE_FRAME_CYCLES;
+		timestamps[i] = (frame + 1) * DEVICE_FRAME_CYCLES;
+	}
+
+	return wide_run(wide, timestamps);
+}
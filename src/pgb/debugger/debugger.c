@@ -106,6 +106,7 @@ int debugger_fetch_instructions(struct device *device, struct debugger_info *inf
 	uint8_t opcode;
 	uint16_t pc_saved, address;
 	struct decoded_instruction decoded_instruction;
+	const struct instruction_text *text;
 	char *comment_a, *comment_b;
 
 	pc_saved = device->cpu.registers.pc;
@@ -123,7 +124,13 @@ int debugger_fetch_instructions(struct device *device, struct debugger_info *inf
 		ret = decode(device, opcode, is_prefix, &decoded_instruction);
 		OK_OR_BREAK(ret == 0);
 
-		info[i].assembly = decoded_instruction.info->assembly;
+		if (is_prefix)
+			ret = cpu_decoder_get_prefix_cb_instruction_text(opcode, &text);
+		else
+			ret = cpu_decoder_get_instruction_text(opcode, &text);
+		OK_OR_BREAK(ret == 0);
+
+		info[i].assembly = text->assembly;
 		info[i].address = address;
 		info[i].num_bytes = decoded_instruction.info->num_bytes;
 		memcpy(info[i].raw_data, decoded_instruction.raw_data, info[i].num_bytes);
@@ -181,7 +188,8 @@ void free_debugger_info(struct debugger_info *info, size_t n)
 #define IO_REGISTER(NAME) \
 	{#NAME, LR35902_IO_REGS_##NAME}
 
-struct io_register_map {
+static
+const struct io_register_map {
 	const char *name;
 	uint16_t address;
 } io_register_mappings[] = {
@@ -237,7 +245,7 @@ int debugger_io_register_read(struct device *device, uint16_t address, uint8_t *
 	uint8_t value;
 	bool found = false;
 	struct mmu *mmu = &device->mmu;
-	struct io_register_map *map;
+	const struct io_register_map *map;
 
 	for (i = 0; i < ARRAY_SIZE(io_register_mappings); i++) {
 		map = &io_register_mappings[i];
@@ -262,7 +270,7 @@ int debugger_io_register_address_to_name(uint16_t address, const char **__name)
 {
 	unsigned i;
 	const char *name = NULL;
-	struct io_register_map *map;
+	const struct io_register_map *map;
 
 	for (i = 0; i < ARRAY_SIZE(io_register_mappings); i++) {
 		map = &io_register_mappings[i];
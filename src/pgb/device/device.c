@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
@@ -9,6 +11,7 @@
 #include <pgb/debug.h>
 #include <pgb/utils.h>
 #include <pgb/device/device.h>
+#include <pgb/mmu/private/mmu.h>
 
 LIBEXPORT
 int device_init(struct device *device, const char *decoder_type)
@@ -22,6 +25,21 @@ int device_init(struct device *device, const char *decoder_type)
 	OK_OR_RETURN(ret == 0, ret);
 
 	ret = gpu_init(&device->gpu);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = apu_init(&device->apu);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = serial_init(&device->serial);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = joypad_init(&device->joypad);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = scheduler_init(&device->scheduler);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = state_hash_init(&device->hash);
 	OK_OR_WARN(ret == 0);
 
 	return ret;
@@ -32,12 +50,56 @@ int device_destroy(struct device *device)
 {
 	cpu_destroy(&device->cpu);
 	mmu_destroy(&device->mmu);
+	apu_destroy(&device->apu);
+	serial_destroy(&device->serial);
+
+	return 0;
+}
+
+/*
+ * Forks src into dst, which must not be initialized. Memory pages are shared
+ * until either side writes to them, so a clone costs a few pointer copies no
+ * matter how much of the address space has been touched. Audio output is not
+ * inherited, the clone starts in the APU mode of src with no ring attached,
+ * and neither is a profile.
+ * The clone is released with device_destroy().
+ */
+LIBEXPORT
+int device_clone(struct device *dst, struct device *src)
+{
+	int ret;
+
+	ret = apu_sync(src);
+	OK_OR_RETURN(ret == 0, ret);
+
+	dst->cpu = src->cpu;
+	dst->cpu.profile = NULL;
+	dst->gpu = src->gpu;
+	dst->joypad = src->joypad;
+	dst->scheduler = src->scheduler;
+	dst->hash = src->hash;
+	dst->settings = src->settings;
+
+	ret = mmu_clone(&dst->mmu, &src->mmu);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = apu_clone(&dst->apu, &src->apu);
+	OK_OR_GOTO(ret == 0, fail_apu);
+
+	ret = serial_clone(&dst->serial, &src->serial);
+	OK_OR_GOTO(ret == 0, fail_serial);
 
 	return 0;
+
+fail_serial:
+	apu_destroy(&dst->apu);
+fail_apu:
+	mmu_destroy(&dst->mmu);
+	return ret;
 }
 
 LIBEXPORT
-int device_load_bios_from_address(struct device *device, uint8_t *data, size_t len)
+int device_load_bios_from_address(struct device *device, const uint8_t *data, size_t len)
 {
 	struct mmu *mmu = &device->mmu;
 
@@ -45,9 +107,7 @@ int device_load_bios_from_address(struct device *device, uint8_t *data, size_t l
 	// XXX: Make constant for 256 (ROM image size)
 	OK_OR_RETURN(len == 256, -EINVAL);
 
-	memcpy(mmu->ram, data, len);
-
-	return 0;
+	return mmu_copy_in(mmu, 0, data, len);
 }
 
 LIBEXPORT
@@ -58,52 +118,83 @@ int device_load_bios_from_file(struct device *device, const char *bios_path)
 	struct stat bios_st;
 	struct mmu *mmu = &device->mmu;
 
-	fd = open(bios_path, O_RDONLY);
-	OK_OR_RETURN(fd >= 0, -EINVAL);
-
 	ret = stat(bios_path, &bios_st);
 	OK_OR_RETURN(ret == 0, -EIO);
 
 	// XXX: Make constant for 256 (ROM image size)
 	OK_OR_RETURN(bios_st.st_size == 256, -EINVAL);
 
+	fd = open(bios_path, O_RDONLY);
+	OK_OR_RETURN(fd >= 0, -EINVAL);
+
 	data = mmap(NULL, bios_st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
 	OK_OR_RETURN(data != MAP_FAILED, -EIO);
 
-	memcpy(mmu->ram, data, bios_st.st_size);
+	ret = mmu_copy_in(mmu, 0, data, bios_st.st_size);
+	OK_OR_WARN(ret == 0);
 
 	// XXX: Store pointer instead of releasing
 	munmap(data, bios_st.st_size);
 
-	return 0;
+	return ret;
 }
 
-LIBEXPORT
-int device_load_image_from_file(struct device *device, const char *rom_path)
+/* Maps the rom at rom_path from start on, up to the end of ROM bank 01 */
+static
+int device_map_image(struct device *device, const char *rom_path, uint16_t start)
 {
 	int ret, fd;
 	uint8_t *data;
 	struct stat rom_st;
 	struct mmu *mmu = &device->mmu;
 
-	fd = open(rom_path, O_RDONLY);
-	OK_OR_RETURN(fd >= 0, -EINVAL);
-
 	ret = stat(rom_path, &rom_st);
 	OK_OR_RETURN(ret == 0, -EIO);
 
+	/* Anything shorter does not even reach the cartridge header */
+	OK_OR_RETURN(rom_st.st_size >= 0x100, -EINVAL);
+
+	fd = open(rom_path, O_RDONLY);
+	OK_OR_RETURN(fd >= 0, -EINVAL);
+
 	data = mmap(NULL, rom_st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
 	OK_OR_RETURN(data != MAP_FAILED, -EIO);
 
 	// XXX: Handle rom image larger than the size of section 00
-	// XXX: Rom images are loaded starting at address 256
-	// XXX: when addres 0xff50 is written, unmap firmware and map first 256 bytes of the rom
-	memcpy(mmu->ram + 0x100, data + 0x100, rom_st.st_size - 0x100);
+	ret = mmu_copy_in(mmu, start, data + start,
+			  MIN((size_t)rom_st.st_size, LR35902_MMU_REGION_ROM_BANK_01_NN_END + 1) - start);
+	OK_OR_WARN(ret == 0);
 
 	// XXX: Store pointer instead of releasing
 	munmap(data, rom_st.st_size);
 
-	return 0;
+	return ret;
+}
+
+LIBEXPORT
+int device_load_image_from_file(struct device *device, const char *rom_path)
+{
+	// XXX: Rom images are loaded starting at address 256
+	// XXX: when addres 0xff50 is written, unmap firmware and map first 256 bytes of the rom
+	return device_map_image(device, rom_path, 0x100);
+}
+
+/*
+ * Loads a rom to run without a boot ROM: its first 256 bytes, with the RST
+ * and interrupt vectors, are mapped as well, and the CPU starts where the DMG
+ * boot ROM hands over to the cartridge.
+ */
+LIBEXPORT
+int device_load_image_without_bios(struct device *device, const char *rom_path)
+{
+	int ret;
+
+	ret = device_map_image(device, rom_path, 0);
+	OK_OR_RETURN(ret == 0, ret);
+
+	return registers_init_post_boot(&device->cpu.registers);
 }
 
 LIBEXPORT
@@ -138,6 +229,9 @@ int device_configure_setting(struct device *device, enum device_setting setting,
 	case DEVICE_SETTING_DECODER_TYPE:
 		device->settings.decoder_type = value;
 		break;
+	case DEVICE_SETTING_CPU_CORE:
+		ret = string_to_cpu_core(value, &device->cpu.core);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -146,3 +240,73 @@ int device_configure_setting(struct device *device, enum device_setting setting,
 
 	return ret;
 }
+
+/* Runs until the scheduler reaches timestamp or the CPU halts */
+LIBEXPORT
+int device_run_until(struct device *device, uint64_t timestamp)
+{
+	int ret = 0;
+
+	while (device->scheduler.timestamp < timestamp) {
+		if (cpu_is_halted(&device->cpu))
+			break;
+
+		ret = cpu_step(device, 1, NULL);
+		OK_OR_BREAK(ret == 0);
+	}
+
+	return ret;
+}
+
+/* Runs up to the start of the next frame */
+LIBEXPORT
+int device_run_frame(struct device *device)
+{
+	uint64_t frame;
+
+	frame = device->scheduler.timestamp / DEVICE_FRAME_CYCLES;
+
+	return device_run_until(device, (frame + 1) * DEVICE_FRAME_CYCLES);
+}
+
+LIBEXPORT
+int device_run_until_serial_match(struct device *device, const char *pattern, uint64_t max_cycles, bool *matched)
+{
+	int ret = 0;
+	size_t pattern_length, base, searched, start;
+	uint64_t start_timestamp;
+	struct serial *serial = &device->serial;
+
+	OK_OR_RETURN(pattern != NULL && matched != NULL, -EINVAL);
+
+	pattern_length = strlen(pattern);
+	OK_OR_RETURN(pattern_length > 0, -EINVAL);
+
+	*matched = false;
+	base = serial->output.length;
+	searched = base;
+	start_timestamp = device->scheduler.timestamp;
+
+	/* Only output produced from now on is considered */
+	while (device->scheduler.timestamp - start_timestamp < max_cycles) {
+		if (cpu_is_halted(&device->cpu))
+			break;
+
+		ret = cpu_step(device, 1, NULL);
+		OK_OR_BREAK(ret == 0);
+
+		if (serial->output.length == searched)
+			continue;
+
+		/* Rescan the tail of the old output in case the match straddles it */
+		start = searched - MIN(searched - base, pattern_length - 1);
+		searched = serial->output.length;
+
+		if (memmem(serial->output.data + start, searched - start, pattern, pattern_length) != NULL) {
+			*matched = true;
+			break;
+		}
+	}
+
+	return ret;
+}
@@ -77,7 +77,7 @@ int gpu_vram_read(struct gpu *gpu, struct mmu *mmu)
 	int ret = 0;
 
 	if (gpu->clock >= 172) {
-		gpu->clock = 0;
+		gpu->clock -= 172;
 		gpu->mode = GPU_MODE_HBLANK;
 
 		ret = gpu_vram_renderscan(gpu, mmu);
@@ -91,7 +91,7 @@ static
 int gpu_oam_read(struct gpu *gpu, struct mmu *mmu)
 {
 	if (gpu->clock >= 80) {
-		gpu->clock = 0;
+		gpu->clock -= 80;
 		gpu->mode = GPU_MODE_VRAM_READ;
 	}
 
@@ -105,7 +105,7 @@ int gpu_vblank(struct gpu *gpu, struct mmu *mmu)
 	uint8_t line;
 
 	if (gpu->clock >= 456) {
-		gpu->clock = 0;
+		gpu->clock -= 456;
 
 		ret = IOREG_RD8(mmu, LY, &line);
 		OK_OR_RETURN(ret == 0, ret);
@@ -131,7 +131,7 @@ int gpu_hblank(struct gpu *gpu, struct mmu *mmu)
 	uint8_t line;
 
 	if (gpu->clock >= 204) {
-		gpu->clock = 0;
+		gpu->clock -= 204;
 
 		ret = IOREG_RD8(mmu, LY, &line);
 		OK_OR_RETURN(ret == 0, ret);
@@ -158,6 +158,7 @@ int gpu_step(struct gpu *gpu, struct mmu *mmu, uint16_t t)
 {
 	int ret;
 
+	/* Modes carry their overshoot over, so the phase does not depend on how t is split up */
 	gpu->clock += t;
 
 	switch (gpu->mode) {
@@ -1,24 +1,80 @@
+#include <pgb/apu/apu.h>
 #include <pgb/debug.h>
 #include <pgb/device/device.h>
 #include <pgb/mmu/mmu.h>
 #include <pgb/io/io.h>
 #include <pgb/io/private/io.h>
+#include <pgb/joypad/joypad.h>
+#include <pgb/mmu/private/mmu.h>
+#include <pgb/scheduler/scheduler.h>
+#include <pgb/serial/serial.h>
 
+/*
+ * ioreg_rd8() and ioreg_wr8() are used by the emulated hardware itself and
+ * bypass the side effects a CPU access to the same register would trigger.
+ */
 int ioreg_rd8(struct mmu *mmu, uint16_t address, uint8_t *result)
+{
+	*result = mmu_peek(mmu, address);
+
+	return 0;
+}
+
+int ioreg_wr8(struct mmu *mmu, uint16_t address, uint8_t value)
+{
+	return mmu_poke(mmu, address, value);
+}
+
+static
+int io_write_dma(struct device *device, uint8_t value)
 {
 	int ret;
 
-	ret = mmu_read8(mmu, address, result);
+	ret = ioreg_wr8(&device->mmu, LR35902_IO_REGS_DMA, value);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = mmu_oam_dma_start(&device->mmu, value);
+	OK_OR_RETURN(ret == 0, ret);
+
+	/* A write during a transfer restarts it */
+	ret = scheduler_schedule(&device->scheduler, SCHEDULER_EVENT_OAM_DMA, LR35902_MMU_OAM_DMA_CYCLES);
 	OK_OR_WARN(ret == 0);
 
 	return ret;
 }
 
-int ioreg_wr8(struct mmu *mmu, uint16_t address, uint8_t value)
+int io_read8(struct device *device, uint16_t address, uint8_t *result)
+{
+	if (address >= APU_REGISTERS_START && address <= APU_REGISTERS_END)
+		return apu_read8(device, address, result);
+
+	if (address == LR35902_IO_REGS_P1)
+		return joypad_read_p1(device, result);
+
+	return ioreg_rd8(&device->mmu, address, result);
+}
+
+int io_write8(struct device *device, uint16_t address, uint8_t value)
 {
 	int ret;
 
-	ret = mmu_write8(mmu, address, value);
+	if (address >= APU_REGISTERS_START && address <= APU_REGISTERS_END)
+		return apu_write8(device, address, value);
+
+	switch (address) {
+	case LR35902_IO_REGS_P1:
+		ret = joypad_write_p1(device, value);
+		break;
+	case LR35902_IO_REGS_SC:
+		ret = serial_write_sc(device, value);
+		break;
+	case LR35902_IO_REGS_DMA:
+		ret = io_write_dma(device, value);
+		break;
+	default:
+		ret = ioreg_wr8(&device->mmu, address, value);
+		break;
+	}
 	OK_OR_WARN(ret == 0);
 
 	return ret;
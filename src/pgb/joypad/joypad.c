@@ -0,0 +1,110 @@
+#include <errno.h>
+
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/io/io.h>
+#include <pgb/io/private/io.h>
+#include <pgb/joypad/joypad.h>
+#include <pgb/utils.h>
+
+/* Only the two select lines can be written */
+#define JOYPAD_P1_SELECT_MASK 0x30
+/* The unused top bits read back as ones */
+#define JOYPAD_P1_UNUSED_MASK 0xc0
+
+/* The four input lines for the given selection, low while a button pulls them */
+static
+uint8_t joypad_lines(uint8_t select, uint8_t buttons)
+{
+	uint8_t lines = 0x0f;
+
+	if (IRF_GET_VALUE(P1, P14_OUT_PORT, select) == 0)
+		lines &= ~(buttons & 0x0f);
+	if (IRF_GET_VALUE(P1, P15_OUT_PORT, select) == 0)
+		lines &= ~(buttons >> 4);
+
+	return lines;
+}
+
+/*
+ * Any input line going from high to low requests the joypad interrupt, and
+ * wakes the CPU from STOP.
+ */
+static
+int joypad_update(struct device *device, uint8_t before, uint8_t after)
+{
+	int ret;
+	uint8_t iflags;
+	struct mmu *mmu = &device->mmu;
+
+	if ((before & ~after) == 0)
+		return 0;
+
+	if (device->cpu.status.stopped) {
+		device->cpu.status.stopped = false;
+		device->cpu.status.halted = false;
+	}
+
+	ret = IOREG_RD8(mmu, IF, &iflags);
+	OK_OR_RETURN(ret == 0, ret);
+
+	iflags = IRF_SET_VALUE(IF, JOYPAD, 1, iflags);
+
+	ret = IOREG_WR8(mmu, IF, iflags);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
+
+LIBEXPORT
+int joypad_init(struct joypad *joypad)
+{
+	joypad->buttons = 0;
+
+	return 0;
+}
+
+/* Replaces the set of held buttons, a mask of enum joypad_button */
+LIBEXPORT
+int joypad_set_buttons(struct device *device, uint8_t buttons)
+{
+	int ret;
+	uint8_t select, before;
+
+	ret = IOREG_RD8(&device->mmu, P1, &select);
+	OK_OR_RETURN(ret == 0, ret);
+
+	before = joypad_lines(select, device->joypad.buttons);
+	device->joypad.buttons = buttons;
+
+	return joypad_update(device, before, joypad_lines(select, buttons));
+}
+
+int joypad_read_p1(struct device *device, uint8_t *result)
+{
+	int ret;
+	uint8_t select;
+
+	ret = IOREG_RD8(&device->mmu, P1, &select);
+	OK_OR_RETURN(ret == 0, ret);
+
+	*result = JOYPAD_P1_UNUSED_MASK | (select & JOYPAD_P1_SELECT_MASK) | joypad_lines(select, device->joypad.buttons);
+
+	return 0;
+}
+
+int joypad_write_p1(struct device *device, uint8_t value)
+{
+	int ret;
+	uint8_t select, before;
+
+	ret = IOREG_RD8(&device->mmu, P1, &select);
+	OK_OR_RETURN(ret == 0, ret);
+
+	before = joypad_lines(select, device->joypad.buttons);
+
+	ret = IOREG_WR8(&device->mmu, P1, value & JOYPAD_P1_SELECT_MASK);
+	OK_OR_RETURN(ret == 0, ret);
+
+	return joypad_update(device, before, joypad_lines(value, device->joypad.buttons));
+}
@@ -4,28 +4,223 @@
 #include <string.h>
 
 #include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/io/io.h>
 #include <pgb/mmu/mmu.h>
 #include <pgb/mmu/private/mmu.h>
 #include <pgb/utils.h>
 
+static
+struct mmu_page *mmu_page_alloc(void)
+{
+	struct mmu_page *page;
+
+	page = calloc(1, sizeof(*page));
+	if (page)
+		atomic_init(&page->refcount, 1);
+
+	return page;
+}
+
+static
+void mmu_page_release(struct mmu_page *page)
+{
+	if (page && atomic_fetch_sub_explicit(&page->refcount, 1, memory_order_acq_rel) == 1)
+		free(page);
+}
+
+/* Gives this MMU a private copy of a page it may share, before writing to it */
+int mmu_page_unshare(struct mmu *mmu, unsigned index)
+{
+	struct mmu_page *page, *copy;
+
+	page = mmu->pages[index];
+
+	/* Every other owner may already have copied or gone away */
+	if (atomic_load_explicit(&page->refcount, memory_order_acquire) > 1) {
+		copy = malloc(sizeof(*copy));
+		OK_OR_RETURN(copy != NULL, -ENOMEM);
+
+		atomic_init(&copy->refcount, 1);
+		memcpy(copy->data, page->data, MMU_PAGE_SIZE);
+
+		mmu->pages[index] = copy;
+		mmu->generation++;
+		mmu_page_release(page);
+	}
+
+	mmu->shared &= ~(1 << index);
+
+	return 0;
+}
+
 LIBEXPORT
 int mmu_init(struct mmu *mmu)
 {
-	mmu->ram = NULL;
+	int i;
+
 	mmu->size = LR35902_MMU_MEMORY_SIZE;
+	mmu->shared = 0;
+	mmu->generation = 0;
+	mmu->oam_dma.active = false;
+	/* Nothing has been seen by a snapshot yet */
+	memset(mmu->dirty, 0xff, sizeof(mmu->dirty));
+
+	for (i = 0; i < MMU_NUM_PAGES; i++)
+		mmu->pages[i] = NULL;
 
-	mmu->ram = calloc(LR35902_MMU_MEMORY_SIZE, sizeof(uint8_t));
-	OK_OR_RETURN(mmu->ram != NULL, -ENOMEM);
+	for (i = 0; i < MMU_NUM_PAGES; i++) {
+		mmu->pages[i] = mmu_page_alloc();
+		OK_OR_GOTO(mmu->pages[i] != NULL, error);
+	}
 
 	return 0;
+
+error:
+	mmu_destroy(mmu);
+	return -ENOMEM;
 }
 
 LIBEXPORT
 int mmu_destroy(struct mmu *mmu)
 {
-	free(mmu->ram);
+	int i;
+
+	for (i = 0; i < MMU_NUM_PAGES; i++) {
+		mmu_page_release(mmu->pages[i]);
+		mmu->pages[i] = NULL;
+	}
+
 	mmu->size = 0;
-	mmu->ram = NULL;
+	mmu->shared = 0;
+	return 0;
+}
+
+/*
+ * dst shares every page of src; whichever of the two writes to a page first
+ * gets its own copy. dst must not hold any pages.
+ */
+LIBEXPORT
+int mmu_clone(struct mmu *dst, struct mmu *src)
+{
+	int i;
+
+	for (i = 0; i < MMU_NUM_PAGES; i++) {
+		atomic_fetch_add_explicit(&src->pages[i]->refcount, 1, memory_order_relaxed);
+		dst->pages[i] = src->pages[i];
+	}
+
+	src->shared = (1 << MMU_NUM_PAGES) - 1;
+	dst->shared = src->shared;
+	dst->size = src->size;
+	/* The pages are the same, so whatever pointed into those of src still holds */
+	dst->generation = src->generation;
+	dst->oam_dma = src->oam_dma;
+	memcpy(dst->dirty, src->dirty, sizeof(dst->dirty));
+
+	return 0;
+}
+
+/* Host-side bulk write, split at page boundaries */
+LIBEXPORT
+int mmu_copy_in(struct mmu *mmu, uint32_t address, const void *data, size_t length)
+{
+	int ret;
+	size_t chunk;
+	unsigned index;
+	const uint8_t *in = data;
+
+	/* Written so that a huge length cannot wrap around */
+	OK_OR_RETURN(address <= LR35902_MMU_MEMORY_SIZE && length <= LR35902_MMU_MEMORY_SIZE - address, -EINVAL);
+
+	mmu_dirty_mark_range(mmu, address, length);
+
+	while (length > 0) {
+		index = address >> MMU_PAGE_SHIFT;
+		chunk = MIN(length, MMU_PAGE_SIZE - (address & MMU_PAGE_MASK));
+
+		if (mmu->shared & (1 << index)) {
+			ret = mmu_page_unshare(mmu, index);
+			OK_OR_RETURN(ret == 0, ret);
+		}
+
+		memcpy(&mmu->pages[index]->data[address & MMU_PAGE_MASK], in, chunk);
+
+		address += chunk;
+		in += chunk;
+		length -= chunk;
+	}
+
+	return 0;
+}
+
+/* Host-side bulk read, split at page boundaries */
+LIBEXPORT
+int mmu_copy_out(struct mmu *mmu, uint32_t address, void *buffer, size_t length)
+{
+	size_t chunk;
+	uint8_t *out = buffer;
+
+	/* Written so that a huge length cannot wrap around */
+	OK_OR_RETURN(address <= LR35902_MMU_MEMORY_SIZE && length <= LR35902_MMU_MEMORY_SIZE - address, -EINVAL);
+
+	while (length > 0) {
+		chunk = MIN(length, MMU_PAGE_SIZE - (address & MMU_PAGE_MASK));
+
+		memcpy(out, &mmu->pages[address >> MMU_PAGE_SHIFT]->data[address & MMU_PAGE_MASK], chunk);
+
+		address += chunk;
+		out += chunk;
+		length -= chunk;
+	}
+
+	return 0;
+}
+
+LIBEXPORT
+int mmu_unshare_all(struct mmu *mmu)
+{
+	int ret;
+	unsigned i;
+
+	for (i = 0; i < MMU_NUM_PAGES; i++) {
+		if (!(mmu->shared & (1 << i)))
+			continue;
+
+		ret = mmu_page_unshare(mmu, i);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+
+	return 0;
+}
+
+/*
+ * During OAM DMA the external and video buses are busy, which leaves the CPU
+ * with the I/O registers, HRAM and IE.
+ */
+static inline
+bool mmu_oam_dma_blocks(struct mmu *mmu, uint16_t address)
+{
+	return mmu->oam_dma.active && address < LR35902_MMU_REGION_IO_REGISTERS_START;
+}
+
+LIBEXPORT
+int mmu_dirty_get(struct mmu *mmu, enum mmu_dirty_channel channel, uint64_t dirty[MMU_DIRTY_WORDS])
+{
+	OK_OR_RETURN(channel < MMU_DIRTY_CHANNEL_MAX, -EINVAL);
+
+	memcpy(dirty, mmu->dirty[channel], sizeof(mmu->dirty[channel]));
+
+	return 0;
+}
+
+LIBEXPORT
+int mmu_dirty_clear(struct mmu *mmu, enum mmu_dirty_channel channel)
+{
+	OK_OR_RETURN(channel < MMU_DIRTY_CHANNEL_MAX, -EINVAL);
+
+	memset(mmu->dirty[channel], 0, sizeof(mmu->dirty[channel]));
+
 	return 0;
 }
 
@@ -34,7 +229,15 @@ int mmu_read8(struct mmu *mmu, uint16_t address, uint8_t *result)
 {
 	// OK_OR_RETURN(address < LR35902_MMU_MEMORY_SIZE, -EINVAL);
 
-	*result = mmu->ram[address];
+	if (address >= LR35902_MMU_REGION_IO_REGISTERS_START && address <= LR35902_MMU_REGION_IO_REGISTERS_END)
+		return io_read8(container_of(mmu, struct device, mmu), address, result);
+
+	if (mmu_oam_dma_blocks(mmu, address)) {
+		*result = 0xff;
+		return 0;
+	}
+
+	*result = mmu_peek(mmu, address);
 
 	return 0;
 }
@@ -42,9 +245,18 @@ int mmu_read8(struct mmu *mmu, uint16_t address, uint8_t *result)
 LIBEXPORT
 int mmu_read16(struct mmu *mmu, uint16_t address, uint16_t *result)
 {
+	int ret;
+	uint8_t lo, hi;
+
 	OK_OR_RETURN((address + 1) < LR35902_MMU_MEMORY_SIZE, -EINVAL);
 
-	*result = (mmu->ram[address + 1] << 8) | mmu->ram[address];
+	ret = mmu_read8(mmu, address, &lo);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = mmu_read8(mmu, address + 1, &hi);
+	OK_OR_RETURN(ret == 0, ret);
+
+	*result = (hi << 8) | lo;
 
 	return 0;
 }
@@ -54,18 +266,62 @@ int mmu_write8(struct mmu *mmu, uint16_t address, uint8_t value)
 {
 	// OK_OR_RETURN(address < LR35902_MMU_MEMORY_SIZE, -EINVAL);
 
-	mmu->ram[address] = value;
+	if (address >= LR35902_MMU_REGION_IO_REGISTERS_START && address <= LR35902_MMU_REGION_IO_REGISTERS_END)
+		return io_write8(container_of(mmu, struct device, mmu), address, value);
 
-	return 0;
+	if (mmu_oam_dma_blocks(mmu, address))
+		return 0;
+
+	return mmu_poke(mmu, address, value);
 }
 
 LIBEXPORT
 int mmu_write16(struct mmu *mmu, uint16_t address, uint16_t value)
 {
+	int ret;
+
 	OK_OR_RETURN((address + 1) < LR35902_MMU_MEMORY_SIZE, -EINVAL);
 
-	mmu->ram[address] = value & 0xff;
-	mmu->ram[address + 1] = (value >> 8) & 0xff;
+	ret = mmu_write8(mmu, address, value & 0xff);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = mmu_write8(mmu, address + 1, (value >> 8) & 0xff);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
+
+LIBEXPORT
+int mmu_oam_dma_start(struct mmu *mmu, uint8_t source_page)
+{
+	int ret;
+	uint16_t source;
+	uint8_t oam[LR35902_MMU_OAM_DMA_LENGTH];
+
+	source = source_page << 8;
+
+	/* Sources past WRAM read the echo of it */
+	if (source >= LR35902_MMU_REGION_WORK_RAM_MIRROR_START)
+		source -= LR35902_MMU_REGION_WORK_RAM_MIRROR_START - LR35902_MMU_REGION_WORK_RAM_BANK_00_START;
+
+	/* The whole transfer happens up front, the bus stays locked for its duration */
+	ret = mmu_copy_out(mmu, source, oam, sizeof(oam));
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = mmu_copy_in(mmu, LR35902_MMU_REGION_SPRITE_ATTRIBUTE_TABLE_START, oam, sizeof(oam));
+	OK_OR_RETURN(ret == 0, ret);
+
+	mmu->oam_dma.active = true;
+	mmu->generation++;
+
+	return 0;
+}
+
+LIBEXPORT
+int mmu_oam_dma_complete(struct mmu *mmu)
+{
+	mmu->oam_dma.active = false;
+	mmu->generation++;
 
 	return 0;
 }
@@ -79,7 +335,5 @@ int mmu_read_region(struct mmu *mmu, uint16_t base_address, uint8_t *buffer, siz
 		*size = LR35902_MMU_MEMORY_SIZE - base_address;
 	}
 
-	memcpy(buffer, mmu->ram + base_address, *size);
-
-	return 0;
+	return mmu_copy_out(mmu, base_address, buffer, *size);
 }
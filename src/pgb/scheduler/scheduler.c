@@ -0,0 +1,111 @@
+#include <errno.h>
+
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/scheduler/scheduler.h>
+#include <pgb/serial/serial.h>
+#include <pgb/utils.h>
+
+static
+void scheduler_update_next_deadline(struct scheduler *scheduler)
+{
+	unsigned i;
+	uint64_t next = SCHEDULER_NEVER;
+
+	for (i = 0; i < SCHEDULER_EVENT_MAX; i++) {
+		if (scheduler->deadlines[i] < next)
+			next = scheduler->deadlines[i];
+	}
+
+	scheduler->next_deadline = next;
+}
+
+static
+int scheduler_dispatch(struct device *device, enum scheduler_event event)
+{
+	int ret;
+
+	switch (event) {
+	case SCHEDULER_EVENT_SERIAL_TRANSFER:
+		ret = serial_transfer_complete(device);
+		break;
+	case SCHEDULER_EVENT_OAM_DMA:
+		ret = mmu_oam_dma_complete(&device->mmu);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
+
+LIBEXPORT
+int scheduler_init(struct scheduler *scheduler)
+{
+	unsigned i;
+
+	scheduler->timestamp = 0;
+	scheduler->next_deadline = SCHEDULER_NEVER;
+
+	for (i = 0; i < SCHEDULER_EVENT_MAX; i++)
+		scheduler->deadlines[i] = SCHEDULER_NEVER;
+
+	return 0;
+}
+
+LIBEXPORT
+int scheduler_schedule(struct scheduler *scheduler, enum scheduler_event event, uint64_t delay)
+{
+	OK_OR_RETURN((unsigned)event < SCHEDULER_EVENT_MAX, -EINVAL);
+
+	scheduler->deadlines[event] = scheduler->timestamp + delay;
+	if (scheduler->deadlines[event] < scheduler->next_deadline)
+		scheduler->next_deadline = scheduler->deadlines[event];
+
+	return 0;
+}
+
+LIBEXPORT
+int scheduler_cancel(struct scheduler *scheduler, enum scheduler_event event)
+{
+	OK_OR_RETURN((unsigned)event < SCHEDULER_EVENT_MAX, -EINVAL);
+
+	scheduler->deadlines[event] = SCHEDULER_NEVER;
+	scheduler_update_next_deadline(scheduler);
+
+	return 0;
+}
+
+LIBEXPORT
+bool scheduler_is_pending(struct scheduler *scheduler, enum scheduler_event event)
+{
+	return scheduler->deadlines[event] != SCHEDULER_NEVER;
+}
+
+LIBEXPORT
+int scheduler_advance(struct device *device, uint64_t cycles)
+{
+	int ret = 0;
+	unsigned i;
+	struct scheduler *scheduler = &device->scheduler;
+
+	scheduler->timestamp += cycles;
+
+	while (scheduler->timestamp >= scheduler->next_deadline) {
+		for (i = 0; i < SCHEDULER_EVENT_MAX; i++) {
+			if (scheduler->deadlines[i] == scheduler->next_deadline)
+				break;
+		}
+
+		/* Clear the slot first so the handler is free to reschedule itself */
+		scheduler->deadlines[i] = SCHEDULER_NEVER;
+		scheduler_update_next_deadline(scheduler);
+
+		ret = scheduler_dispatch(device, i);
+		OK_OR_BREAK(ret == 0);
+	}
+
+	return ret;
+}
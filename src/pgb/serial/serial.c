@@ -0,0 +1,187 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/io/io.h>
+#include <pgb/io/private/io.h>
+#include <pgb/scheduler/scheduler.h>
+#include <pgb/serial/serial.h>
+#include <pgb/utils.h>
+
+/* 8 bits shifted out at 8192 Hz, expressed in T-cycles */
+#define SERIAL_TRANSFER_CYCLES (8 * 512)
+#define SERIAL_OUTPUT_INITIAL_CAPACITY 64
+
+static
+int serial_output_append(struct serial *serial, uint8_t value)
+{
+	size_t capacity;
+	uint8_t *data;
+
+	if (serial->output.length == serial->output.capacity) {
+		capacity = serial->output.capacity ? serial->output.capacity * 2 : SERIAL_OUTPUT_INITIAL_CAPACITY;
+
+		data = realloc(serial->output.data, capacity);
+		OK_OR_RETURN(data != NULL, -ENOMEM);
+
+		serial->output.data = data;
+		serial->output.capacity = capacity;
+	}
+
+	serial->output.data[serial->output.length++] = value;
+
+	return 0;
+}
+
+LIBEXPORT
+int serial_init(struct serial *serial)
+{
+	serial->transport = SERIAL_TRANSPORT_DISCONNECTED;
+	serial->transfer_active = false;
+	serial->output.data = NULL;
+	serial->output.length = 0;
+	serial->output.capacity = 0;
+
+	return 0;
+}
+
+LIBEXPORT
+int serial_destroy(struct serial *serial)
+{
+	free(serial->output.data);
+	serial->output.data = NULL;
+	serial->output.length = 0;
+	serial->output.capacity = 0;
+
+	return 0;
+}
+
+/* The captured output is copied so both sides can keep appending to it */
+LIBEXPORT
+int serial_clone(struct serial *dst, struct serial *src)
+{
+	*dst = *src;
+	dst->output.data = NULL;
+	dst->output.capacity = 0;
+
+	if (src->output.capacity == 0)
+		return 0;
+
+	dst->output.data = malloc(src->output.capacity);
+	OK_OR_RETURN(dst->output.data != NULL, -ENOMEM);
+
+	memcpy(dst->output.data, src->output.data, src->output.length);
+	dst->output.capacity = src->output.capacity;
+
+	return 0;
+}
+
+LIBEXPORT
+int serial_set_transport(struct serial *serial, enum serial_transport transport)
+{
+	int ret = 0;
+
+	switch (transport) {
+	case SERIAL_TRANSPORT_DISCONNECTED:
+	case SERIAL_TRANSPORT_CAPTURE:
+		serial->transport = transport;
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
+
+LIBEXPORT
+int serial_get_output(struct serial *serial, const uint8_t **data, size_t *length)
+{
+	*data = serial->output.data;
+	*length = serial->output.length;
+
+	return 0;
+}
+
+LIBEXPORT
+int serial_clear_output(struct serial *serial)
+{
+	serial->output.length = 0;
+
+	return 0;
+}
+
+int serial_write_sc(struct device *device, uint8_t value)
+{
+	int ret;
+	uint8_t sb;
+	bool internal_clock;
+	struct serial *serial = &device->serial;
+
+	ret = ioreg_wr8(&device->mmu, LR35902_IO_REGS_SC, value);
+	OK_OR_RETURN(ret == 0, ret);
+
+	if (IRF_GET_VALUE(SC, TRANSFER_START_FLAG, value) != LR35902_IO_REGS_SC_TRANSFER_START_FLAG_START)
+		return 0;
+
+	if (serial->transfer_active)
+		return 0;
+
+	internal_clock = IRF_GET_VALUE(SC, SHIFT_CLOCK, value) == LR35902_IO_REGS_SC_SHIFT_CLOCK_INTERNAL_CLOCK;
+
+	/*
+	 * With nothing attached, a transfer waiting on an external clock never
+	 * finishes. The capture transport behaves like a peer that always clocks.
+	 */
+	if (serial->transport == SERIAL_TRANSPORT_DISCONNECTED && !internal_clock)
+		return 0;
+
+	if (serial->transport == SERIAL_TRANSPORT_CAPTURE) {
+		ret = IOREG_RD8(&device->mmu, SB, &sb);
+		OK_OR_RETURN(ret == 0, ret);
+
+		ret = serial_output_append(serial, sb);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+
+	serial->transfer_active = true;
+
+	ret = scheduler_schedule(&device->scheduler, SCHEDULER_EVENT_SERIAL_TRANSFER, SERIAL_TRANSFER_CYCLES);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
+
+int serial_transfer_complete(struct device *device)
+{
+	int ret;
+	uint8_t sc, iflags;
+	struct mmu *mmu = &device->mmu;
+
+	device->serial.transfer_active = false;
+
+	/* The remote end shifts in all ones */
+	ret = IOREG_WR8(mmu, SB, 0xff);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = IOREG_RD8(mmu, SC, &sc);
+	OK_OR_RETURN(ret == 0, ret);
+
+	sc = IRF_SET_VALUE(SC, TRANSFER_START_FLAG, LR35902_IO_REGS_SC_TRANSFER_START_FLAG_NONE, sc);
+
+	ret = IOREG_WR8(mmu, SC, sc);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = IOREG_RD8(mmu, IF, &iflags);
+	OK_OR_RETURN(ret == 0, ret);
+
+	iflags = IRF_SET_VALUE(IF, SERIAL, 1, iflags);
+
+	ret = IOREG_WR8(mmu, IF, iflags);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
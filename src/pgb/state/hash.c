@@ -0,0 +1,255 @@
+#include <errno.h>
+#include <string.h>
+
+#include <pgb/apu/apu.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/state/hash.h>
+#include <pgb/utils.h>
+
+/*
+ * An XXH3 style hash: eight 64 bit lanes, each taking a 32x32 multiply of
+ * the input keyed with a secret per stripe, merged with 128 bit folding
+ * multiplies. The lane loop has no dependency between lanes, so it maps
+ * straight onto vector registers.
+ */
+#define STATE_HASH_LANES 8
+#define STATE_HASH_STRIPE (STATE_HASH_LANES * sizeof(uint64_t))
+/* Architectural state outside of memory fits in this comfortably */
+#define STATE_HASH_BUFFER_SIZE 512
+
+#define STATE_HASH_PRIME32_1 UINT64_C(0x9e3779b1)
+#define STATE_HASH_PRIME32_2 UINT64_C(0x85ebca77)
+#define STATE_HASH_PRIME32_3 UINT64_C(0xc2b2ae3d)
+#define STATE_HASH_PRIME64_1 UINT64_C(0x9e3779b185ebca87)
+#define STATE_HASH_PRIME64_2 UINT64_C(0xc2b2ae3d27d4eb4f)
+#define STATE_HASH_PRIME64_3 UINT64_C(0x165667b19e3779f9)
+#define STATE_HASH_PRIME64_4 UINT64_C(0x85ebca77c2b2ae63)
+#define STATE_HASH_PRIME64_5 UINT64_C(0x27d4eb2f165667c5)
+
+#define STATE_HASH_FIELD(buffer, length, field) do {		\
+	memcpy(&(buffer)[length], &(field), sizeof(field));	\
+	(length) += sizeof(field);				\
+} while (0)
+
+static const uint64_t state_hash_secret[3 * STATE_HASH_LANES] = {
+	0x2cb0f69f4abea221, 0x9417034723148989, 0xdd555950609dfe03,
+	0xdbafb150deb12800, 0x7e789b2e6c442cb6, 0xf41e5636c7e4f8c4,
+	0x0959d150f8fba7e4, 0xa97316f13cdb9eea, 0x74cd8258f9520068,
+	0x55c74a62e116868b, 0xd2f4c799a2023cbd, 0xdf98cb79a37b51b9,
+	0x396f5885524f3905, 0xaf1d56386ca3b276, 0xa9ffbe6b5104e85a,
+	0x6bd0c51b9fd533b3, 0x980ce91c50ab4b56, 0x28ac395780fe62c5,
+	0x768912e3a6bcedc7, 0x50b3e8c9332c7c88, 0xce3bbfe520bd47da,
+	0xcba6c8e8e0bb7c4f, 0xbf194db8434a346d, 0x7d8f2a7b60416d7f,
+};
+
+static inline
+uint64_t state_hash_fold(uint64_t a, uint64_t b)
+{
+	unsigned __int128 product = (unsigned __int128)a * b;
+
+	return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static inline
+uint64_t state_hash_avalanche(uint64_t h)
+{
+	h ^= h >> 37;
+	h *= UINT64_C(0x165667919e3779f9);
+	h ^= h >> 32;
+
+	return h;
+}
+
+static inline
+void state_hash_stripe(uint64_t acc[STATE_HASH_LANES], const uint8_t *data, const uint64_t *secret)
+{
+	int i;
+	uint64_t value, key;
+
+	for (i = 0; i < STATE_HASH_LANES; i++) {
+		memcpy(&value, &data[i * sizeof(value)], sizeof(value));
+		key = value ^ secret[i];
+		acc[i ^ 1] += value;
+		acc[i] += (key & 0xffffffff) * (key >> 32);
+	}
+}
+
+static inline
+uint64_t state_hash_merge(const uint64_t acc[STATE_HASH_LANES], const uint64_t *secret, uint64_t start)
+{
+	int i;
+	uint64_t result = start;
+
+	for (i = 0; i < STATE_HASH_LANES; i += 2)
+		result += state_hash_fold(acc[i] ^ secret[i], acc[i + 1] ^ secret[i + 1]);
+
+	return state_hash_avalanche(result);
+}
+
+static
+struct state_hash state_hash_bytes(const void *data, size_t length, uint64_t seed)
+{
+	size_t offset, stripe;
+	const uint8_t *in = data;
+	uint8_t last[STATE_HASH_STRIPE] = { 0 };
+	uint64_t acc[STATE_HASH_LANES] = {
+		STATE_HASH_PRIME32_3, STATE_HASH_PRIME64_1, STATE_HASH_PRIME64_2, STATE_HASH_PRIME64_3,
+		STATE_HASH_PRIME64_4, STATE_HASH_PRIME32_2, STATE_HASH_PRIME64_5, STATE_HASH_PRIME32_1
+	};
+	struct state_hash hash;
+
+	acc[0] ^= seed;
+
+	for (offset = 0; offset + STATE_HASH_STRIPE <= length; offset += STATE_HASH_STRIPE) {
+		stripe = offset / STATE_HASH_STRIPE;
+		state_hash_stripe(acc, &in[offset], &state_hash_secret[stripe % STATE_HASH_LANES]);
+	}
+
+	if (offset < length) {
+		stripe = offset / STATE_HASH_STRIPE;
+		memcpy(last, &in[offset], length - offset);
+		state_hash_stripe(acc, last, &state_hash_secret[stripe % STATE_HASH_LANES]);
+	}
+
+	hash.low = state_hash_merge(acc, &state_hash_secret[STATE_HASH_LANES], length * STATE_HASH_PRIME64_1);
+	hash.high = state_hash_merge(acc, &state_hash_secret[2 * STATE_HASH_LANES], ~(length * STATE_HASH_PRIME64_2));
+
+	return hash;
+}
+
+/* Brings the hash of every block written since the last call up to date */
+static
+void state_hash_memory(struct mmu *mmu, struct state_hash_cache *cache)
+{
+	unsigned word, block;
+	uint64_t dirty;
+	const uint8_t *data;
+	struct state_hash hash;
+
+	for (word = 0; word < MMU_DIRTY_WORDS; word++) {
+		dirty = mmu->dirty[MMU_DIRTY_CHANNEL_HASH][word];
+
+		while (dirty) {
+			block = word * 64 + __builtin_ctzll(dirty);
+			dirty &= dirty - 1;
+
+			data = &mmu->pages[block >> (MMU_PAGE_SHIFT - MMU_DIRTY_BLOCK_SHIFT)]->data[(block << MMU_DIRTY_BLOCK_SHIFT) & MMU_PAGE_MASK];
+			hash = state_hash_bytes(data, MMU_DIRTY_BLOCK_SIZE, block + 1);
+
+			cache->memory.low += hash.low - cache->blocks[block].low;
+			cache->memory.high += hash.high - cache->blocks[block].high;
+			cache->blocks[block] = hash;
+		}
+	}
+
+	mmu_dirty_clear(mmu, MMU_DIRTY_CHANNEL_HASH);
+}
+
+/*
+ * Gathers the architectural state outside of memory field by field, so
+ * padding never reaches the hash. Host settings and whatever only exists to
+ * feed the synthesizer (channel output levels, and the noise LFSR which is
+ * not clocked while nobody listens) are left out: two devices that differ
+ * only there behave the same.
+ */
+static
+size_t state_hash_architectural(struct device *device, uint8_t *buffer)
+{
+	int i;
+	size_t length = 0;
+	struct apu *apu = &device->apu;
+	struct apu_channel *channel;
+
+	STATE_HASH_FIELD(buffer, length, device->cpu.registers);
+	STATE_HASH_FIELD(buffer, length, device->cpu.status.halted);
+	STATE_HASH_FIELD(buffer, length, device->cpu.status.stopped);
+	STATE_HASH_FIELD(buffer, length, device->cpu.status.ime);
+	STATE_HASH_FIELD(buffer, length, device->cpu.clock.m);
+	STATE_HASH_FIELD(buffer, length, device->cpu.clock.t);
+
+	STATE_HASH_FIELD(buffer, length, device->gpu.mode);
+	STATE_HASH_FIELD(buffer, length, device->gpu.clock);
+
+	STATE_HASH_FIELD(buffer, length, device->mmu.oam_dma.active);
+
+	STATE_HASH_FIELD(buffer, length, device->scheduler.timestamp);
+	STATE_HASH_FIELD(buffer, length, device->scheduler.deadlines);
+
+	STATE_HASH_FIELD(buffer, length, device->serial.transfer_active);
+
+	STATE_HASH_FIELD(buffer, length, device->joypad.buttons);
+
+	STATE_HASH_FIELD(buffer, length, apu->powered);
+	STATE_HASH_FIELD(buffer, length, apu->registers);
+	for (i = 0; i < APU_NUM_CHANNELS; i++) {
+		channel = &apu->channels[i];
+
+		STATE_HASH_FIELD(buffer, length, channel->enabled);
+		STATE_HASH_FIELD(buffer, length, channel->dac_enabled);
+		STATE_HASH_FIELD(buffer, length, channel->length_enabled);
+		STATE_HASH_FIELD(buffer, length, channel->length);
+		STATE_HASH_FIELD(buffer, length, channel->volume);
+		STATE_HASH_FIELD(buffer, length, channel->envelope_timer);
+		STATE_HASH_FIELD(buffer, length, channel->period);
+		STATE_HASH_FIELD(buffer, length, channel->timer);
+		STATE_HASH_FIELD(buffer, length, channel->position);
+	}
+	STATE_HASH_FIELD(buffer, length, apu->sweep.enabled);
+	STATE_HASH_FIELD(buffer, length, apu->sweep.timer);
+	STATE_HASH_FIELD(buffer, length, apu->sweep.shadow_frequency);
+	STATE_HASH_FIELD(buffer, length, apu->frame_sequencer_step);
+	STATE_HASH_FIELD(buffer, length, apu->next_frame_sequencer);
+
+	return length;
+}
+
+LIBEXPORT
+int state_hash_init(struct state_hash_cache *cache)
+{
+	memset(cache, 0, sizeof(*cache));
+
+	return 0;
+}
+
+/* The same hash over an arbitrary buffer, for ROM images and the like */
+LIBEXPORT
+int state_hash_buffer(const void *data, size_t length, struct state_hash *hash)
+{
+	OK_OR_RETURN(data != NULL || length == 0, -EINVAL);
+
+	*hash = state_hash_bytes(data, length, 0);
+
+	return 0;
+}
+
+/*
+ * A 128 bit hash of the architectural state of device. Equal states hash
+ * equally across runs and builds on hosts of the same endianness. Only memory
+ * blocks written since the previous call are rehashed.
+ */
+LIBEXPORT
+int device_state_hash(struct device *device, struct state_hash *hash)
+{
+	int ret;
+	size_t length;
+	uint8_t buffer[STATE_HASH_BUFFER_SIZE];
+
+	OK_OR_RETURN(hash != NULL, -EINVAL);
+
+	/* The APU and the flags sync lazily, catch them up so equal states look equal */
+	ret = apu_sync(device);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = cpu_flags_sync(&device->cpu);
+	OK_OR_RETURN(ret == 0, ret);
+
+	state_hash_memory(&device->mmu, &device->hash);
+
+	length = state_hash_architectural(device, buffer);
+	STATE_HASH_FIELD(buffer, length, device->hash.memory);
+
+	*hash = state_hash_bytes(buffer, length, 0);
+
+	return 0;
+}
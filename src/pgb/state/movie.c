@@ -0,0 +1,339 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <pgb/apu/apu.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/joypad/joypad.h>
+#include <pgb/mmu/private/mmu.h>
+#include <pgb/state/movie.h>
+#include <pgb/state/private/state.h>
+#include <pgb/state/state.h>
+#include <pgb/utils.h>
+
+#define MOVIE_INITIAL_CAPACITY 1024
+#define MOVIE_ROM_SIZE (LR35902_MMU_REGION_ROM_BANK_01_NN_END + 1)
+/* What a movie read from a pipe may claim, a day of frames and a generous state */
+#define MOVIE_MAX_FRAMES (60 * 60 * 60 * 24)
+#define MOVIE_MAX_STATE_SIZE (16 << 20)
+
+static
+int movie_grow(void **data, size_t *capacity, size_t length, size_t element)
+{
+	size_t grown;
+	void *resized;
+
+	if (length < *capacity)
+		return 0;
+
+	grown = *capacity ? *capacity * 2 : MOVIE_INITIAL_CAPACITY;
+	OK_OR_RETURN(grown > *capacity && grown <= SIZE_MAX / element, -ENOMEM);
+
+	resized = realloc(*data, grown * element);
+	OK_OR_RETURN(resized != NULL, -ENOMEM);
+
+	*data = resized;
+	*capacity = grown;
+
+	return 0;
+}
+
+static
+void movie_clear(struct movie *movie)
+{
+	free(movie->state);
+	movie->state = NULL;
+	movie->state_size = 0;
+	movie->inputs.length = 0;
+	movie->hashes.length = 0;
+}
+
+static
+int movie_rom_hash(struct device *device, struct state_hash *hash)
+{
+	int ret;
+	uint8_t *rom;
+
+	rom = malloc(MOVIE_ROM_SIZE);
+	OK_OR_RETURN(rom != NULL, -ENOMEM);
+
+	ret = mmu_copy_out(&device->mmu, 0, rom, MOVIE_ROM_SIZE);
+	if (ret == 0)
+		ret = state_hash_buffer(rom, MOVIE_ROM_SIZE, hash);
+	OK_OR_WARN(ret == 0);
+
+	free(rom);
+
+	return ret;
+}
+
+/* Hashes are taken after every hash_interval-th frame */
+static
+bool movie_hash_due(struct movie *movie, size_t frames)
+{
+	return frames % movie->hash_interval == 0;
+}
+
+LIBEXPORT
+int movie_init(struct movie *movie, uint32_t hash_interval)
+{
+	OK_OR_RETURN(hash_interval > 0, -EINVAL);
+
+	memset(movie, 0, sizeof(*movie));
+	movie->hash_interval = hash_interval;
+
+	return 0;
+}
+
+LIBEXPORT
+int movie_destroy(struct movie *movie)
+{
+	movie_clear(movie);
+	free(movie->inputs.data);
+	free(movie->hashes.data);
+	memset(movie, 0, sizeof(*movie));
+
+	return 0;
+}
+
+/*
+ * Starts a new recording from the current state of device, dropping whatever
+ * movie held. Without MOVIE_FLAG_FROM_STATE the device must be freshly
+ * initialized with its ROM loaded, playback starts from the same point.
+ */
+LIBEXPORT
+int movie_record_begin(struct movie *movie, struct device *device, uint16_t flags)
+{
+	int ret;
+	size_t size = 0;
+
+	OK_OR_RETURN((flags & ~MOVIE_FLAG_FROM_STATE) == 0, -EINVAL);
+
+	movie_clear(movie);
+	movie->flags = flags;
+
+	if (flags & MOVIE_FLAG_FROM_STATE) {
+		state_save_buffer(device, NULL, &size);
+
+		movie->state = malloc(size);
+		OK_OR_RETURN(movie->state != NULL, -ENOMEM);
+
+		ret = state_save_buffer(device, movie->state, &size);
+		OK_OR_RETURN(ret == 0, ret);
+
+		movie->state_size = size;
+	}
+
+	ret = movie_rom_hash(device, &movie->rom_hash);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
+
+/* Runs one frame of device with buttons held and logs it */
+LIBEXPORT
+int movie_record_frame(struct movie *movie, struct device *device, uint8_t buttons)
+{
+	int ret;
+
+	ret = movie_grow((void **)&movie->inputs.data, &movie->inputs.capacity, movie->inputs.length, sizeof(*movie->inputs.data));
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = joypad_set_buttons(device, buttons);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = device_run_frame(device);
+	OK_OR_RETURN(ret == 0, ret);
+
+	movie->inputs.data[movie->inputs.length++] = buttons;
+
+	if (!movie_hash_due(movie, movie->inputs.length))
+		return 0;
+
+	ret = movie_grow((void **)&movie->hashes.data, &movie->hashes.capacity, movie->hashes.length, sizeof(*movie->hashes.data));
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = device_state_hash(device, &movie->hashes.data[movie->hashes.length]);
+	OK_OR_RETURN(ret == 0, ret);
+
+	movie->hashes.length++;
+
+	return 0;
+}
+
+/*
+ * Replays movie on device as fast as it will go, with audio synthesis off for
+ * the duration. Returns -EILSEQ and the 1-based frame in *frame as soon as a
+ * recorded hash does not match, -EINVAL if device runs a different ROM.
+ */
+LIBEXPORT
+int movie_play(struct movie *movie, struct device *device, uint32_t *frame)
+{
+	int ret;
+	size_t i, hashes = 0;
+	enum apu_mode mode;
+	struct state_hash hash;
+
+	if (movie->flags & MOVIE_FLAG_FROM_STATE) {
+		ret = state_load_buffer(device, movie->state, movie->state_size);
+		OK_OR_RETURN(ret == 0, ret);
+	}
+
+	ret = movie_rom_hash(device, &hash);
+	OK_OR_RETURN(ret == 0, ret);
+	OK_OR_RETURN(memcmp(&hash, &movie->rom_hash, sizeof(hash)) == 0, -EINVAL);
+
+	mode = device->apu.mode;
+	ret = apu_set_mode(device, APU_MODE_REGISTERS_ONLY);
+	OK_OR_RETURN(ret == 0, ret);
+
+	for (i = 0; i < movie->inputs.length; i++) {
+		ret = joypad_set_buttons(device, movie->inputs.data[i]);
+		OK_OR_BREAK(ret == 0);
+
+		ret = device_run_frame(device);
+		OK_OR_BREAK(ret == 0);
+
+		if (!movie_hash_due(movie, i + 1) || hashes == movie->hashes.length)
+			continue;
+
+		ret = device_state_hash(device, &hash);
+		OK_OR_BREAK(ret == 0);
+
+		if (memcmp(&hash, &movie->hashes.data[hashes++], sizeof(hash)) != 0) {
+			ret = -EILSEQ;
+			break;
+		}
+	}
+
+	if (frame != NULL)
+		*frame = i + (ret == -EILSEQ);
+
+	apu_set_mode(device, mode);
+
+	return ret;
+}
+
+LIBEXPORT
+int movie_save(struct movie *movie, int fd)
+{
+	int ret;
+	struct movie_header header;
+	struct iovec iov[4];
+
+	memcpy(header.magic, MOVIE_MAGIC, sizeof(header.magic));
+	header.version = MOVIE_VERSION;
+	header.flags = movie->flags;
+	header.hash_interval = movie->hash_interval;
+	header.frames = movie->inputs.length;
+	header.hashes = movie->hashes.length;
+	header.state_size = movie->state_size;
+	header.rom_hash = movie->rom_hash;
+
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = movie->state;
+	iov[1].iov_len = movie->state_size;
+	iov[2].iov_base = movie->inputs.data;
+	iov[2].iov_len = movie->inputs.length * sizeof(*movie->inputs.data);
+	iov[3].iov_base = movie->hashes.data;
+	iov[3].iov_len = movie->hashes.length * sizeof(*movie->hashes.data);
+
+	ret = state_writev(fd, iov, ARRAY_SIZE(iov));
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
+
+/*
+ * The counts of header come from the file, so they must fit what is left of
+ * a regular file, or stay within the caps when fd is a pipe, before anything
+ * is allocated for them.
+ */
+static
+int movie_check_header_sizes(int fd, const struct movie_header *header)
+{
+	int ret;
+	off_t position;
+	uint64_t needed;
+	struct stat st;
+
+	ret = fstat(fd, &st);
+	OK_OR_RETURN(ret == 0, -errno);
+
+	if (!S_ISREG(st.st_mode)) {
+		OK_OR_RETURN(header->frames <= MOVIE_MAX_FRAMES, -EINVAL);
+		OK_OR_RETURN(header->state_size <= MOVIE_MAX_STATE_SIZE, -EINVAL);
+		return 0;
+	}
+
+	position = lseek(fd, 0, SEEK_CUR);
+	OK_OR_RETURN(position >= 0 && position <= st.st_size, -EINVAL);
+
+	/* Each count is 32 bits, so the sum cannot wrap */
+	needed = (uint64_t)header->state_size;
+	needed += (uint64_t)header->frames * sizeof(uint8_t);
+	needed += (uint64_t)header->hashes * sizeof(struct state_hash);
+	OK_OR_RETURN(needed <= (uint64_t)(st.st_size - position), -EINVAL);
+
+	return 0;
+}
+
+/* Replaces the contents of movie, which must have been initialized */
+LIBEXPORT
+int movie_load(struct movie *movie, int fd)
+{
+	int ret;
+	struct movie_header header;
+
+	ret = state_read(fd, &header, sizeof(header));
+	OK_OR_RETURN(ret == 0, ret);
+
+	OK_OR_RETURN(memcmp(header.magic, MOVIE_MAGIC, sizeof(header.magic)) == 0, -EINVAL);
+	OK_OR_RETURN(header.version == MOVIE_VERSION, -EINVAL);
+	OK_OR_RETURN(header.hash_interval > 0, -EINVAL);
+	OK_OR_RETURN(header.hashes == header.frames / header.hash_interval, -EINVAL);
+	OK_OR_RETURN(!!(header.flags & MOVIE_FLAG_FROM_STATE) == (header.state_size > 0), -EINVAL);
+
+	ret = movie_check_header_sizes(fd, &header);
+	OK_OR_RETURN(ret == 0, ret);
+
+	movie_clear(movie);
+	movie->flags = header.flags;
+	movie->hash_interval = header.hash_interval;
+	movie->rom_hash = header.rom_hash;
+
+	if (header.state_size > 0) {
+		movie->state = malloc(header.state_size);
+		OK_OR_RETURN(movie->state != NULL, -ENOMEM);
+
+		movie->state_size = header.state_size;
+		ret = state_read(fd, movie->state, movie->state_size);
+		OK_OR_GOTO(ret == 0, error);
+	}
+
+	ret = -ENOMEM;
+	while (movie->inputs.capacity < header.frames)
+		OK_OR_GOTO(movie_grow((void **)&movie->inputs.data, &movie->inputs.capacity, movie->inputs.capacity, sizeof(*movie->inputs.data)) == 0, error);
+	while (movie->hashes.capacity < header.hashes)
+		OK_OR_GOTO(movie_grow((void **)&movie->hashes.data, &movie->hashes.capacity, movie->hashes.capacity, sizeof(*movie->hashes.data)) == 0, error);
+
+	ret = state_read(fd, movie->inputs.data, header.frames * sizeof(*movie->inputs.data));
+	OK_OR_GOTO(ret == 0, error);
+	movie->inputs.length = header.frames;
+
+	ret = state_read(fd, movie->hashes.data, header.hashes * sizeof(*movie->hashes.data));
+	OK_OR_GOTO(ret == 0, error);
+	movie->hashes.length = header.hashes;
+
+	return 0;
+
+error:
+	movie_clear(movie);
+	return ret;
+}
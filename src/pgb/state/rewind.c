@@ -0,0 +1,357 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/state/rewind.h>
+#include <pgb/state/state.h>
+#include <pgb/utils.h>
+
+/* Shorter runs of zeros are cheaper to keep inside a literal */
+#define REWIND_MIN_ZERO_RUN 3
+/* Worst case size of an encoded delta, see rewind_encode() */
+#define REWIND_ENCODED_BOUND(size) ((size) + (size) / 2 + 16)
+
+/*
+ * Deltas are XORs of two consecutive snapshots, which are mostly zero. They
+ * are stored as a sequence of (zero run, literal length, literal bytes)
+ * tokens, both lengths as LEB128 varints. Trailing zeros are not stored.
+ */
+static
+size_t rewind_varint_write(uint8_t *out, size_t value)
+{
+	size_t length = 0;
+
+	while (value >= 0x80) {
+		out[length++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	out[length++] = value;
+
+	return length;
+}
+
+/* Returns the number of bytes consumed, or 0 if the varint is truncated */
+static
+size_t rewind_varint_read(const uint8_t *in, size_t length, size_t *value)
+{
+	size_t i;
+	unsigned shift = 0;
+
+	*value = 0;
+	for (i = 0; i < length && shift < 8 * sizeof(*value); i++, shift += 7) {
+		*value |= (size_t)(in[i] & 0x7f) << shift;
+		if (!(in[i] & 0x80))
+			return i + 1;
+	}
+
+	return 0;
+}
+
+static
+size_t rewind_zero_run(const uint8_t *data, size_t length)
+{
+	size_t i = 0;
+	uint64_t word;
+
+	for (; i + sizeof(word) <= length; i += sizeof(word)) {
+		memcpy(&word, &data[i], sizeof(word));
+		if (word != 0)
+			break;
+	}
+
+	while (i < length && data[i] == 0)
+		i++;
+
+	return i;
+}
+
+static
+size_t rewind_encode(const uint8_t *delta, size_t size, uint8_t *out)
+{
+	size_t i = 0, length = 0, zeros, start, end, run;
+
+	while (i < size) {
+		zeros = rewind_zero_run(&delta[i], size - i);
+		if (i + zeros == size)
+			break;
+
+		start = i + zeros;
+		end = start;
+		while (end < size) {
+			if (delta[end] != 0) {
+				end++;
+				continue;
+			}
+
+			run = rewind_zero_run(&delta[end], size - end);
+			if (run >= REWIND_MIN_ZERO_RUN || end + run == size)
+				break;
+			end += run;
+		}
+
+		length += rewind_varint_write(&out[length], zeros);
+		length += rewind_varint_write(&out[length], end - start);
+		memcpy(&out[length], &delta[start], end - start);
+		length += end - start;
+
+		i = end;
+	}
+
+	return length;
+}
+
+/* XORs an encoded delta into state */
+static
+int rewind_decode(const uint8_t *in, size_t length, uint8_t *state, size_t size)
+{
+	size_t used, offset = 0, zeros, literal, i;
+
+	while (length > 0) {
+		used = rewind_varint_read(in, length, &zeros);
+		OK_OR_RETURN(used > 0, -EINVAL);
+		in += used;
+		length -= used;
+
+		used = rewind_varint_read(in, length, &literal);
+		OK_OR_RETURN(used > 0, -EINVAL);
+		in += used;
+		length -= used;
+
+		OK_OR_RETURN(literal <= length, -EINVAL);
+		OK_OR_RETURN(zeros <= size - offset && literal <= size - offset - zeros, -EINVAL);
+
+		offset += zeros;
+		for (i = 0; i < literal; i++)
+			state[offset + i] ^= in[i];
+
+		offset += literal;
+		in += literal;
+		length -= literal;
+	}
+
+	return 0;
+}
+
+/* Start of the frame interval frames after the one timestamp falls in */
+static
+uint64_t rewind_frame_start(struct rewind *rewind, uint64_t timestamp)
+{
+	return (timestamp / DEVICE_FRAME_CYCLES + rewind->interval) * DEVICE_FRAME_CYCLES;
+}
+
+static
+void rewind_drop(struct rewind *rewind, size_t first)
+{
+	size_t i;
+
+	for (i = first; i < rewind->count; i++) {
+		rewind->used -= rewind->snapshots[i].length + sizeof(rewind->snapshots[i]);
+		free(rewind->snapshots[i].delta);
+	}
+
+	rewind->count = first;
+}
+
+static
+void rewind_drop_oldest(struct rewind *rewind)
+{
+	rewind->used -= rewind->snapshots[0].length + sizeof(rewind->snapshots[0]);
+	free(rewind->snapshots[0].delta);
+
+	rewind->count--;
+	memmove(&rewind->snapshots[0], &rewind->snapshots[1], rewind->count * sizeof(rewind->snapshots[0]));
+}
+
+static
+int rewind_push(struct rewind *rewind, uint64_t timestamp, size_t length)
+{
+	size_t capacity;
+	struct rewind_snapshot *snapshots, *snapshot;
+
+	if (rewind->count == rewind->capacity) {
+		capacity = rewind->capacity ? rewind->capacity * 2 : 64;
+
+		snapshots = realloc(rewind->snapshots, capacity * sizeof(*snapshots));
+		OK_OR_RETURN(snapshots != NULL, -ENOMEM);
+
+		rewind->snapshots = snapshots;
+		rewind->capacity = capacity;
+	}
+
+	snapshot = &rewind->snapshots[rewind->count];
+	snapshot->timestamp = timestamp;
+	snapshot->length = length;
+	snapshot->delta = malloc(MAX(length, 1));
+	OK_OR_RETURN(snapshot->delta != NULL, -ENOMEM);
+
+	memcpy(snapshot->delta, rewind->encoded, length);
+	rewind->count++;
+	rewind->used += length + sizeof(*snapshot);
+
+	return 0;
+}
+
+/*
+ * Keeps at most budget bytes of history, taking a snapshot every interval
+ * frames. The budget also covers the three state sized buffers rewinding
+ * works in, so it has to be somewhat larger than a single save state.
+ */
+LIBEXPORT
+int rewind_init(struct rewind *rewind, struct device *device, unsigned interval, size_t budget)
+{
+	size_t size;
+
+	OK_OR_RETURN(interval > 0, -EINVAL);
+
+	memset(rewind, 0, sizeof(*rewind));
+
+	size = state_size(device);
+	rewind->interval = interval;
+	rewind->budget = budget;
+	rewind->state_size = size;
+	rewind->used = 2 * size + REWIND_ENCODED_BOUND(size);
+	OK_OR_RETURN(rewind->used <= budget, -EINVAL);
+
+	/* current is only allocated by the first capture */
+	rewind->scratch = malloc(size);
+	rewind->encoded = malloc(REWIND_ENCODED_BOUND(size));
+	OK_OR_GOTO(rewind->scratch && rewind->encoded, error);
+
+	return 0;
+
+error:
+	rewind_destroy(rewind);
+	return -ENOMEM;
+}
+
+LIBEXPORT
+int rewind_destroy(struct rewind *rewind)
+{
+	rewind_drop(rewind, 0);
+
+	free(rewind->snapshots);
+	free(rewind->current);
+	free(rewind->scratch);
+	free(rewind->encoded);
+	memset(rewind, 0, sizeof(*rewind));
+
+	return 0;
+}
+
+/*
+ * Meant to be called once per frame. Only every interval-th frame is saved,
+ * every other call costs a comparison.
+ */
+LIBEXPORT
+int rewind_capture(struct rewind *rewind, struct device *device)
+{
+	int ret;
+	size_t i, size, length;
+	uint8_t *state;
+	uint64_t timestamp = device->scheduler.timestamp;
+
+	/* The device went back on its own, what we hold is another timeline */
+	if (rewind->current && timestamp < rewind->timestamp) {
+		rewind_drop(rewind, 0);
+		free(rewind->current);
+		rewind->current = NULL;
+	}
+
+	if (rewind->current && timestamp < rewind->next_capture)
+		return 0;
+
+	size = rewind->state_size;
+	ret = state_save_buffer(device, rewind->scratch, &size);
+	OK_OR_RETURN(ret == 0 && size == rewind->state_size, ret ? ret : -EINVAL);
+
+	if (rewind->current == NULL) {
+		rewind->current = rewind->scratch;
+		rewind->scratch = malloc(size);
+		OK_OR_RETURN(rewind->scratch != NULL, -ENOMEM);
+	} else {
+		/* current becomes the delta from the new snapshot back to itself */
+		for (i = 0; i < size; i++)
+			rewind->current[i] ^= rewind->scratch[i];
+
+		length = rewind_encode(rewind->current, size, rewind->encoded);
+
+		ret = rewind_push(rewind, rewind->timestamp, length);
+		if (ret) {
+			for (i = 0; i < size; i++)
+				rewind->current[i] ^= rewind->scratch[i];
+			OK_OR_RETURN(ret == 0, ret);
+		}
+
+		state = rewind->current;
+		rewind->current = rewind->scratch;
+		rewind->scratch = state;
+	}
+
+	rewind->timestamp = timestamp;
+	rewind->next_capture = rewind_frame_start(rewind, timestamp);
+
+	while (rewind->used > rewind->budget && rewind->count > 0)
+		rewind_drop_oldest(rewind);
+
+	return 0;
+}
+
+/*
+ * Moves the device back by frames: the closest snapshot at or before that
+ * point is restored and emulation re-runs forward from it. History after the
+ * restored snapshot is discarded. Returns -ENOENT when history does not go
+ * back that far.
+ */
+LIBEXPORT
+int rewind_step_back(struct rewind *rewind, struct device *device, uint64_t frames)
+{
+	int ret;
+	size_t i, j;
+	uint8_t *state;
+	uint64_t target, distance;
+
+	OK_OR_RETURN(rewind->current != NULL, -ENOENT);
+
+	distance = frames * DEVICE_FRAME_CYCLES;
+	if (distance > device->scheduler.timestamp)
+		return -ENOENT;
+	target = device->scheduler.timestamp - distance;
+
+	if (rewind->timestamp <= target) {
+		ret = state_load_buffer(device, rewind->current, rewind->state_size);
+		OK_OR_RETURN(ret == 0, ret);
+	} else {
+		for (i = rewind->count; i > 0; i--) {
+			if (rewind->snapshots[i - 1].timestamp <= target)
+				break;
+		}
+		if (i == 0)
+			return -ENOENT;
+		i--;
+
+		memcpy(rewind->scratch, rewind->current, rewind->state_size);
+		for (j = rewind->count; j > i; j--) {
+			ret = rewind_decode(rewind->snapshots[j - 1].delta, rewind->snapshots[j - 1].length,
+					    rewind->scratch, rewind->state_size);
+			OK_OR_RETURN(ret == 0, ret);
+		}
+
+		ret = state_load_buffer(device, rewind->scratch, rewind->state_size);
+		OK_OR_RETURN(ret == 0, ret);
+
+		state = rewind->current;
+		rewind->current = rewind->scratch;
+		rewind->scratch = state;
+		rewind->timestamp = rewind->snapshots[i].timestamp;
+		rewind_drop(rewind, i);
+	}
+
+	rewind->next_capture = rewind_frame_start(rewind, rewind->timestamp);
+
+	ret = device_run_until(device, target);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
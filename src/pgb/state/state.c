@@ -0,0 +1,356 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <pgb/apu/apu.h>
+#include <pgb/debug.h>
+#include <pgb/device/device.h>
+#include <pgb/mmu/private/mmu.h>
+#include <pgb/state/state.h>
+#include <pgb/state/private/state.h>
+#include <pgb/utils.h>
+
+#define STATE_MAX_CHUNKS (1 + MMU_NUM_PAGES)
+#define STATE_MAX_IOVECS (1 + STATE_SECTION_MAX * (1 + STATE_MAX_CHUNKS))
+
+/* The structs, or parts of them, a section is made of */
+struct state_layout {
+	uint16_t id;
+	int count;
+	struct iovec chunks[STATE_MAX_CHUNKS];
+};
+
+static
+struct state_layout *state_layout_section(struct state_layout *layout, int *count, enum state_section id)
+{
+	struct state_layout *section = &layout[(*count)++];
+
+	section->id = id;
+	section->count = 0;
+
+	return section;
+}
+
+static
+void state_layout_chunk(struct state_layout *section, void *data, size_t size)
+{
+	section->chunks[section->count].iov_base = data;
+	section->chunks[section->count].iov_len = size;
+	section->count++;
+}
+
+/*
+ * Where every section lives in memory. Saving gathers from these chunks and
+ * loading scatters back into them, so both directions share one description.
+ */
+static
+int state_layout(struct device *device, struct state_layout *layout)
+{
+	int i, count = 0;
+	struct state_layout *section;
+
+	section = state_layout_section(layout, &count, STATE_SECTION_CPU);
+	state_layout_chunk(section, &device->cpu.registers, sizeof(device->cpu.registers));
+	state_layout_chunk(section, &device->cpu.status, sizeof(device->cpu.status));
+
+	section = state_layout_section(layout, &count, STATE_SECTION_CLOCK);
+	state_layout_chunk(section, &device->cpu.clock, sizeof(device->cpu.clock));
+
+	section = state_layout_section(layout, &count, STATE_SECTION_GPU);
+	state_layout_chunk(section, &device->gpu, sizeof(device->gpu));
+
+	section = state_layout_section(layout, &count, STATE_SECTION_MMU);
+	state_layout_chunk(section, &device->mmu.oam_dma, sizeof(device->mmu.oam_dma));
+	for (i = 0; i < MMU_NUM_PAGES; i++)
+		state_layout_chunk(section, device->mmu.pages[i]->data, MMU_PAGE_SIZE);
+
+	section = state_layout_section(layout, &count, STATE_SECTION_SCHEDULER);
+	state_layout_chunk(section, &device->scheduler, sizeof(device->scheduler));
+
+	/* The transport and captured output belong to the host */
+	section = state_layout_section(layout, &count, STATE_SECTION_SERIAL);
+	state_layout_chunk(section, &device->serial.transfer_active, sizeof(device->serial.transfer_active));
+
+	section = state_layout_section(layout, &count, STATE_SECTION_APU);
+	state_layout_chunk(section, &device->apu, offsetof(struct apu, gains));
+
+	section = state_layout_section(layout, &count, STATE_SECTION_JOYPAD);
+	state_layout_chunk(section, &device->joypad, sizeof(device->joypad));
+
+	return count;
+}
+
+static
+size_t state_section_size(const struct state_layout *section)
+{
+	int i;
+	size_t size = 0;
+
+	for (i = 0; i < section->count; i++)
+		size += section->chunks[i].iov_len;
+
+	return size;
+}
+
+/* Builds the header, the section headers and the iovecs that gather all of it */
+static
+int state_iovecs(struct device *device, struct state_header *header, struct state_section_header *section_headers, struct iovec *iov)
+{
+	int i, j, sections, count = 0;
+	size_t size = sizeof(*header);
+	struct state_layout layout[STATE_SECTION_MAX];
+
+	sections = state_layout(device, layout);
+
+	iov[count].iov_base = header;
+	iov[count++].iov_len = sizeof(*header);
+
+	for (i = 0; i < sections; i++) {
+		section_headers[i].id = layout[i].id;
+		section_headers[i].reserved = 0;
+		section_headers[i].size = state_section_size(&layout[i]);
+
+		iov[count].iov_base = &section_headers[i];
+		iov[count++].iov_len = sizeof(section_headers[i]);
+
+		for (j = 0; j < layout[i].count; j++)
+			iov[count++] = layout[i].chunks[j];
+
+		size += sizeof(section_headers[i]) + section_headers[i].size;
+	}
+
+	memcpy(header->magic, STATE_MAGIC, sizeof(header->magic));
+	header->version = STATE_VERSION;
+	header->sections = sections;
+	header->size = size;
+
+	return count;
+}
+
+int state_writev(int fd, struct iovec *iov, int count)
+{
+	ssize_t written;
+
+	while (count > 0) {
+		written = writev(fd, iov, count);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written < 0)
+			return -errno;
+
+		/* Skip whatever a short write already covered */
+		while (count > 0 && (size_t)written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			count--;
+		}
+
+		if (count > 0) {
+			iov->iov_base = (uint8_t *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+
+	return 0;
+}
+
+int state_read(int fd, void *buffer, size_t size)
+{
+	ssize_t got;
+	uint8_t *data = buffer;
+
+	while (size > 0) {
+		got = read(fd, data, size);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got < 0)
+			return -errno;
+		if (got == 0)
+			return -EINVAL;
+
+		data += got;
+		size -= got;
+	}
+
+	return 0;
+}
+
+LIBEXPORT
+size_t state_size(struct device *device)
+{
+	int i, sections;
+	size_t size = sizeof(struct state_header);
+	struct state_layout layout[STATE_SECTION_MAX];
+
+	sections = state_layout(device, layout);
+	for (i = 0; i < sections; i++)
+		size += sizeof(struct state_section_header) + state_section_size(&layout[i]);
+
+	return size;
+}
+
+/* The state goes out in a single writev() straight from the device */
+LIBEXPORT
+int state_save(struct device *device, int fd)
+{
+	int ret, count;
+	struct state_header header;
+	struct state_section_header section_headers[STATE_SECTION_MAX];
+	struct iovec iov[STATE_MAX_IOVECS];
+
+	/* Bring the lazily synced APU and flags up to date so equal states save equally */
+	ret = apu_sync(device);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = cpu_flags_sync(&device->cpu);
+	OK_OR_RETURN(ret == 0, ret);
+
+	count = state_iovecs(device, &header, section_headers, iov);
+
+	ret = state_writev(fd, iov, count);
+	OK_OR_WARN(ret == 0);
+
+	return ret;
+}
+
+/*
+ * Saves into buffer. If buffer is NULL or *size is too small, *size is set to
+ * the required size and -ENOSPC is returned.
+ */
+LIBEXPORT
+int state_save_buffer(struct device *device, void *buffer, size_t *size)
+{
+	int i, ret, count;
+	size_t required;
+	uint8_t *out = buffer;
+	struct state_header header;
+	struct state_section_header section_headers[STATE_SECTION_MAX];
+	struct iovec iov[STATE_MAX_IOVECS];
+
+	required = state_size(device);
+	if (buffer == NULL || *size < required) {
+		*size = required;
+		return -ENOSPC;
+	}
+
+	ret = apu_sync(device);
+	OK_OR_RETURN(ret == 0, ret);
+
+	ret = cpu_flags_sync(&device->cpu);
+	OK_OR_RETURN(ret == 0, ret);
+
+	count = state_iovecs(device, &header, section_headers, iov);
+
+	for (i = 0; i < count; i++) {
+		memcpy(out, iov[i].iov_base, iov[i].iov_len);
+		out += iov[i].iov_len;
+	}
+
+	*size = required;
+
+	return 0;
+}
+
+/*
+ * Every section is validated before anything is copied, so a state that
+ * fails to load leaves the device untouched. Unknown sections are skipped.
+ */
+LIBEXPORT
+int state_load_buffer(struct device *device, const void *buffer, size_t size)
+{
+	int i, j, ret, sections;
+	size_t offset;
+	const uint8_t *data = buffer, *payload;
+	const uint8_t *payloads[STATE_SECTION_MAX] = { NULL };
+	struct state_header header;
+	struct state_section_header section;
+	struct state_layout layout[STATE_SECTION_MAX];
+
+	OK_OR_RETURN(buffer != NULL && size >= sizeof(header), -EINVAL);
+
+	memcpy(&header, data, sizeof(header));
+	OK_OR_RETURN(memcmp(header.magic, STATE_MAGIC, sizeof(header.magic)) == 0, -EINVAL);
+	OK_OR_RETURN(header.version == STATE_VERSION, -EINVAL);
+	OK_OR_RETURN(header.size >= sizeof(header) && header.size <= size, -EINVAL);
+
+	sections = state_layout(device, layout);
+
+	offset = sizeof(header);
+	for (i = 0; i < header.sections; i++) {
+		OK_OR_RETURN(offset + sizeof(section) <= header.size, -EINVAL);
+		memcpy(&section, &data[offset], sizeof(section));
+		offset += sizeof(section);
+
+		OK_OR_RETURN(section.size <= header.size - offset, -EINVAL);
+
+		for (j = 0; j < sections; j++) {
+			if (layout[j].id != section.id)
+				continue;
+
+			OK_OR_RETURN(section.size == state_section_size(&layout[j]), -EINVAL);
+			payloads[j] = &data[offset];
+		}
+
+		offset += section.size;
+	}
+
+	for (j = 0; j < sections; j++)
+		OK_OR_RETURN(payloads[j] != NULL, -EINVAL);
+
+	/* Pages shared with a clone are copied first, which moves them */
+	ret = mmu_unshare_all(&device->mmu);
+	OK_OR_RETURN(ret == 0, ret);
+
+	/* Flags still pending from before would otherwise land on the loaded F */
+	ret = cpu_flags_sync(&device->cpu);
+	OK_OR_RETURN(ret == 0, ret);
+
+	state_layout(device, layout);
+
+	for (j = 0; j < sections; j++) {
+		payload = payloads[j];
+
+		for (i = 0; i < layout[j].count; i++) {
+			memcpy(layout[j].chunks[i].iov_base, payload, layout[j].chunks[i].iov_len);
+			payload += layout[j].chunks[i].iov_len;
+		}
+	}
+
+	mmu_dirty_mark_range(&device->mmu, 0, device->mmu.size);
+	/* The OAM DMA bus lock may have changed under the CPU's code page */
+	device->mmu.generation++;
+
+	return apu_state_loaded(device);
+}
+
+/* Reads one state from the current position of fd, which may be a pipe */
+LIBEXPORT
+int state_load(struct device *device, int fd)
+{
+	int ret;
+	uint8_t *buffer;
+	struct state_header header;
+
+	ret = state_read(fd, &header, sizeof(header));
+	OK_OR_RETURN(ret == 0, ret);
+
+	OK_OR_RETURN(header.size >= sizeof(header), -EINVAL);
+
+	buffer = malloc(header.size);
+	OK_OR_RETURN(buffer != NULL, -ENOMEM);
+
+	memcpy(buffer, &header, sizeof(header));
+
+	ret = state_read(fd, &buffer[sizeof(header)], header.size - sizeof(header));
+	OK_OR_GOTO(ret == 0, done);
+
+	ret = state_load_buffer(device, buffer, header.size);
+	OK_OR_WARN(ret == 0);
+
+done:
+	free(buffer);
+	return ret;
+}
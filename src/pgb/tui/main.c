@@ -17,7 +17,9 @@
 #include <pgb/tui/tui.h>
 #include <pgb/utils.h>
 
-volatile int g_pgb_sigint = 0;
+/* Signal dispositions are process-wide, the handler only knows which state to flag */
+static
+volatile sig_atomic_t *sigint_flag;
 
 static
 const char *help_text =
@@ -85,6 +87,8 @@ void dump_register_state(WINDOW *reg_window, struct device *device)
 	struct cpu *cpu = &device->cpu;
 	struct debugger_io_register_info *io_register_listing;
 
+	cpu_flags_sync(cpu);
+
 	mvwprintw(reg_window, 1, 2, "PC   0x%04x\n", cpu->registers.pc);
 	mvwprintw(reg_window, 2, 2, "SP   0x%04x\n", cpu->registers.sp);
 	mvwprintw(reg_window, 3, 2, "AF   0x%04x\n", cpu->registers.af);
@@ -404,12 +408,16 @@ void destroy_tui()
 static
 void sigint_handler(int sig_num)
 {
-	g_pgb_sigint = 1;
+	if (sigint_flag != NULL)
+		*sigint_flag = 1;
 }
 
 static
-int init_pgb_signal_handlers()
+int init_pgb_signal_handlers(struct libpgb_tui_state *tui_state)
 {
+	tui_state->interrupted = 0;
+	sigint_flag = &tui_state->interrupted;
+
 	signal(SIGINT, sigint_handler);
 
 	return 0;
@@ -502,7 +510,7 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	ret = init_pgb_signal_handlers();
+	ret = init_pgb_signal_handlers(&tui_state);
 	OK_OR_RETURN(ret == 0, ret);
 
 	ret = init_pgb_device(&tui_state, bios_path, rom_path, decoder_type);
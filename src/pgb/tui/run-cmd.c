@@ -20,9 +20,6 @@
 	"    > run\n"                                                \
 	""
 
-extern
-volatile int g_pgb_sigint;
-
 static
 int run_cmd(struct libpgb_tui_state *tui_state, int argc, char **argv)
 {
@@ -31,7 +28,7 @@ int run_cmd(struct libpgb_tui_state *tui_state, int argc, char **argv)
 	struct pgb_tui_breakpoint_entry *bp;
 
 	while (true) {
-		if (g_pgb_sigint)
+		if (tui_state->interrupted)
 			break;
 
 		if (!TAILQ_EMPTY(tui_state->breakpoints)) {
@@ -45,7 +42,7 @@ int run_cmd(struct libpgb_tui_state *tui_state, int argc, char **argv)
 		OK_OR_BREAK(ret == 0);
 	}
 
-	g_pgb_sigint = 0;
+	tui_state->interrupted = 0;
 
 breakpoint_hit:
 
@@ -18,8 +18,10 @@ for key in ${!GENERATED_FILES[@]}; do
 
 	./${SCRIPT_ROOT}/generate_isa.py --source "${source_file}" --name "CPU_PRIVATE_${name}_OPS" --prefix "${name}" --format header > "${output_file}.h"
 	./${SCRIPT_ROOT}/generate_isa.py --source "${source_file}" --name "CPU_PRIVATE_${name}_OPS" --prefix "${name}" --format definition > "${output_file}.def"
+	./${SCRIPT_ROOT}/generate_isa.py --source "${source_file}" --name "CPU_PRIVATE_${name}_OPS" --prefix "${name}" --format text > "${output_file}_text.def"
 	# ./${SCRIPT_ROOT}/generate_isa.py --source "${source_file}" --name "CPU_PRIVATE_${name}_OPS" --prefix "${name}" --format json > "${output_file}.json"
 
 	mv "${output_file}.h" "${PROJECT_ROOT}/include/pgb/cpu/private"
 	mv "${output_file}.def" "${PROJECT_ROOT}/include/pgb/cpu/private"
+	mv "${output_file}_text.def" "${PROJECT_ROOT}/include/pgb/cpu/private"
 done
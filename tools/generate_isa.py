@@ -212,11 +212,9 @@ def generate_c_header(name, prefix, parsed_instructions):
 def generate_c_def(is_prefix_cb, parsed_instructions):
     print '/* This file was generated by tools/generate_isa.py */'
 
-    # SET(MNEMONIC, ASSEMBLY, OPCODE, OPERATION_CLASS, OPERAND_A, TYPE_A, MODIFIER_A, OPERAND_B, TYPE_B, MODIFIER_B, NUM_BYTES, C0, C1, FLAG_MASK, FLAG_Z, FLAG_N, FLAG_H, FLAG_C, IS_PREFIX)
+    # SET(OPCODE, OPERATION_CLASS, OPERAND_A, TYPE_A, MODIFIER_A, OPERAND_B, TYPE_B, MODIFIER_B, NUM_BYTES, C0, C1, FLAG_MASK, FLAG_Z, FLAG_N, FLAG_H, FLAG_C, IS_PREFIX)
     for instruction in parsed_instructions:
-        print 'SET({}, "{}", 0x{:02x}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, 0x{:0x}, {}, {}, {}, {}, {})'.format(
-              instruction['mnemonic'],
-              instruction['assembly'],
+        print 'SET(0x{:02x}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, 0x{:0x}, {}, {}, {}, {}, {})'.format(
               instruction['opcode'],
               'INSTRUCTION_CLASS_{}'.format(instruction['mnemonic']),
               'INSTRUCTION_OPERAND_{}'.format(instruction['operands']['a']['value']),
@@ -235,6 +233,16 @@ def generate_c_def(is_prefix_cb, parsed_instructions):
               instruction['flags']['c'],
               str(is_prefix_cb).lower())
 
+def generate_c_text(parsed_instructions):
+    print '/* This file was generated by tools/generate_isa.py */'
+
+    # TEXT(OPCODE, MNEMONIC, ASSEMBLY)
+    for instruction in parsed_instructions:
+        print 'TEXT(0x{:02x}, {}, "{}")'.format(
+              instruction['opcode'],
+              instruction['mnemonic'],
+              instruction['assembly'])
+
 def generate_json(parsed_instructions):
     json.dump(parsed_instructions, sys.stdout, indent=4)
 
@@ -255,7 +263,7 @@ def parse_input_file(source_path):
         mnemonic = parse_mnemonic(parts[1], parts[2:])
 
         if len(parts) == 9:
-            assembly = '{} {}'.format(mnemonic, parts[2])
+            assembly = '{} {}'.format(mnemonic, parts[2].replace(',', ', '))
             operand_a, modifier_a, operand_b, modifier_b = parse_operands(mnemonic, parts[2])
             num_bytes = int(parts[3])
             c0, c1 = parse_cycle(parts[4])
@@ -314,7 +322,7 @@ def main():
     parser.add_argument('-s', '--source', dest='source_path', type=str, default='data/opcodes.txt',
                         help='Path to textfile containting opcode information.')
     parser.add_argument('-f', '--format', dest='output_format', type=str, default="header",
-                        help='Controls the type of output generated by this script. Valid values are "header", "definition" and "json".')
+                        help='Controls the type of output generated by this script. Valid values are "header", "definition", "text" and "json".')
     parser.add_argument('-n', '--name', dest='name', type=str, default='CPU_ISA',
                         help='Controls the name of the header guards produced.')
     parser.add_argument('-p', '--prefix', dest='prefix', type=str, default='LR35902',
@@ -329,6 +337,8 @@ def main():
         generate_c_header(args.name, args.prefix, parsed_instructions)
     elif args.output_format == 'definition':
         generate_c_def(args.is_prefix_cb, parsed_instructions)
+    elif args.output_format == 'text':
+        generate_c_text(parsed_instructions)
     elif args.output_format == 'json':
         generate_json(parsed_instructions)
     else: